@@ -8,4 +8,22 @@ add_feature_info(
     RAWENC_ENABLE_NVCODEC RAWENC_ENABLE_NVCODEC "Build project with Nvidia codec"
 )
 
+option(RAWENC_ENABLE_TESTS "Enable performance regression tests" ON)
+add_feature_info(
+    RAWENC_ENABLE_TESTS RAWENC_ENABLE_TESTS "Build project with performance regression tests"
+)
+
+set(RAWENC_BENCH_RESOLUTIONS "1280x720;1920x1080" CACHE STRING
+    "Resolutions of performance tests")
+set(RAWENC_BENCH_PRESETS "ultrafast;veryfast;fast" CACHE STRING
+    "Encoder presets of performance tests")
+set(RAWENC_BENCH_FPS 30 CACHE STRING
+    "Frame rate sustained by performance tests")
+set(RAWENC_BENCH_FRAMES 150 CACHE STRING
+    "Captured frames count of each performance test")
+set(RAWENC_BENCH_MAX_LATENCY 100 CACHE STRING
+    "Latency ceiling of performance tests (ms, 99th percentile)")
+set(RAWENC_BENCH_DEVICE "" CACHE STRING
+    "V4L2 device of performance tests, e.g. vivid (fake capture if empty or unavailable)")
+
 feature_summary(WHAT ALL)
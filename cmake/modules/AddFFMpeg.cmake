@@ -1,3 +1,4 @@
 find_package(PkgConfig)
 
 pkg_check_modules(LibAvCodec REQUIRED IMPORTED_TARGET libavcodec)
+pkg_check_modules(LibSwScale REQUIRED IMPORTED_TARGET libswscale)
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <utility>
+
+namespace jar {
+
+/* Find the next start code (00 00 01), returns its offset and size or size of input */
+[[nodiscard]] inline std::pair<std::size_t, std::size_t>
+findStartCode(const uint8_t* data, const std::size_t size, std::size_t offset)
+{
+    for (; offset + 2 < size; ++offset) {
+        if (data[offset] == 0 and data[offset + 1] == 0 and data[offset + 2] == 1) {
+            if (offset > 0 and data[offset - 1] == 0) {
+                return {offset - 1, 4};
+            }
+            return {offset, 3};
+        }
+    }
+    return {size, 0};
+}
+
+/*
+ * Call handler with each NAL unit (without start code) of Annex-B byte stream until it returns
+ * false, so the scanning may stop early (e.g. at the first slice after parameter sets).
+ */
+template<typename Handler>
+void
+forEachNal(const uint8_t* data, const std::size_t size, Handler&& handler)
+{
+    auto [offset, codeSize] = findStartCode(data, size, 0);
+    while (offset < size) {
+        const std::size_t begin = offset + codeSize;
+        const auto next = findStartCode(data, size, begin);
+        if (next.first > begin and not handler(data + begin, next.first - begin)) {
+            return;
+        }
+        std::tie(offset, codeSize) = next;
+    }
+}
+
+} // namespace jar
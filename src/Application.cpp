@@ -1,12 +1,42 @@
+#include <boost/algorithm/string.hpp>
 #include <boost/asio.hpp>
 #include <boost/program_options.hpp>
 
+#include "BatchEncoder.hpp"
+#include "Benchmark.hpp"
+#include "Calibrator.hpp"
 #include "Camera.hpp"
+#include "ControlServer.hpp"
 #include "Encoder.hpp"
+#include "EncoderStats.hpp"
+#include "EventRecorder.hpp"
+#include "FileSink.hpp"
+#include "FrameBus.hpp"
+#include "FrameSlot.hpp"
+#include "FrameSource.hpp"
+#include "HugePageAllocator.hpp"
+#include "IoPool.hpp"
 #include "Logger.hpp"
 #include "LoggerInitializer.hpp"
+#include "MemoryBudget.hpp"
+#include "Pipeline.hpp"
+#include "PreRollBuffer.hpp"
+#include "RecordingFile.hpp"
+#include "RtpSender.hpp"
+#include "Snapshotter.hpp"
+#include "SpoolReader.hpp"
+#include "Spooler.hpp"
+#include "StreamServer.hpp"
+#include "Tracer.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
 #include <iostream>
+#include <memory>
+#include <string_view>
+#include <thread>
 
 namespace asio = boost::asio;
 namespace po = boost::program_options;
@@ -14,6 +44,7 @@ namespace po = boost::program_options;
 /* General defaults */
 static unsigned kDefaultWidth = 640;
 static unsigned kDefaultHeight = 480;
+static unsigned kDefaultIoThreads = 2;
 
 /* Encoder specific defaults */
 static const char* kDefaultCodec{"libx264"};
@@ -23,19 +54,569 @@ static unsigned kDefaultBitrate = 400000;
 static unsigned kDefaultFps = 30;
 static unsigned kDefaultGopSize = 10;
 static unsigned kDefaultBFrames = 0;
+static unsigned kDefaultWarmUpFrames = 0;
+static unsigned kDefaultEncoderQueueSize = 8;
+
+/* Snapshot specific defaults */
+static unsigned kDefaultThumbnailWidth = 320;
+
+/* Event recording specific defaults */
+static unsigned kDefaultPreRollDuration = 5;
+static unsigned kDefaultPreRollBudget = 32;
+static unsigned kDefaultEventDuration = 10;
+
+/* Logging specific defaults */
+static const char* kDefaultLogFile{"rawenc.log"};
+static std::size_t kDefaultLogQueueSize = 8192;
+static const char* kDefaultLogOverflow{"drop"};
+
+/* RTP specific defaults */
+static std::size_t kDefaultRtpMtu = 1400;
+/* The smallest packet leaves room for header and fragment, the largest one fits UDP datagram */
+static std::size_t kMinRtpMtu = 64;
+static std::size_t kMaxRtpMtu = 65507;
+static unsigned kDefaultRtpPayloadType = 96;
+
+/* Recording sink specific defaults */
+static unsigned kDefaultSinkBuffers = 64;
+static unsigned kDefaultSinkThreads = 2;
+static unsigned kDefaultSyncInterval = 1000;
+
+/* Frame bus specific defaults */
+static unsigned kDefaultFrameBusSlots = 8;
+
+/* Encoder statistics specific defaults */
+static std::size_t kDefaultStatsWindow = 300;
+static std::size_t kDefaultStatsGops = 8;
+
+/* Tracing specific defaults */
+static std::size_t kDefaultTraceBufferSize = 65536;
+
+/* Spool specific defaults */
+static unsigned kDefaultSpoolFileSize = 1024;
+static unsigned kDefaultSpoolBuffers = 16;
+
+/* Memory budget specific defaults (the encoder internals are estimated) */
+static unsigned kDefaultMemoryBudget = 0;
+static unsigned kDefaultLookahead = 40;
+static unsigned kDefaultReferenceFrames = 3;
+static std::size_t kLogMessageSize = 256;
+
+/* Calibration specific defaults */
+static unsigned kDefaultCalibrationFrames = 120;
+static double kDefaultRealtimeFactor = 1.2;
+static unsigned kDefaultMaxLatency = 100;
+static std::size_t kSyntheticFrames = 60;
+
+/* Benchmark specific defaults */
+static unsigned kDefaultBenchmarkFrames = 300;
+static double kDefaultMinFpsRatio = 0.95;
+static unsigned kDefaultMaxDrops = 0;
+static const char* kDefaultBenchmarkOutput{"bench.json"};
+
+/* Batch specific defaults */
+static unsigned kDefaultBatchWorkers = 0;
 
 namespace jar {
 
+namespace {
+
+std::vector<std::string>
+splitList(const std::string& value)
+{
+    std::vector<std::string> output;
+    boost::split(output, value, boost::is_any_of(","));
+    return output;
+}
+
+std::vector<unsigned>
+splitNumbers(const std::string& value)
+{
+    std::vector<unsigned> output;
+    for (const auto& item : splitList(value)) {
+        output.push_back(static_cast<unsigned>(std::stoul(item)));
+    }
+    return output;
+}
+
+std::vector<std::pair<unsigned, unsigned>>
+splitResolutions(const std::string& value)
+{
+    std::vector<std::pair<unsigned, unsigned>> output;
+    for (const auto& item : splitList(value)) {
+        const auto separator = item.find('x');
+        if (separator == std::string::npos) {
+            throw po::validation_error{po::validation_error::invalid_option_value, "resolutions"};
+        }
+        output.emplace_back(static_cast<unsigned>(std::stoul(item.substr(0, separator))),
+                            static_cast<unsigned>(std::stoul(item.substr(separator + 1))));
+    }
+    return output;
+}
+
+/*
+ * The stages of encoded packet fan-out. They run inline on the encoder strand since the packet
+ * payload is owned by encoder only until the notification returns.
+ */
+struct PacketOutputStage {
+    RtpSender* rtpSender{};
+    RecordingFile* recording{};
+
+    template<typename Emit>
+    void
+    process(const EncodedPacket& packet, Emit&& emit)
+    {
+        if (rtpSender) {
+            rtpSender->send(packet);
+        } else if (recording) {
+            TRACE_SCOPE("Output::write");
+            std::ignore = recording->write(packet.data, packet.size, packet.pts, packet.key);
+        } else {
+            TRACE_SCOPE("Output::write");
+            fwrite(packet.data, 1, packet.size, stdout);
+            fflush(stdout);
+        }
+        emit(packet);
+    }
+};
+
+struct PacketStreamStage {
+    StreamServer* streamServer{};
+
+    template<typename Emit>
+    void
+    process(const EncodedPacket& packet, Emit&& emit)
+    {
+        if (streamServer) {
+            streamServer->publish(packet);
+        }
+        emit(packet);
+    }
+};
+
+struct PacketPreRollStage {
+    PreRollBuffer* preRoll{};
+
+    template<typename Emit>
+    void
+    process(const EncodedPacket& packet, Emit&& emit)
+    {
+        if (preRoll) {
+            preRoll->push(packet);
+        }
+        emit(packet);
+    }
+};
+
+struct PacketStatsSink {
+    EncoderStats* stats{};
+
+    void
+    consume(const EncodedPacket& packet)
+    {
+        stats->push(packet);
+    }
+};
+
+using PacketFanOut
+    = pipeline::Pipeline<PacketOutputStage, PacketStreamStage, PacketPreRollStage, PacketStatsSink>;
+
+} // namespace
+
 class Application {
 public:
     [[nodiscard]] bool
     parseArgs(const int argc, char* argv[])
     {
-        po::options_description d{"RawEnc CLI"};
+        if (argc > 1 and std::string_view{argv[1]} == "calibrate") {
+            _mode = Mode::Calibrate;
+            return parseCalibrateArgs(argc - 1, argv + 1);
+        }
+        if (argc > 1 and std::string_view{argv[1]} == "bench") {
+            _mode = Mode::Benchmark;
+            return parseBenchmarkArgs(argc - 1, argv + 1);
+        }
+        if (argc > 1 and std::string_view{argv[1]} == "batch") {
+            _mode = Mode::Batch;
+            return parseBatchArgs(argc - 1, argv + 1);
+        }
+        return parseCaptureArgs(argc, argv);
+    }
+
+    [[nodiscard]] const std::string&
+    logFile() const
+    {
+        return _logFile;
+    }
+
+    [[nodiscard]] const LoggerConfig&
+    loggerConfig() const
+    {
+        return _loggerConfig;
+    }
+
+    [[nodiscard]] bool
+    run()
+    {
+        _startTime = Clock::now();
+        if (not _encoderConfig.numaNode) {
+            /* The encoders are configured on other threads (async setup, batch workers), so
+             * the default node is resolved on main thread */
+            _encoderConfig.numaNode = HugePageAllocator::currentNumaNode();
+        }
+        if (_mode == Mode::Calibrate) {
+            return runCalibration();
+        }
+        if (_mode == Mode::Benchmark) {
+            return runBenchmark();
+        }
+        if (_mode == Mode::Batch) {
+            return runBatch();
+        }
+        if (_input) {
+            return runReplay();
+        }
+        if (not _spoolConfig.directory.empty()) {
+            return runSpool();
+        }
+        return runCapture();
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    enum class Mode { Capture, Calibrate, Benchmark, Batch };
+
+    [[nodiscard]] int64_t
+    elapsedMs() const
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - _startTime)
+            .count();
+    }
+
+    [[nodiscard]] bool
+    setupEncoderAndWarmUp()
+    {
+        if (not setupEncoder()) {
+            return false;
+        }
+        return (_warmUpFrames == 0) or _encoder.warmUp(_warmUpFrames);
+    }
+
+    [[nodiscard]] bool
+    parseCaptureArgs(const int argc, char* argv[])
+    {
+        po::options_description d{"RawEnc CLI (use \"calibrate\" command to tune encoder)"};
+        addEncoderOptions(d);
+
+        // clang-format off
+        d.add_options()
+            ("help,h", "Display help")
+            ("config", po::value<std::string>(), "Load options from config file")
+            ("io-threads", po::value<unsigned>()->notifier([this](const unsigned v) {
+                _ioThreads = v;
+            })->default_value(kDefaultIoThreads), "Set threads count serving capture and encoding")
+            ("preset", po::value<std::string>()->notifier([this](const std::string& v) {
+                _encoderConfig.preset = v;
+            }), "Choose encoder preset")
+            ("tune", po::value<std::string>()->notifier([this](const std::string& v) {
+                _encoderConfig.tune = v;
+            }), "Choose encoder tune")
+            ("b-frames", po::value<unsigned>()->notifier([this](const unsigned v) {
+               _encoderConfig.bFrames = v;
+            }), "Set encoder b-frames count")
+            ("threads", po::value<unsigned>()->notifier([this](const unsigned v) {
+               _encoderConfig.threads = v;
+            }), "Set encoder threads count (0 - auto)")
+            ("warm-up", po::value<unsigned>()->notifier([this](const unsigned v) {
+               _warmUpFrames = v;
+            })->default_value(kDefaultWarmUpFrames), "Encode given number of synthetic frames "
+                                                     "by throwaway encoder before start")
+            ("input", po::value<std::string>()->notifier([this](const std::string& v) {
+                _input = v;
+            }), "Encode frames from spool file instead of camera")
+            ("output", po::value<std::string>()->notifier([this](const std::string& v) {
+                _output = v;
+            }), "Write encoded stream into file (with keyframe index) instead of stdout")
+            ("io-uring", po::value<bool>()->notifier([this](const bool v) {
+                _sinkConfig.ioUring = v;
+            })->default_value(true), "Write recordings via io_uring (writer threads otherwise)")
+            ("sink-buffers", po::value<unsigned>()->notifier([this](const unsigned v) {
+                _sinkConfig.bufferCount = v;
+            })->default_value(kDefaultSinkBuffers), "Set recording sink staging buffers count")
+            ("sink-threads", po::value<unsigned>()->notifier([this](const unsigned v) {
+                _sinkConfig.threads = v;
+            })->default_value(kDefaultSinkThreads), "Set recording sink writer threads count "
+                                                    "(without io_uring)")
+            ("sync-interval", po::value<unsigned>()->notifier([this](const unsigned v) {
+                _sinkConfig.syncInterval = std::chrono::milliseconds{v};
+            })->default_value(kDefaultSyncInterval), "Set recording data sync interval (ms)")
+            ("spool-dir", po::value<std::string>()->notifier([this](const std::string& v) {
+                _spoolConfig.directory = v;
+            }), "Set spool directory (enables capture-only mode without encoding)")
+            ("spool-file-size", po::value<unsigned>()->notifier([this](const unsigned v) {
+                _spoolConfig.fileSize = std::size_t{v} * 1024 * 1024;
+            })->default_value(kDefaultSpoolFileSize), "Set preallocated spool file size (MiB)")
+            ("spool-buffers", po::value<unsigned>()->notifier([this](const unsigned v) {
+                _spoolConfig.bufferCount = v;
+            })->default_value(kDefaultSpoolBuffers), "Set spool staging buffers count")
+            ("control-socket", po::value<std::string>()->notifier([this](const std::string& v) {
+                _controlSocket = v;
+            }), "Set control socket path (enables snapshot requests)")
+            ("thumbnail-width", po::value<unsigned>()->notifier([this](const unsigned v) {
+                _snapshotConfig.thumbnailWidth = v;
+            })->default_value(kDefaultThumbnailWidth), "Set default snapshot width")
+            ("event-dir", po::value<std::string>()->notifier([this](const std::string& v) {
+                _eventConfig.directory = v;
+            }), "Set event recordings directory (enables pre-roll buffer)")
+            ("event-duration", po::value<unsigned>()->notifier([this](const unsigned v) {
+                _eventConfig.duration = std::chrono::seconds{v};
+            })->default_value(kDefaultEventDuration), "Set event duration after trigger (sec)")
+            ("preroll-duration", po::value<unsigned>()->notifier([this](const unsigned v) {
+                _preRollConfig.duration = std::chrono::seconds{v};
+            })->default_value(kDefaultPreRollDuration), "Set pre-roll duration (sec)")
+            ("preroll-budget", po::value<unsigned>()->notifier([this](const unsigned v) {
+                _preRollConfig.budget = std::size_t{v} * 1024 * 1024;
+            })->default_value(kDefaultPreRollBudget), "Set pre-roll memory budget (MiB)")
+            ("rtp-dest", po::value<std::string>()->notifier([this](const std::string& v) {
+                const auto colon = v.rfind(':');
+                if (colon == std::string::npos) {
+                    throw po::validation_error{po::validation_error::invalid_option_value,
+                                               "rtp-dest", v};
+                }
+                _rtpConfig.host = v.substr(0, colon);
+                _rtpConfig.port = static_cast<uint16_t>(std::stoul(v.substr(colon + 1)));
+                _rtpEnabled = true;
+            }), "Send RTP stream over UDP to given <host>:<port> instead of stdout")
+            ("stream-socket", po::value<std::string>()->notifier([this](const std::string& v) {
+                _streamConfig.socketPath = v;
+            }), "Serve encoded stream on local socket (late clients are primed with current GOP)")
+            ("rtp-mtu", po::value<std::size_t>()->notifier([this](const std::size_t v) {
+                if (v < kMinRtpMtu or v > kMaxRtpMtu) {
+                    throw po::validation_error{po::validation_error::invalid_option_value,
+                                               "rtp-mtu", std::to_string(v)};
+                }
+                _rtpConfig.mtu = v;
+            })->default_value(kDefaultRtpMtu), "Set maximum RTP packet size (64-65507 bytes)")
+            ("rtp-payload-type", po::value<unsigned>()->notifier([this](const unsigned v) {
+                _rtpConfig.payloadType = static_cast<uint8_t>(v);
+            })->default_value(kDefaultRtpPayloadType), "Set RTP payload type")
+            ("log-file", po::value<std::string>()->notifier([this](const std::string& v) {
+                _logFile = v;
+            })->default_value(kDefaultLogFile), "Set log file path")
+            ("log-async", po::bool_switch()->notifier([this](const bool v) {
+                _loggerConfig.async = v;
+            }), "Format and write log messages on background thread")
+            ("log-queue-size", po::value<std::size_t>()->notifier([this](const std::size_t v) {
+                _loggerConfig.queueSize = v;
+            })->default_value(kDefaultLogQueueSize), "Set async log queue size (messages)")
+            ("log-overflow", po::value<std::string>()->notifier([this](const std::string& v) {
+                if (const auto policy = LoggerInitializer::parseOverflowPolicy(v); policy) {
+                    _loggerConfig.overflow = *policy;
+                } else {
+                    throw po::validation_error{po::validation_error::invalid_option_value,
+                                               "log-overflow", v};
+                }
+            })->default_value(kDefaultLogOverflow), "Set async log overflow policy (block, drop)")
+            ("frame-bus", po::value<std::string>()->notifier([this](const std::string& v) {
+                _frameBusName = v;
+            }), "Publish captured frames into shared memory with given name")
+            ("frame-bus-slots", po::value<unsigned>()->notifier([this](const unsigned v) {
+                _frameBusSlots = v;
+            })->default_value(kDefaultFrameBusSlots), "Set frame bus slots count")
+            ("stats-window", po::value<std::size_t>()->notifier([this](const std::size_t v) {
+                _statsConfig.frames = v;
+            })->default_value(kDefaultStatsWindow), "Set encoder stats window (frames)")
+            ("stats-gops", po::value<std::size_t>()->notifier([this](const std::size_t v) {
+                _statsConfig.gops = v;
+            })->default_value(kDefaultStatsGops), "Set encoder stats bitrate window (GOPs)")
+            ("trace-file", po::value<std::string>()->notifier([this](const std::string& v) {
+                _traceFile = v;
+            }), "Enable tracing and set Chrome trace file path (written on exit or SIGUSR1)")
+            ("trace-buffer", po::value<std::size_t>()->notifier([this](const std::size_t v) {
+                _traceBufferSize = v;
+            })->default_value(kDefaultTraceBufferSize), "Set trace events count kept per thread")
+            ("memory-budget", po::value<unsigned>()->notifier([this](const unsigned v) {
+                _memoryBudget = std::size_t{v} * 1024 * 1024;
+            })->default_value(kDefaultMemoryBudget), "Set memory budget (MiB, 0 - unlimited) "
+                                                     "the buffers are adapted to")
+        ;
+        // clang-format on
+
+        po::variables_map vm;
+        po::store(po::parse_command_line(argc, argv, d), vm);
+        if (vm.contains("config")) {
+            /* Command line options take precedence over config file */
+            po::store(po::parse_config_file(vm["config"].as<std::string>().data(), d), vm);
+        }
+        po::notify(vm);
+
+        if (vm.contains("help")) {
+            std::cout << d << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+
+    [[nodiscard]] bool
+    parseCalibrateArgs(const int argc, char* argv[])
+    {
+        po::options_description d{"RawEnc calibrate CLI"};
+        addEncoderOptions(d);
+
+        // clang-format off
+        d.add_options()
+            ("help,h", "Display help")
+            ("input", po::value<std::string>()->notifier([this](const std::string& v) {
+                _calibrationInput = v;
+            }), "Set raw YUV420 file with recorded frames (synthetic frames by default)")
+            ("output", po::value<std::string>()->notifier([this](const std::string& v) {
+                _calibrationOutput = v;
+            })->required(), "Set output config file")
+            ("frames", po::value<unsigned>()->notifier([this](const unsigned v) {
+                _calibrationConfig.frames = v;
+            })->default_value(kDefaultCalibrationFrames), "Set frames count per candidate")
+            ("presets", po::value<std::string>()->notifier([this](const std::string& v) {
+                _calibrationConfig.presets = splitList(v);
+            }), "Set comma separated presets to sweep")
+            ("tunes", po::value<std::string>()->notifier([this](const std::string& v) {
+                _calibrationConfig.tunes = splitList(v);
+                std::ranges::replace(_calibrationConfig.tunes, std::string{"none"}, std::string{});
+            }), "Set comma separated tunes to sweep (none - no tune)")
+            ("threads", po::value<std::string>()->notifier([this](const std::string& v) {
+                _calibrationConfig.threads = splitNumbers(v);
+            }), "Set comma separated threads counts to sweep (0 - auto)")
+            ("b-frames", po::value<std::string>()->notifier([this](const std::string& v) {
+                _calibrationConfig.bFrames = splitNumbers(v);
+            }), "Set comma separated b-frames counts to sweep")
+            ("realtime-factor", po::value<double>()->notifier([this](const double v) {
+                _calibrationConfig.realtimeFactor = v;
+            })->default_value(kDefaultRealtimeFactor), "Set required speed relative to real-time")
+            ("max-latency", po::value<unsigned>()->notifier([this](const unsigned v) {
+                _calibrationConfig.maxLatency = std::chrono::milliseconds{v};
+            })->default_value(kDefaultMaxLatency), "Set latency ceiling (ms, 95th percentile)")
+            ("log-file", po::value<std::string>()->notifier([this](const std::string& v) {
+                _logFile = v;
+            })->default_value(kDefaultLogFile), "Set log file path")
+        ;
+        // clang-format on
+
+        po::variables_map vm;
+        po::store(po::parse_command_line(argc, argv, d), vm);
+        if (vm.contains("help")) {
+            std::cout << d << std::endl;
+            return false;
+        }
+        if (vm.contains("output-fps")) {
+            /* The throughput and latency are measured per input frame, so no decimation */
+            throw po::error{"the option '--output-fps' isn't supported by calibrate command"};
+        }
+        po::notify(vm);
+
+        return true;
+    }
+
+    [[nodiscard]] bool
+    parseBenchmarkArgs(const int argc, char* argv[])
+    {
+        po::options_description d{"RawEnc bench CLI"};
+        addEncoderOptions(d);
+
+        // clang-format off
+        d.add_options()
+            ("help,h", "Display help")
+            ("output", po::value<std::string>()->notifier([this](const std::string& v) {
+                _benchmarkOutput = v;
+            })->default_value(kDefaultBenchmarkOutput), "Set JSON results file")
+            ("device", po::value<std::string>()->notifier([this](const std::string& v) {
+                _benchmarkConfig.device = v;
+            }), "Capture from V4L2 device, e.g. vivid (fake capture if unavailable)")
+            ("frames", po::value<unsigned>()->notifier([this](const unsigned v) {
+                _benchmarkConfig.frames = v;
+            })->default_value(kDefaultBenchmarkFrames), "Set captured frames count per run")
+            ("presets", po::value<std::string>()->notifier([this](const std::string& v) {
+                _benchmarkConfig.presets = splitList(v);
+            }), "Set comma separated presets to run")
+            ("resolutions", po::value<std::string>()->notifier([this](const std::string& v) {
+                _benchmarkConfig.resolutions = splitResolutions(v);
+            }), "Set comma separated resolutions to run (e.g. 1280x720,1920x1080)")
+            ("min-fps-ratio", po::value<double>()->notifier([this](const double v) {
+                _benchmarkConfig.minFpsRatio = v;
+            })->default_value(kDefaultMinFpsRatio), "Set required sustained FPS relative to FPS")
+            ("max-latency", po::value<std::string>()->notifier([this](const std::string& v) {
+                _benchmarkConfig.maxLatency.clear();
+                for (const unsigned latency : splitNumbers(v)) {
+                    _benchmarkConfig.maxLatency.emplace_back(latency);
+                }
+            }), "Set comma separated latency ceilings per preset (ms, 99th percentile)")
+            ("max-drops", po::value<unsigned>()->notifier([this](const unsigned v) {
+                _benchmarkConfig.maxDrops = v;
+            })->default_value(kDefaultMaxDrops), "Set allowed dropped frames count per run")
+            ("log-file", po::value<std::string>()->notifier([this](const std::string& v) {
+                _logFile = v;
+            })->default_value(kDefaultLogFile), "Set log file path")
+        ;
+        // clang-format on
+
+        po::variables_map vm;
+        po::store(po::parse_command_line(argc, argv, d), vm);
+        if (vm.contains("help")) {
+            std::cout << d << std::endl;
+            return false;
+        }
+        if (vm.contains("output-fps")) {
+            /* The drops and latency are measured per captured frame, so no decimation */
+            throw po::error{"the option '--output-fps' isn't supported by bench command"};
+        }
+        po::notify(vm);
+
+        return true;
+    }
+
+    [[nodiscard]] bool
+    parseBatchArgs(const int argc, char* argv[])
+    {
+        po::options_description d{"RawEnc batch CLI (manifest options override the given ones)"};
+        addEncoderOptions(d);
 
         // clang-format off
         d.add_options()
             ("help,h", "Display help")
+            ("manifest", po::value<std::string>()->notifier([this](const std::string& v) {
+                _batchManifest = v;
+            })->required(), "Set manifest file (\"<input> <output> [key=value ...]\" per line)")
+            ("workers", po::value<unsigned>()->notifier([this](const unsigned v) {
+                _batchConfig.workers = v;
+            })->default_value(kDefaultBatchWorkers), "Set encoder workers count (0 - cores count)")
+            ("preset", po::value<std::string>()->notifier([this](const std::string& v) {
+                _encoderConfig.preset = v;
+            }), "Choose encoder preset")
+            ("tune", po::value<std::string>()->notifier([this](const std::string& v) {
+                _encoderConfig.tune = v;
+            }), "Choose encoder tune")
+            ("log-file", po::value<std::string>()->notifier([this](const std::string& v) {
+                _logFile = v;
+            })->default_value(kDefaultLogFile), "Set log file path")
+        ;
+        // clang-format on
+
+        po::variables_map vm;
+        po::store(po::parse_command_line(argc, argv, d), vm);
+        if (vm.contains("help")) {
+            std::cout << d << std::endl;
+            return false;
+        }
+        po::notify(vm);
+
+        return true;
+    }
+
+    void
+    addEncoderOptions(po::options_description& d)
+    {
+        // clang-format off
+        d.add_options()
             ("width", po::value<unsigned>()->notifier([this](const unsigned v) {
                 _cameraConfig.width = _encoderConfig.width = v;
             })->default_value(kDefaultWidth), "Set width")
@@ -48,12 +629,9 @@ public:
             ("fps", po::value<unsigned>()->notifier([this](const unsigned fps) {
                 _encoderConfig.fps = fps;
             })->default_value(kDefaultFps), "Set encoder FPS")
-            ("preset", po::value<std::string>()->notifier([this](const std::string& v) {
-                _encoderConfig.preset = v;
-            }), "Choose encoder preset")
-            ("tune", po::value<std::string>()->notifier([this](const std::string& v) {
-                _encoderConfig.tune = v;
-            }), "Choose encoder tune")
+            ("output-fps", po::value<unsigned>()->notifier([this](const unsigned v) {
+                _encoderConfig.targetFps = v;
+            }), "Set encoded output FPS (the input frames are decimated by their timestamps)")
             ("bitrate", po::value<unsigned>()->notifier([this](const unsigned v) {
                 _encoderConfig.bitrate = v;
             }), "Set encoder bitrate")
@@ -63,76 +641,451 @@ public:
             ("gop-size", po::value<unsigned>()->notifier([this](const unsigned v) {
                 _encoderConfig.gopSize = v;
             }), "Set encoder GOP size")
-            ("b-frames", po::value<unsigned>()->notifier([this](const unsigned v) {
-               _encoderConfig.bFrames = v;
-            }), "Set encoder b-frames count")
+            ("low-latency", po::bool_switch()->notifier([this](const bool v) {
+                _encoderConfig.lowLatency = v;
+            }), "Use intra refresh, single frame VBV and sliced threads to minimize latency")
+            ("slice-max-size", po::value<unsigned>()->notifier([this](const unsigned v) {
+                _encoderConfig.sliceMaxSize = v;
+            }), "Set maximum slice size in low latency mode (default - RTP payload size)")
+            ("encoder-queue-size", po::value<unsigned>()->notifier([this](const unsigned v) {
+                _encoderConfig.queueSize = v;
+            })->default_value(kDefaultEncoderQueueSize), "Set maximum frames waiting for encoding "
+                                                         "(new frames are dropped when full)")
+            ("huge-pages", po::value<bool>()->notifier([this](const bool v) {
+                _encoderConfig.hugePages = v;
+            })->default_value(true), "Allocate encoder frame pool from huge pages")
+            ("numa-node", po::value<int>()->notifier([this](const int v) {
+                _encoderConfig.numaNode = v;
+            }), "Set NUMA node of encoder frame pool (default - the node of main thread)")
         ;
         // clang-format on
+    }
 
-        po::variables_map vm;
-        po::store(po::parse_command_line(argc, argv, d), vm);
-        po::notify(vm);
+    [[nodiscard]] bool
+    runCalibration()
+    {
+        FrameSource source{_encoderConfig.width, _encoderConfig.height};
+        if (_calibrationInput) {
+            if (not source.load(*_calibrationInput, _calibrationConfig.frames)) {
+                LOGE("Unable to load frames from <{}> file", *_calibrationInput);
+                return false;
+            }
+        } else {
+            source.generate(kSyntheticFrames);
+        }
 
-        if (vm.contains("help")) {
-            std::cout << d << std::endl;
+        _calibrationConfig.base = _encoderConfig;
+        const Calibrator calibrator{_calibrationConfig, source};
+        const auto result = calibrator.run();
+        if (not result) {
+            std::cerr << "No encoder config meets the real-time budget and latency ceiling\n";
             return false;
         }
 
-        return true;
+        std::cout << "Best config: preset<" << result->config.preset.value_or("")
+                  << ">, tune<" << result->config.tune.value_or("") << ">, threads<"
+                  << result->config.threads.value_or(0) << ">, b-frames<"
+                  << result->config.bFrames.value_or(0) << ">, fps<" << result->fps
+                  << ">, latency<" << result->latency << "ms>, psnr<" << result->psnr << ">\n";
+        return Calibrator::save(*result, _calibrationOutput);
     }
 
     [[nodiscard]] bool
-    run()
+    runBenchmark()
     {
-        if (not setupEncoder()) {
+        _benchmarkConfig.base = _encoderConfig;
+        const Benchmark benchmark{_benchmarkConfig};
+        const auto results = benchmark.run();
+        if (results.empty()) {
+            std::cerr << "No benchmark run is completed\n";
+            return false;
+        }
+
+        bool passed{true};
+        for (const auto& result : results) {
+            std::cout << (result.passed ? "PASS" : "FAIL") << ": preset<"
+                      << result.config.preset.value_or("") << ">, size<" << result.config.width
+                      << "x" << result.config.height << ">, capture<"
+                      << (result.device ? "device" : "fake") << ">, fps<" << result.fps
+                      << ">, latency<" << result.latencyP99 << "ms>, drops<" << result.drops
+                      << ">\n";
+            passed = passed and result.passed;
+        }
+        /* The failed threshold fails the run, so regressions fail the build */
+        return Benchmark::save(results, _benchmarkOutput) and passed;
+    }
+
+    [[nodiscard]] bool
+    runBatch()
+    {
+        auto jobs = BatchEncoder::loadManifest(_batchManifest, _encoderConfig);
+        if (not jobs) {
+            std::cerr << "Unable to load <" << _batchManifest << "> manifest\n";
+            return false;
+        }
+
+        BatchEncoder batch{_batchConfig};
+        const auto begin = Clock::now();
+        const auto results = batch.run(std::move(*jobs));
+        const std::chrono::duration<double> elapsed = Clock::now() - begin;
+        std::cout << BatchEncoder::report(results, elapsed);
+        return std::ranges::all_of(results, &BatchJobResult::ok);
+    }
+
+    [[nodiscard]] bool
+    runCapture()
+    {
+        _pool.start(_ioThreads);
+        if (_traceFile) {
+            Tracer::instance().enable(_traceBufferSize);
+        }
+        if (not planMemory(_cameraConfig.width, _cameraConfig.height)) {
+            LOGE("Unable to fit memory budget");
+            return false;
+        }
+
+        /* The encoder opening (slow for lookahead) and warm-up overlap with camera setup */
+        auto encoderReady = std::async(std::launch::async, [this] {
+            return setupEncoderAndWarmUp();
+        });
+        const bool cameraReady = setupCamera();
+        if (not encoderReady.get()) {
             LOGE("Unable to setup encoder");
             return false;
         }
-        if (not setupCamera()) {
+        if (not cameraReady) {
             LOGE("Unable to setup camera");
             return false;
         }
+        if (not setupControl()) {
+            LOGE("Unable to setup control server");
+            return false;
+        }
 
+        _encoderStats->start();
         _encoder.start();
+        if (_snapshotter) {
+            _snapshotter->start();
+        }
+        if (_eventRecorder) {
+            _eventRecorder->start();
+        }
         if (not _camera.start()) {
             LOGE("Unable to start camera");
             return false;
         }
+        LOGI("Time to start: <{}ms>", elapsedMs());
 
         waitForTermination();
 
         _camera.stop();
+        if (_control) {
+            _control->stop();
+        }
+        if (_snapshotter) {
+            _snapshotter->stop();
+        }
         _encoder.stop();
         _encoder.finalize();
+        _recording.close();
+        if (_streamServer) {
+            _streamServer->stop();
+        }
+        if (_eventRecorder) {
+            _eventRecorder->stop();
+        }
+        if (_sink) {
+            _sink->stop();
+        }
+        _encoderStats->stop();
+        LOGI("Encoder stats:\n{}", _encoderStats->report());
+        if (_traceFile) {
+            std::ignore = Tracer::instance().write(*_traceFile);
+        }
 
         return true;
     }
 
-private:
-    [[maybe_unused]] bool
+    [[nodiscard]] bool
+    runSpool()
+    {
+        _pool.start(_ioThreads);
+        if (not _camera.configure(_cameraConfig)) {
+            LOGE("Unable to configure camera");
+            return false;
+        }
+
+        _spoolConfig.width = _cameraConfig.width;
+        _spoolConfig.height = _cameraConfig.height;
+        Spooler spooler{_spoolConfig};
+        if (not spooler.start()) {
+            LOGE("Unable to start spooler");
+            return false;
+        }
+
+        _camera.onFrameReady().connect([&spooler](const CapturedFrame& frame) {
+            LOGT("Frame: index<{}>, data<{}>, size<{}>",
+                 frame.sequence,
+                 fmt::ptr(frame.data),
+                 frame.size);
+            spooler.write(frame);
+        });
+        if (not _camera.start()) {
+            LOGE("Unable to start camera");
+            return false;
+        }
+
+        waitForTermination();
+
+        _camera.stop();
+        spooler.stop();
+        return true;
+    }
+
+    [[nodiscard]] bool
+    runReplay()
+    {
+        _pool.start(_ioThreads);
+        SpoolReader reader;
+        if (not reader.open(*_input)) {
+            LOGE("Unable to open <{}> input", *_input);
+            return false;
+        }
+
+        _encoderConfig.width = reader.width();
+        _encoderConfig.height = reader.height();
+        if (not planMemory(reader.width(), reader.height())) {
+            LOGE("Unable to fit memory budget");
+            return false;
+        }
+        if (not setupEncoderAndWarmUp()) {
+            LOGE("Unable to setup encoder");
+            return false;
+        }
+
+        _encoderStats->start();
+        _encoder.start();
+        SpoolFrame frame;
+        for (uint64_t n = 0; n < reader.frameCount() and reader.read(n, frame); ++n) {
+            /* Wait for room in the encoder queue (it may be reduced by memory budget), so no
+             * frame is dropped and the whole file isn't loaded into memory */
+            _encoder.waitPending(std::max(1u, _encoderConfig.queueSize) - 1);
+            _encoder.encode(frame.sequence, frame.timestamp, frame.data, frame.size);
+        }
+        _encoder.waitPending(0);
+        _encoder.stop();
+        _encoder.finalize();
+        _recording.close();
+        if (_streamServer) {
+            _streamServer->stop();
+        }
+        if (_sink) {
+            _sink->stop();
+        }
+        _encoderStats->stop();
+        LOGI("Encoder stats:\n{}", _encoderStats->report());
+        return true;
+    }
+
+    /* Divide memory budget among components and adapt their configs to granted units */
+    [[nodiscard]] bool
+    planMemory(const unsigned width, const unsigned height)
+    {
+        const std::size_t frameSize = std::size_t{width} * height * 3 / 2;
+        /* The encoder keeps padded frame with lowres planes for each internal frame */
+        const std::size_t encoderFrameSize = frameSize * 5 / 2;
+        const bool capture = not _input;
+        const bool zeroLatency = _encoderConfig.lowLatency or _encoderConfig.tune == "zerolatency";
+        const bool sink = (_output and not _rtpEnabled) or not _eventConfig.directory.empty();
+
+        const unsigned threads = _encoderConfig.threads.value_or(0) > 0
+                                     ? *_encoderConfig.threads
+                                     : std::max(1u, std::thread::hardware_concurrency());
+        const unsigned lookahead
+            = _encoderConfig.lookahead.value_or(zeroLatency ? 0 : kDefaultLookahead);
+
+        _memory = std::make_unique<MemoryBudget>(_memoryBudget);
+        if (capture) {
+            _memory->demand({.name = "capture",
+                             .unitSize = frameSize,
+                             .units = _cameraConfig.bufferCount,
+                             .minUnits = 2});
+        }
+        _memory->demand({.name = "encoder queue",
+                         .unitSize = frameSize,
+                         .units = _encoderConfig.queueSize,
+                         .minUnits = 2});
+        /* The reference and B-frames are kept regardless of threads count */
+        const unsigned references = kDefaultReferenceFrames + _encoderConfig.bFrames.value_or(0);
+        _memory->demand({.name = "encoder threads",
+                         .unitSize = encoderFrameSize,
+                         .units = threads,
+                         .minUnits = 1,
+                         .fixed = encoderFrameSize * references});
+        _memory->demand({.name = "encoder lookahead",
+                         .unitSize = encoderFrameSize,
+                         .units = lookahead,
+                         .minUnits = 0});
+        if (sink) {
+            _memory->demand({.name = "file sink",
+                             .unitSize = _sinkConfig.bufferSize,
+                             .units = _sinkConfig.bufferCount,
+                             .minUnits = 4});
+        }
+        if (not _eventConfig.directory.empty()) {
+            _memory->demand({.name = "pre-roll",
+                             .unitSize = std::size_t{1024} * 1024,
+                             .units = _preRollConfig.budget / (1024 * 1024),
+                             .minUnits = 1});
+        }
+        if (not _streamConfig.socketPath.empty()) {
+            /* The GOP cache and queue of single client */
+            _memory->demand({.name = "stream server",
+                             .fixed = _streamConfig.cacheBudget + _streamConfig.clientBudget});
+        }
+        if (capture and _frameBusName) {
+            _memory->demand({.name = "frame bus",
+                             .unitSize = frameSize,
+                             .units = _frameBusSlots,
+                             .minUnits = 2});
+        }
+        if (capture and _controlSocket) {
+            _memory->demand({.name = "snapshot", .fixed = frameSize});
+        }
+        if (_loggerConfig.async) {
+            /* The logger is already running, so its queue is only accounted */
+            _memory->demand(
+                {.name = "log queue", .fixed = _loggerConfig.queueSize * kLogMessageSize});
+        }
+        if (not _memory->plan()) {
+            return false;
+        }
+
+        _cameraConfig.bufferCount = static_cast<unsigned>(_memory->granted("capture"));
+        _encoderConfig.queueSize = static_cast<unsigned>(_memory->granted("encoder queue"));
+        /* The encoder own choices are kept unless they had to be reduced */
+        if (const auto granted = _memory->granted("encoder threads"); granted < threads) {
+            _encoderConfig.threads = static_cast<unsigned>(granted);
+        }
+        if (const auto granted = _memory->granted("encoder lookahead"); granted < lookahead) {
+            _encoderConfig.lookahead = static_cast<unsigned>(granted);
+        }
+        if (sink) {
+            _sinkConfig.bufferCount = static_cast<unsigned>(_memory->granted("file sink"));
+        }
+        if (not _eventConfig.directory.empty()) {
+            _preRollConfig.budget = _memory->granted("pre-roll") * 1024 * 1024;
+        }
+        if (capture and _frameBusName) {
+            _frameBusSlots = static_cast<unsigned>(_memory->granted("frame bus"));
+        }
+        /*
+         * The frame pool also holds frames referenced by encoder threads and lookahead (accounted
+         * by their own plans), so only the frames waiting in queue are reported
+         */
+        _memory->track("encoder queue",
+                       [this, frameSize] { return _encoder.pending() * frameSize; });
+        return true;
+    }
+
+    void
     waitForTermination()
     {
-        asio::signal_set signals(_context, SIGINT, SIGTERM);
-        signals.async_wait([this](const auto& /*error*/, int signal) {
-            if (not _context.stopped()) {
-                _context.stop();
+        std::promise<void> terminated;
+        _signals.add(SIGINT);
+        _signals.add(SIGTERM);
+        _signals.async_wait([&terminated](const auto& error, int /*signal*/) {
+            if (not error) {
+                terminated.set_value();
+            }
+        });
+        if (_traceFile) {
+            _traceSignals.add(SIGUSR1);
+            waitForTraceSignal();
+        }
+        terminated.get_future().wait();
+    }
+
+    void
+    waitForTraceSignal()
+    {
+        _traceSignals.async_wait([this](const auto& error, int /*signal*/) {
+            if (not error) {
+                std::ignore = Tracer::instance().write(*_traceFile);
+                waitForTraceSignal();
             }
         });
-        return (_context.run() > 0);
     }
 
     [[nodiscard]] bool
-    setupEncoder() const
+    setupEncoder()
     {
+        if (_encoderConfig.lowLatency and _rtpEnabled and not _encoderConfig.sliceMaxSize) {
+            /* Each slice is sent as single NAL unit packet instead of fragments */
+            _encoderConfig.sliceMaxSize = static_cast<unsigned>(_rtpConfig.mtu - kRtpHeaderSize);
+        }
         if (not _encoder.configure(_encoderConfig)) {
             LOGE("Unable to configure encoder");
             return false;
         }
 
-        _encoder.onPacketReady().connect([](const EncodedPacket& packet) {
+        const bool hevc = _encoderConfig.codec.find("265") != std::string::npos
+                          or _encoderConfig.codec.find("hevc") != std::string::npos;
+        if ((_output and not _rtpEnabled) or not _eventConfig.directory.empty()) {
+            /* All recordings share single sink */
+            _sink = std::make_unique<FileSink>(_sinkConfig);
+            if (not _sink->start()) {
+                LOGE("Unable to start file sink");
+                return false;
+            }
+        }
+        if (_rtpEnabled) {
+            _rtpConfig.codec = hevc ? RtpCodec::H265 : RtpCodec::H264;
+            _rtpConfig.fps = _encoder.outputFps();
+            _rtpSender = std::make_unique<RtpSender>(_rtpConfig);
+            if (not _rtpSender->open()) {
+                LOGE("Unable to open RTP sender");
+                return false;
+            }
+        } else if (_output) {
+            const auto fps = static_cast<int32_t>(_encoder.outputFps());
+            if (not _recording.open(*_output, 1, fps, _sink.get())) {
+                LOGE("Unable to open <{}> output", *_output);
+                return false;
+            }
+        }
+        if (not _streamConfig.socketPath.empty()) {
+            _streamConfig.codec = hevc ? RtpCodec::H265 : RtpCodec::H264;
+            _streamServer = std::make_unique<StreamServer>(_context.get_executor(), _streamConfig);
+            if (not _streamServer->start()) {
+                LOGE("Unable to start stream server");
+                return false;
+            }
+        }
+        _statsConfig.fps = _encoder.outputFps();
+        _encoderStats = std::make_unique<EncoderStats>(_statsConfig);
+        if (not _eventConfig.directory.empty()) {
+            _eventConfig.extension = hevc ? ".h265" : ".h264";
+            _eventConfig.fps = _encoder.outputFps();
+            _preRoll = std::make_unique<PreRollBuffer>(_preRollConfig);
+            _eventRecorder = std::make_unique<EventRecorder>(*_preRoll, _eventConfig, _sink.get());
+        }
+
+        _packetFanOut = std::make_unique<PacketFanOut>(
+            PacketOutputStage{_rtpSender.get(), _output ? &_recording : nullptr},
+            PacketStreamStage{_streamServer.get()},
+            PacketPreRollStage{_preRoll.get()},
+            PacketStatsSink{_encoderStats.get()});
+        /*
+         * The signal is the only type-erased hop, the stages run inline on the encoder thread (the
+         * outputs doing blocking I/O queue it themselves)
+         */
+        _encoder.onPacketReady().connect([this](const EncodedPacket& packet) {
             LOGT("Packet: data<{}>, size<{}>", fmt::ptr(packet.data), packet.size);
-            fwrite(packet.data, 1, packet.size, stdout);
-            fflush(stdout);
+            if (_firstPacket.exchange(false, std::memory_order_relaxed)) {
+                LOGI("Time to first packet: <{}ms>", elapsedMs());
+            }
+            _packetFanOut->push(packet);
         });
 
         return true;
@@ -146,23 +1099,155 @@ private:
             return false;
         }
 
+        if (_controlSocket) {
+            _snapshotConfig.width = _cameraConfig.width;
+            _snapshotConfig.height = _cameraConfig.height;
+            const unsigned frameSize = _cameraConfig.width * _cameraConfig.height * 3 / 2;
+            _frameSlot = std::make_unique<FrameSlot>(frameSize);
+            _snapshotter = std::make_unique<Snapshotter>(*_frameSlot, _snapshotConfig);
+        }
+        if (_frameBusName) {
+            _frameBus = std::make_unique<FrameBusPublisher>();
+            if (not _frameBus->open(
+                    *_frameBusName, _cameraConfig.width, _cameraConfig.height, _frameBusSlots)) {
+                LOGE("Unable to open frame bus");
+                return false;
+            }
+        }
+
         _camera.onFrameReady().connect([this](const CapturedFrame& frame) {
             LOGT("Frame: index<{}>, data<{}>, size<{}>",
                  frame.sequence,
                  fmt::ptr(frame.data),
                  frame.size);
-            _encoder.encode(frame.sequence, frame.data, frame.size);
+            if (_firstFrame.exchange(false, std::memory_order_relaxed)) {
+                LOGI("Time to first frame: <{}ms>", elapsedMs());
+            }
+            if (frame.resumed) {
+                /* The decoders downstream recover from the capture gap at once */
+                _encoder.requestKeyframe();
+            }
+            _encoder.encode(frame.sequence, frame.timestamp, frame.data, frame.size);
+            if (_frameSlot) {
+                _frameSlot->publish(frame);
+            }
+            if (_frameBus) {
+                TRACE_SCOPE("FrameBus::publish");
+                _frameBus->publish(frame.sequence, frame.timestamp, frame.data, frame.size);
+            }
         });
 
         return true;
     }
 
+    [[nodiscard]] bool
+    setupControl()
+    {
+        if (not _controlSocket) {
+            return true;
+        }
+
+        _control = std::make_unique<ControlServer>(_context.get_executor(), *_controlSocket);
+        _control->addCommand("snapshot", [this](const auto& args, auto responder) {
+            /* snapshot [jpeg|png] [width] */
+            const auto format = Snapshotter::parseFormat(args.size() > 1 ? args[1] : "jpeg");
+            if (not format) {
+                responder("error: unknown format\n");
+                return;
+            }
+            unsigned width{};
+            if (args.size() > 2) {
+                width = static_cast<unsigned>(std::strtoul(args[2].data(), nullptr, 10));
+            }
+            _snapshotter->request(*format, width, std::move(responder));
+        });
+        _control->addCommand("stats", [this](const auto& /*args*/, auto responder) {
+            /* stats */
+            responder(_encoderStats->report());
+        });
+        _control->addCommand("memory", [this](const auto& /*args*/, auto responder) {
+            /* memory */
+            responder(_memory->report());
+        });
+        _control->addCommand("sink", [this](const auto& /*args*/, auto responder) {
+            /* sink */
+            if (not _sink) {
+                responder("error: recording is disabled\n");
+                return;
+            }
+            responder(_sink->report());
+        });
+        _control->addCommand("trigger", [this](const auto& args, auto responder) {
+            /* trigger [duration] */
+            if (not _eventRecorder) {
+                responder("error: event recording is disabled\n");
+                return;
+            }
+            std::optional<std::chrono::milliseconds> duration;
+            if (args.size() > 1) {
+                duration = std::chrono::seconds{std::strtoul(args[1].data(), nullptr, 10)};
+            }
+            responder("ok " + _eventRecorder->trigger(duration).string() + "\n");
+        });
+
+        return _control->start();
+    }
+
 private:
     asio::io_context _context;
-    Camera _camera;
+    /* The signal sets and I/O threads outlive the components served on them */
+    asio::signal_set _signals{_context};
+    asio::signal_set _traceSignals{_context};
+    IoPool _pool{_context};
+    unsigned _ioThreads{kDefaultIoThreads};
+    Camera _camera{_context.get_executor()};
     CameraConfig _cameraConfig;
-    Encoder _encoder;
+    Encoder _encoder{_context.get_executor()};
     EncoderConfig _encoderConfig;
+    EncoderStatsConfig _statsConfig;
+    std::unique_ptr<EncoderStats> _encoderStats;
+    std::optional<std::string> _controlSocket;
+    SnapshotConfig _snapshotConfig;
+    std::unique_ptr<FrameSlot> _frameSlot;
+    std::unique_ptr<Snapshotter> _snapshotter;
+    std::optional<std::string> _frameBusName;
+    unsigned _frameBusSlots{kDefaultFrameBusSlots};
+    std::unique_ptr<FrameBusPublisher> _frameBus;
+    FileSinkConfig _sinkConfig;
+    std::unique_ptr<FileSink> _sink;
+    PreRollConfig _preRollConfig;
+    EventRecorderConfig _eventConfig;
+    std::unique_ptr<PreRollBuffer> _preRoll;
+    std::unique_ptr<EventRecorder> _eventRecorder;
+    std::unique_ptr<ControlServer> _control;
+    StreamServerConfig _streamConfig;
+    std::unique_ptr<StreamServer> _streamServer;
+    RtpSenderConfig _rtpConfig;
+    bool _rtpEnabled{false};
+    std::unique_ptr<RtpSender> _rtpSender;
+    std::unique_ptr<PacketFanOut> _packetFanOut;
+    std::string _logFile;
+    LoggerConfig _loggerConfig;
+    std::optional<std::string> _traceFile;
+    std::optional<std::string> _input;
+    std::optional<std::string> _output;
+    RecordingFile _recording;
+    SpoolConfig _spoolConfig;
+    std::size_t _traceBufferSize{kDefaultTraceBufferSize};
+    std::size_t _memoryBudget{};
+    std::unique_ptr<MemoryBudget> _memory;
+    Mode _mode{Mode::Capture};
+    unsigned _warmUpFrames{kDefaultWarmUpFrames};
+    Clock::time_point _startTime;
+    std::atomic<bool> _firstFrame{true};
+    std::atomic<bool> _firstPacket{true};
+    CalibrationConfig _calibrationConfig;
+    std::optional<std::string> _calibrationInput;
+    std::string _calibrationOutput;
+    BenchmarkConfig _benchmarkConfig;
+    std::string _benchmarkOutput;
+    BatchConfig _batchConfig;
+    std::string _batchManifest;
 };
 
 } // namespace jar
@@ -170,11 +1255,18 @@ private:
 int
 main(int argc, char* argv[])
 {
-    jar::LoggerInitializer::instance().initialize("rawenc.log");
-    jar::Application app;
-    if (not app.parseArgs(argc, argv)) {
-        /* Show help menu and exit */
-        return EXIT_SUCCESS;
+    auto& logger = jar::LoggerInitializer::instance();
+    bool ok{false};
+    {
+        jar::Application app;
+        if (not app.parseArgs(argc, argv)) {
+            /* Show help menu and exit */
+            return EXIT_SUCCESS;
+        }
+        logger.initialize(app.logFile(), app.loggerConfig());
+        ok = app.run();
     }
-    return app.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+    /* Drain pending log messages after all components are destroyed */
+    logger.finalize();
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -0,0 +1,443 @@
+#include "BatchEncoder.hpp"
+
+#include "Logger.hpp"
+#include "RecordingFile.hpp"
+#include "SpoolReader.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <numeric>
+#include <sstream>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+namespace jar {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+/* Reads frames of raw YUV420 or spool file one by one */
+class ClipReader {
+public:
+    ClipReader() = default;
+
+    ~ClipReader()
+    {
+        if (_file) {
+            fclose(_file);
+        }
+    }
+
+    ClipReader(const ClipReader&) = delete;
+    ClipReader&
+    operator=(const ClipReader&)
+        = delete;
+
+    /* Open clip, the frame size of raw file is given (spool file defines its own) */
+    [[nodiscard]] bool
+    open(const fs::path& path, const unsigned width, const unsigned height)
+    {
+        if (_spool.open(path)) {
+            _width = _spool.width();
+            _height = _spool.height();
+            return true;
+        }
+        _file = fopen(path.c_str(), "rb");
+        if (not _file) {
+            LOGE("Unable to open <{}> file: {}", path, strerror(errno));
+            return false;
+        }
+        _width = width;
+        _height = height;
+        _buffer.resize(frameSize());
+        return true;
+    }
+
+    [[nodiscard]] unsigned
+    width() const
+    {
+        return _width;
+    }
+
+    [[nodiscard]] unsigned
+    height() const
+    {
+        return _height;
+    }
+
+    [[nodiscard]] std::size_t
+    frameSize() const
+    {
+        return std::size_t{_width} * _height * 3 / 2;
+    }
+
+    /* Whether reading stopped on invalid frame (not at the end of clip) */
+    [[nodiscard]] bool
+    failed() const
+    {
+        return _failed;
+    }
+
+    [[nodiscard]] bool
+    read(SpoolFrame& frame)
+    {
+        if (not _file) {
+            if (_index == _spool.frameCount()) {
+                return false;
+            }
+            if (not _spool.read(_index, frame)) {
+                LOGE("Unable to read <{}> frame of spool file", _index);
+                _failed = true;
+                return false;
+            }
+            if (frame.size != frameSize()) {
+                LOGE("Spool frame <{}> has invalid size: {} != {}",
+                     _index,
+                     frame.size,
+                     frameSize());
+                _failed = true;
+                return false;
+            }
+            ++_index;
+            return true;
+        }
+        if (const auto size = fread(_buffer.data(), 1, _buffer.size(), _file);
+            size != _buffer.size()) {
+            if (size > 0 or ferror(_file)) {
+                LOGE("Unable to read <{}> frame of raw file: size<{}>", _index, size);
+                _failed = true;
+            }
+            return false;
+        }
+        /* The raw frames have no timestamps, so pts follow the sequence */
+        frame = SpoolFrame{.sequence = static_cast<unsigned>(_index++),
+                           .timestamp = 0,
+                           .data = _buffer.data(),
+                           .size = static_cast<unsigned>(_buffer.size())};
+        return true;
+    }
+
+private:
+    SpoolReader _spool;
+    FILE* _file{};
+    std::vector<uint8_t> _buffer;
+    uint64_t _index{};
+    unsigned _width{};
+    unsigned _height{};
+    bool _failed{false};
+};
+
+[[nodiscard]] std::optional<unsigned>
+parseNumber(const std::string_view value)
+{
+    unsigned output{};
+    const auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), output);
+    if (ec != std::errc{} or ptr != value.data() + value.size()) {
+        return std::nullopt;
+    }
+    return output;
+}
+
+/* Apply "key=value" option of manifest to encoder config */
+[[nodiscard]] bool
+applyOption(EncoderConfig& config, const std::string_view option)
+{
+    const auto separator = option.find('=');
+    if (separator == std::string_view::npos) {
+        return false;
+    }
+    const auto key = option.substr(0, separator);
+    const auto value = option.substr(separator + 1);
+    if (key == "codec") {
+        config.codec = value;
+        return true;
+    }
+    if (key == "preset") {
+        config.preset = std::string{value};
+        return true;
+    }
+    if (key == "tune") {
+        config.tune = std::string{value};
+        return true;
+    }
+
+    const auto number = parseNumber(value);
+    if (not number) {
+        return false;
+    }
+    if (key == "width") {
+        config.width = *number;
+    } else if (key == "height") {
+        config.height = *number;
+    } else if (key == "fps") {
+        config.fps = *number;
+    } else if (key == "bitrate") {
+        config.bitrate = *number;
+    } else if (key == "crf") {
+        config.crf = *number;
+    } else if (key == "gop-size") {
+        config.gopSize = *number;
+    } else if (key == "b-frames") {
+        config.bFrames = *number;
+    } else if (key == "threads") {
+        config.threads = *number;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+BatchEncoder::BatchEncoder(BatchConfig config)
+    : _config{std::move(config)}
+{
+}
+
+std::optional<std::vector<BatchJob>>
+BatchEncoder::loadManifest(const fs::path& path, const EncoderConfig& base)
+{
+    std::ifstream is{path};
+    if (not is) {
+        LOGE("Unable to open <{}> manifest", path);
+        return std::nullopt;
+    }
+
+    std::vector<BatchJob> jobs;
+    std::string line;
+    for (unsigned number = 1; std::getline(is, line); ++number) {
+        std::istringstream tokens{line};
+        std::string input, output;
+        if (not(tokens >> input) or input.starts_with('#')) {
+            continue;
+        }
+        if (not(tokens >> output)) {
+            LOGE("Manifest line <{}> has no output", number);
+            return std::nullopt;
+        }
+        BatchJob job{.input = input, .output = output, .config = base};
+        for (std::string option; tokens >> option;) {
+            if (not applyOption(job.config, option)) {
+                LOGE("Manifest line <{}> has invalid <{}> option", number, option);
+                return std::nullopt;
+            }
+        }
+        jobs.push_back(std::move(job));
+    }
+
+    if (jobs.empty()) {
+        LOGE("Manifest <{}> has no jobs", path);
+        return std::nullopt;
+    }
+    return jobs;
+}
+
+std::vector<BatchJobResult>
+BatchEncoder::run(std::vector<BatchJob> jobs)
+{
+    const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    const unsigned workers = (_config.workers > 0) ? _config.workers : cores;
+    for (auto& job : jobs) {
+        if (not job.config.threads) {
+            job.config.threads = std::max(1u, cores / workers);
+        }
+    }
+    _jobs = std::move(jobs);
+    _results.assign(_jobs.size(), BatchJobResult{});
+
+    /* The jobs with the same config are made adjacent, so each worker gets runs of them */
+    std::vector<EncoderConfig> configs;
+    std::vector<std::size_t> groups(_jobs.size());
+    for (std::size_t n = 0; n < _jobs.size(); ++n) {
+        const auto it = std::ranges::find(configs, _jobs[n].config);
+        groups[n] = static_cast<std::size_t>(std::distance(configs.begin(), it));
+        if (it == configs.end()) {
+            configs.push_back(_jobs[n].config);
+        }
+    }
+    std::vector<std::size_t> order(_jobs.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::ranges::stable_sort(order, {}, [&groups](const std::size_t n) { return groups[n]; });
+
+    _queues.clear();
+    for (unsigned n = 0; n < workers; ++n) {
+        _queues.push_back(std::make_unique<Queue>());
+    }
+    for (std::size_t n = 0; n < order.size(); ++n) {
+        _queues[n * workers / order.size()]->jobs.push_back(order[n]);
+    }
+
+    LOGI("Batch: jobs<{}>, configs<{}>, workers<{}>", _jobs.size(), configs.size(), workers);
+    /* The encoders of workers are served by own threads (as in capture mode), the feeders only
+     * read clips and sleep while encoder queue is full, so they don't compete for cores */
+    _pool = std::make_unique<boost::asio::thread_pool>(workers);
+    {
+        std::vector<std::jthread> threads;
+        for (unsigned n = 0; n < workers; ++n) {
+            threads.emplace_back([this, n] { handleWorker(n); });
+        }
+    }
+    _pool->join();
+    _pool.reset();
+    return std::move(_results);
+}
+
+std::string
+BatchEncoder::report(const std::vector<BatchJobResult>& results,
+                     const std::chrono::duration<double> elapsed)
+{
+    uint64_t frames{}, bytes{};
+    std::size_t succeeded{}, reused{}, stolen{};
+    for (const auto& result : results) {
+        frames += result.frames;
+        bytes += result.bytes;
+        succeeded += result.ok ? 1 : 0;
+        reused += result.reused ? 1 : 0;
+        stolen += result.stolen ? 1 : 0;
+    }
+
+    std::string out;
+    auto it = std::back_inserter(out);
+    fmt::format_to(it,
+                   "batch: jobs<{}/{}>, frames<{}>, size<{:.1f}MiB>, elapsed<{:.1f}s>, "
+                   "fps<{:.1f}>, reused<{}>, stolen<{}>\n",
+                   succeeded,
+                   results.size(),
+                   frames,
+                   static_cast<double>(bytes) / (1024.0 * 1024.0),
+                   elapsed.count(),
+                   (elapsed.count() > 0.0) ? static_cast<double>(frames) / elapsed.count() : 0.0,
+                   reused,
+                   stolen);
+    for (const auto& result : results) {
+        const double seconds = result.duration.count();
+        fmt::format_to(it,
+                       "{}: ok<{}>, worker<{}>, frames<{}>, fps<{:.1f}>, size<{}>, reused<{}>, "
+                       "stolen<{}>\n",
+                       result.input,
+                       result.ok,
+                       result.worker,
+                       result.frames,
+                       (seconds > 0.0) ? static_cast<double>(result.frames) / seconds : 0.0,
+                       result.bytes,
+                       result.reused,
+                       result.stolen);
+    }
+    return out;
+}
+
+std::optional<std::size_t>
+BatchEncoder::takeJob(const unsigned worker, bool& stolen)
+{
+    {
+        Queue& own = *_queues[worker];
+        std::scoped_lock lock{own.guard};
+        if (not own.jobs.empty()) {
+            const std::size_t job = own.jobs.front();
+            own.jobs.pop_front();
+            stolen = false;
+            return job;
+        }
+    }
+
+    /* Steal from the tail of the longest queue (the last jobs its owner would reach) */
+    while (true) {
+        Queue* victim{};
+        std::size_t longest{};
+        for (const auto& queue : _queues) {
+            std::scoped_lock lock{queue->guard};
+            if (queue->jobs.size() > longest) {
+                longest = queue->jobs.size();
+                victim = queue.get();
+            }
+        }
+        if (not victim) {
+            /* No jobs are added while running, so all of them are taken */
+            return std::nullopt;
+        }
+        std::scoped_lock lock{victim->guard};
+        if (not victim->jobs.empty()) {
+            const std::size_t job = victim->jobs.back();
+            victim->jobs.pop_back();
+            stolen = true;
+            return job;
+        }
+    }
+}
+
+void
+BatchEncoder::handleWorker(const unsigned index)
+{
+    Worker worker;
+    bool stolen{false};
+    while (const auto job = takeJob(index, stolen)) {
+        BatchJobResult& result = _results[*job];
+        result.input = _jobs[*job].input;
+        result.worker = index;
+        result.stolen = stolen;
+
+        const auto begin = Clock::now();
+        result.ok = transcode(worker, _jobs[*job], result);
+        result.duration = Clock::now() - begin;
+        if (not result.ok) {
+            LOGE("Unable to encode <{}> input", result.input);
+        }
+    }
+}
+
+bool
+BatchEncoder::transcode(Worker& worker, const BatchJob& job, BatchJobResult& result)
+{
+    ClipReader reader;
+    if (not reader.open(job.input, job.config.width, job.config.height)) {
+        return false;
+    }
+    EncoderConfig config{job.config};
+    config.width = reader.width();
+    config.height = reader.height();
+
+    /* The finalized encoder of the previous job is reset if the config matches */
+    result.reused = worker.encoder and worker.config == config and worker.encoder->reset();
+    if (not result.reused) {
+        worker.config.reset();
+        worker.encoder = std::make_unique<Encoder>(_pool->get_executor());
+        if (not worker.encoder->configure(config)) {
+            worker.encoder.reset();
+            return false;
+        }
+        worker.config = config;
+    }
+    const Encoder& encoder = *worker.encoder;
+
+    RecordingFile file;
+    if (not file.open(job.output, 1, static_cast<int32_t>(encoder.outputFps()))) {
+        return false;
+    }
+    auto connection = encoder.onPacketReady().connect([&file](const EncodedPacket& packet) {
+        std::ignore = file.write(packet.data, packet.size, packet.pts, packet.key);
+    });
+
+    encoder.start();
+    SpoolFrame frame;
+    while (reader.read(frame)) {
+        /* The encoder queue never overflows, so no frame is dropped */
+        encoder.waitPending(std::max(1u, config.queueSize) - 1);
+        encoder.encode(frame.sequence, frame.timestamp, frame.data, frame.size);
+        ++result.frames;
+    }
+    encoder.waitPending(0);
+    encoder.stop();
+    encoder.finalize();
+    connection.disconnect();
+
+    result.bytes = file.bytes();
+    file.close();
+    return result.frames > 0 and not reader.failed();
+}
+
+} // namespace jar
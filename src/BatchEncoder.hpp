@@ -0,0 +1,97 @@
+#pragma once
+
+#include "Encoder.hpp"
+
+#include <boost/asio/thread_pool.hpp>
+
+#include <chrono>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace jar {
+
+struct BatchJob {
+    /* The raw YUV420 or spool file */
+    std::filesystem::path input;
+    std::filesystem::path output;
+    EncoderConfig config;
+};
+
+struct BatchJobResult {
+    std::filesystem::path input;
+    bool ok{false};
+    uint64_t frames{};
+    uint64_t bytes{};
+    std::chrono::duration<double> duration{};
+    unsigned worker{};
+    /* Whether the job was encoded by the encoder of previous job (same config) */
+    bool reused{false};
+    /* Whether the job was stolen from the queue of other worker */
+    bool stolen{false};
+};
+
+struct BatchConfig {
+    /* The number of encoder workers (0 - hardware concurrency) */
+    unsigned workers{0};
+};
+
+/*
+ * Encodes many raw clips on a pool of encoder workers. The jobs with the same config are queued
+ * one after another to the same worker, so the worker keeps its encoder (the codec context is
+ * flushed, the frame pool is reused) between them. The idle worker steals jobs from the tail of
+ * the busiest queue. The encoder threads default to the share of cores of each worker, so the
+ * workers don't oversubscribe cores.
+ */
+class BatchEncoder {
+public:
+    explicit BatchEncoder(BatchConfig config);
+
+    /*
+     * Load jobs from manifest, one job per line: "<input> <output> [key=value ...]", where keys
+     * are width, height, fps, codec, preset, tune, bitrate, crf, gop-size, b-frames and threads
+     * (the base config is used for omitted ones, spool inputs define their own frame size)
+     */
+    [[nodiscard]] static std::optional<std::vector<BatchJob>>
+    loadManifest(const std::filesystem::path& path, const EncoderConfig& base);
+
+    [[nodiscard]] std::vector<BatchJobResult>
+    run(std::vector<BatchJob> jobs);
+
+    [[nodiscard]] static std::string
+    report(const std::vector<BatchJobResult>& results, std::chrono::duration<double> elapsed);
+
+private:
+    struct Queue {
+        std::mutex guard;
+        std::deque<std::size_t> jobs;
+    };
+
+    struct Worker {
+        std::unique_ptr<Encoder> encoder;
+        std::optional<EncoderConfig> config;
+    };
+
+    /* Take the next job of worker or steal one from other worker */
+    [[nodiscard]] std::optional<std::size_t>
+    takeJob(unsigned worker, bool& stolen);
+
+    void
+    handleWorker(unsigned index);
+
+    [[nodiscard]] bool
+    transcode(Worker& worker, const BatchJob& job, BatchJobResult& result);
+
+private:
+    BatchConfig _config;
+    std::vector<BatchJob> _jobs;
+    std::vector<BatchJobResult> _results;
+    std::vector<std::unique_ptr<Queue>> _queues;
+    std::unique_ptr<boost::asio::thread_pool> _pool;
+};
+
+} // namespace jar
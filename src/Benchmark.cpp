@@ -0,0 +1,248 @@
+#include "Benchmark.hpp"
+
+#include "Camera.hpp"
+#include "FrameSource.hpp"
+#include "Logger.hpp"
+
+#include <boost/asio/thread_pool.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <future>
+#include <thread>
+
+namespace jar {
+
+namespace {
+
+/* The number of distinct synthetic frames served by fake capture */
+constexpr std::size_t kSourceFrames = 30;
+/* The extra time given to device to deliver all frames */
+constexpr std::chrono::seconds kDeviceTimeout{5};
+
+double
+percentile(std::vector<double> values, const double ratio)
+{
+    if (values.empty()) {
+        return 0.0;
+    }
+    const auto n = static_cast<std::ptrdiff_t>(ratio * static_cast<double>(values.size() - 1));
+    std::nth_element(values.begin(), values.begin() + n, values.end());
+    return values[n];
+}
+
+} // namespace
+
+Benchmark::Benchmark(BenchmarkConfig config)
+    : _config{std::move(config)}
+{
+}
+
+std::vector<BenchmarkResult>
+Benchmark::run() const
+{
+    std::vector<BenchmarkResult> results;
+    for (const auto& [width, height] : _config.resolutions) {
+        for (std::size_t n = 0; n < _config.presets.size(); ++n) {
+            EncoderConfig config{_config.base};
+            /* Each captured frame is encoded (the packets are paired with frames by pts) */
+            config.targetFps.reset();
+            config.width = width;
+            config.height = height;
+            config.preset = _config.presets[n];
+            auto maxLatency = std::chrono::milliseconds::max();
+            if (not _config.maxLatency.empty()) {
+                maxLatency = _config.maxLatency[std::min(n, _config.maxLatency.size() - 1)];
+            }
+
+            const auto result = measure(config, maxLatency);
+            if (not result) {
+                continue;
+            }
+            LOGI("Benchmark: preset<{}>, size<{}x{}>, device<{}>: fps<{:.1f}>, latency<{:.1f}ms>, "
+                 "drops<{}>, passed<{}>",
+                 config.preset,
+                 width,
+                 height,
+                 result->device,
+                 result->fps,
+                 result->latencyP99,
+                 result->drops,
+                 result->passed);
+            results.push_back(*result);
+        }
+    }
+    return results;
+}
+
+bool
+Benchmark::save(const std::vector<BenchmarkResult>& results, const std::filesystem::path& path)
+{
+    std::ofstream os{path};
+    if (not os) {
+        LOGE("Unable to open <{}> file", path);
+        return false;
+    }
+
+    os << "[";
+    for (std::size_t n = 0; n < results.size(); ++n) {
+        const BenchmarkResult& result = results[n];
+        os << fmt::format("{}\n  {{\"codec\":\"{}\",\"preset\":\"{}\",\"width\":{},\"height\":{},"
+                          "\"fps\":{},\"capture\":\"{}\",\"frames\":{},\"packets\":{},"
+                          "\"drops\":{},\"sustainedFps\":{:.2f},\"latencyP50\":{:.2f},"
+                          "\"latencyP99\":{:.2f},\"latencyMax\":{:.2f},\"frameSize\":{:.0f},"
+                          "\"passed\":{}}}",
+                          (n > 0) ? "," : "",
+                          result.config.codec,
+                          result.config.preset.value_or(""),
+                          result.config.width,
+                          result.config.height,
+                          result.config.fps,
+                          result.device ? "device" : "fake",
+                          result.frames,
+                          result.packets,
+                          result.drops,
+                          result.fps,
+                          result.latencyP50,
+                          result.latencyP99,
+                          result.latencyMax,
+                          result.frameSize,
+                          result.passed);
+    }
+    os << "\n]\n";
+    return static_cast<bool>(os);
+}
+
+std::optional<BenchmarkResult>
+Benchmark::measure(const EncoderConfig& config, const std::chrono::milliseconds maxLatency) const
+{
+    const unsigned frames = std::max(1u, _config.frames);
+    std::vector<Clock::time_point> captured(frames);
+    std::vector<double> latencies;
+    latencies.reserve(frames);
+    std::size_t bytes{};
+    Clock::time_point firstPacket, lastPacket;
+
+    BenchmarkResult result{.config = config, .frames = frames};
+    /* The encoder runs on its own thread as in capture mode */
+    boost::asio::thread_pool pool{1};
+    Encoder encoder{pool.get_executor()};
+    if (not encoder.configure(config)) {
+        LOGW("Unable to configure encoder, skip <{}> preset", config.preset);
+        return std::nullopt;
+    }
+    encoder.onPacketReady().connect([&](const EncodedPacket& packet) {
+        const auto now = Clock::now();
+        if (result.packets++ == 0) {
+            firstPacket = now;
+        }
+        lastPacket = now;
+        bytes += packet.size;
+        /* The frames are fed without timestamps, so pts is the index of captured frame */
+        if (packet.pts >= 0 and packet.pts < static_cast<int64_t>(frames)) {
+            const std::chrono::duration<double, std::milli> latency = now - captured[packet.pts];
+            latencies.push_back(latency.count());
+        }
+    });
+
+    encoder.start();
+    result.device = _config.device and captureDevice(config, encoder, captured);
+    if (not result.device) {
+        captureFake(config, encoder, captured);
+    }
+    encoder.waitPending(0);
+    encoder.stop();
+    encoder.finalize();
+
+    /* The frames not turned into packets were dropped (by encoder queue or capture) */
+    result.drops = frames - std::min<unsigned>(frames, result.packets);
+    if (result.packets > 1) {
+        const std::chrono::duration<double> elapsed = lastPacket - firstPacket;
+        result.fps = (result.packets - 1) / elapsed.count();
+    }
+    result.latencyP50 = percentile(latencies, 0.50);
+    result.latencyP99 = percentile(latencies, 0.99);
+    result.latencyMax = latencies.empty() ? 0.0 : *std::ranges::max_element(latencies);
+    result.frameSize = result.packets ? static_cast<double>(bytes) / result.packets : 0.0;
+    result.passed = result.drops <= _config.maxDrops
+                    and result.fps >= config.fps * _config.minFpsRatio
+                    and result.latencyP99 <= static_cast<double>(maxLatency.count());
+    return result;
+}
+
+bool
+Benchmark::captureDevice(const EncoderConfig& config,
+                         const Encoder& encoder,
+                         std::vector<Clock::time_point>& captured) const
+{
+    boost::asio::thread_pool pool{1};
+    Camera camera{pool.get_executor(), *_config.device};
+    if (not camera.configure({.width = config.width, .height = config.height})) {
+        LOGW("Unable to configure <{}> device, use fake capture", *_config.device);
+        return false;
+    }
+
+    const std::size_t frameSize = std::size_t{config.width} * config.height * 3 / 2;
+    std::size_t frames{};
+    bool mismatch{false};
+    std::promise<void> done;
+    camera.onFrameReady().connect([&](const CapturedFrame& frame) {
+        if (frames >= captured.size() or mismatch) {
+            return;
+        }
+        if (frame.size < frameSize) {
+            /* The device negotiated different format (checked before any frame is fed) */
+            mismatch = true;
+            done.set_value();
+            return;
+        }
+        captured[frames] = Clock::now();
+        encoder.encode(static_cast<unsigned>(frames), 0, frame.data, frameSize);
+        if (++frames == captured.size()) {
+            done.set_value();
+        }
+    });
+    if (not camera.start()) {
+        LOGW("Unable to start <{}> device, use fake capture", *_config.device);
+        return false;
+    }
+
+    const auto duration = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>{static_cast<double>(captured.size()) / config.fps});
+    std::ignore = done.get_future().wait_for(duration + kDeviceTimeout);
+    camera.stop();
+    if (mismatch) {
+        LOGW("Device <{}> negotiated different format, use fake capture", *_config.device);
+        return false;
+    }
+    /* The missing frames are accounted as dropped */
+    if (frames < captured.size()) {
+        LOGW("Device <{}> delivered <{}> out of <{}> frames",
+             *_config.device,
+             frames,
+             captured.size());
+    }
+    return true;
+}
+
+void
+Benchmark::captureFake(const EncoderConfig& config,
+                       const Encoder& encoder,
+                       std::vector<Clock::time_point>& captured)
+{
+    FrameSource source{config.width, config.height};
+    source.generate(kSourceFrames);
+    const auto frameSize = static_cast<unsigned>(source.frameSize());
+
+    /* The frames are handed over at real-time pace as the camera does */
+    const auto interval = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>{1.0 / config.fps});
+    const auto start = Clock::now();
+    for (std::size_t n = 0; n < captured.size(); ++n) {
+        std::this_thread::sleep_until(start + n * interval);
+        captured[n] = Clock::now();
+        encoder.encode(static_cast<unsigned>(n), 0, source.frame(n), frameSize);
+    }
+}
+
+} // namespace jar
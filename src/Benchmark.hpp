@@ -0,0 +1,89 @@
+#pragma once
+
+#include "Encoder.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace jar {
+
+struct BenchmarkConfig {
+    /* The base encoder config (codec, fps, bitrate, etc) */
+    EncoderConfig base;
+    /* The presets to run */
+    std::vector<std::string> presets{"ultrafast", "veryfast", "fast"};
+    /* The resolutions (width, height) to run */
+    std::vector<std::pair<unsigned, unsigned>> resolutions{{1280, 720}, {1920, 1080}};
+    /* The number of captured frames per run */
+    unsigned frames{300};
+    /* The V4L2 device to capture from (e.g. vivid), fake capture if it isn't available */
+    std::optional<std::string> device;
+    /* The minimal sustained frame rate relative to the encoder one */
+    double minFpsRatio{0.95};
+    /* The maximum latency (99th percentile) per preset (the last one applies to the rest) */
+    std::vector<std::chrono::milliseconds> maxLatency{std::chrono::milliseconds{100}};
+    /* The maximum number of dropped frames */
+    unsigned maxDrops{0};
+};
+
+struct BenchmarkResult {
+    EncoderConfig config;
+    /* Whether the frames were captured from V4L2 device (fake capture otherwise) */
+    bool device{false};
+    unsigned frames{};
+    unsigned packets{};
+    unsigned drops{};
+    /* The sustained frame rate of encoded output */
+    double fps{};
+    /* The latency from capture to encoded packet (ms) */
+    double latencyP50{};
+    double latencyP99{};
+    double latencyMax{};
+    /* The average size of encoded frame (bytes) */
+    double frameSize{};
+    bool passed{false};
+};
+
+/*
+ * Runs capture to encode pipeline for each preset and resolution at real-time pace and checks
+ * sustained frame rate, latency and dropped frames against thresholds. The frames are captured
+ * from V4L2 device if given and available, otherwise by fake capture serving synthetic frames
+ * from a thread the way the camera does.
+ */
+class Benchmark {
+public:
+    explicit Benchmark(BenchmarkConfig config);
+
+    [[nodiscard]] std::vector<BenchmarkResult>
+    run() const;
+
+    /* Save results as JSON */
+    [[nodiscard]] static bool
+    save(const std::vector<BenchmarkResult>& results, const std::filesystem::path& path);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    [[nodiscard]] std::optional<BenchmarkResult>
+    measure(const EncoderConfig& config, std::chrono::milliseconds maxLatency) const;
+
+    /* Feed encoder with frames captured from device, returns false if it's unavailable */
+    [[nodiscard]] bool
+    captureDevice(const EncoderConfig& config,
+                  const Encoder& encoder,
+                  std::vector<Clock::time_point>& captured) const;
+
+    static void
+    captureFake(const EncoderConfig& config,
+                const Encoder& encoder,
+                std::vector<Clock::time_point>& captured);
+
+private:
+    BenchmarkConfig _config;
+};
+
+} // namespace jar
@@ -0,0 +1,243 @@
+#include "Calibrator.hpp"
+
+#include "Logger.hpp"
+
+#include <boost/asio/thread_pool.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <thread>
+
+namespace jar {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+/* The maximum number of frames queued to encoder while measuring throughput */
+constexpr std::size_t kMaxPendingFrames = 8;
+double
+percentile(std::vector<double> values, const double ratio)
+{
+    if (values.empty()) {
+        return 0.0;
+    }
+    const auto n = static_cast<std::ptrdiff_t>(ratio * static_cast<double>(values.size() - 1));
+    std::nth_element(values.begin(), values.begin() + n, values.end());
+    return values[n];
+}
+
+} // namespace
+
+Calibrator::Calibrator(CalibrationConfig config, const FrameSource& source)
+    : _config{std::move(config)}
+    , _source{source}
+{
+}
+
+std::optional<CalibrationResult>
+Calibrator::run() const
+{
+    const double requiredFps = _config.base.fps * _config.realtimeFactor;
+    const double maxLatency = static_cast<double>(_config.maxLatency.count());
+
+    std::optional<CalibrationResult> best;
+    for (const EncoderConfig& candidate : candidates()) {
+        const auto result = measure(candidate);
+        if (not result) {
+            continue;
+        }
+
+        const bool fits = (result->fps >= requiredFps and result->latency <= maxLatency);
+        LOGI("Calibration: preset<{}>, tune<{}>, threads<{}>, bFrames<{}>: fps<{:.1f}>, "
+             "latency<{:.1f}ms>, frameSize<{:.0f}>, psnr<{:.2f}>, fits<{}>",
+             candidate.preset,
+             candidate.tune,
+             candidate.threads,
+             candidate.bFrames,
+             result->fps,
+             result->latency,
+             result->frameSize,
+             result->psnr,
+             fits);
+
+        if (fits and (not best or better(*result, *best))) {
+            best = result;
+        }
+    }
+    return best;
+}
+
+bool
+Calibrator::save(const CalibrationResult& result, const std::filesystem::path& path)
+{
+    std::ofstream os{path};
+    if (not os) {
+        LOGE("Unable to open <{}> file", path);
+        return false;
+    }
+
+    const EncoderConfig& config = result.config;
+    os << "# Generated by rawenc calibrate: fps=" << result.fps
+       << ", latency=" << result.latency << "ms, frame-size=" << result.frameSize
+       << ", psnr=" << result.psnr << '\n';
+    os << "codec=" << config.codec << '\n';
+    os << "width=" << config.width << '\n';
+    os << "height=" << config.height << '\n';
+    os << "fps=" << config.fps << '\n';
+    if (config.preset) {
+        os << "preset=" << *config.preset << '\n';
+    }
+    if (config.tune) {
+        os << "tune=" << *config.tune << '\n';
+    }
+    if (config.bitrate) {
+        os << "bitrate=" << *config.bitrate << '\n';
+    }
+    if (config.crf) {
+        os << "crf=" << *config.crf << '\n';
+    }
+    if (config.gopSize) {
+        os << "gop-size=" << *config.gopSize << '\n';
+    }
+    if (config.bFrames) {
+        os << "b-frames=" << *config.bFrames << '\n';
+    }
+    if (config.threads) {
+        os << "threads=" << *config.threads << '\n';
+    }
+    return static_cast<bool>(os);
+}
+
+std::vector<EncoderConfig>
+Calibrator::candidates() const
+{
+    std::vector<EncoderConfig> output;
+    for (const auto& preset : _config.presets) {
+        for (const auto& tune : _config.tunes) {
+            for (const unsigned threads : _config.threads) {
+                for (const unsigned bFrames : _config.bFrames) {
+                    EncoderConfig config{_config.base};
+                    /* Each input frame is encoded (the packets are paired with frames by pts) */
+                    config.targetFps.reset();
+                    config.preset = preset;
+                    config.tune = tune.empty() ? std::nullopt : std::make_optional(tune);
+                    config.threads = threads;
+                    config.bFrames = bFrames;
+                    output.push_back(std::move(config));
+                }
+            }
+        }
+    }
+    return output;
+}
+
+std::optional<CalibrationResult>
+Calibrator::measure(const EncoderConfig& config) const
+{
+    const auto frameSize = static_cast<unsigned>(_source.frameSize());
+    const unsigned frames = std::max(1u, _config.frames);
+
+    CalibrationResult result{.config = config};
+    /* Each candidate is encoded on its own thread as in capture mode */
+    boost::asio::thread_pool pool{1};
+
+    /* Measure throughput, size and quality feeding frames as fast as possible */
+    {
+        std::size_t packets{}, bytes{}, psnrCount{};
+        double psnr{};
+
+        EncoderConfig psnrConfig{config};
+        psnrConfig.psnr = true;
+        Encoder encoder{pool.get_executor()};
+        if (not encoder.configure(psnrConfig)) {
+            LOGW("Unable to configure encoder, skip candidate");
+            return std::nullopt;
+        }
+        encoder.onPacketReady().connect([&](const EncodedPacket& packet) {
+            ++packets, bytes += packet.size;
+            if (packet.psnr > 0.0) {
+                psnr += packet.psnr, ++psnrCount;
+            }
+        });
+
+        encoder.start();
+        const auto start = Clock::now();
+        for (unsigned n = 0; n < frames; ++n) {
+            encoder.waitPending(kMaxPendingFrames);
+            encoder.encode(n, 0, _source.frame(n), frameSize);
+        }
+        encoder.waitPending(0);
+        encoder.stop();
+        encoder.finalize();
+        const std::chrono::duration<double> elapsed = Clock::now() - start;
+
+        result.fps = frames / elapsed.count();
+        result.frameSize = packets ? static_cast<double>(bytes) / packets : 0.0;
+        result.psnr = psnrCount ? psnr / psnrCount : 0.0;
+    }
+
+    if (result.fps < _config.base.fps) {
+        /* No reason to measure latency if the encoder can't keep up */
+        result.latency = std::numeric_limits<double>::infinity();
+        return result;
+    }
+
+    /* Measure latency feeding frames at real-time pace */
+    {
+        std::vector<Clock::time_point> sent(frames);
+        std::vector<double> latencies;
+        latencies.reserve(frames);
+
+        Encoder encoder{pool.get_executor()};
+        if (not encoder.configure(config)) {
+            return std::nullopt;
+        }
+        encoder.onPacketReady().connect([&](const EncodedPacket& packet) {
+            if (packet.pts >= 0 and packet.pts < static_cast<int64_t>(frames)) {
+                const std::chrono::duration<double, std::milli> latency
+                    = Clock::now() - sent[packet.pts];
+                latencies.push_back(latency.count());
+            }
+        });
+
+        encoder.start();
+        const auto interval = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>{1.0 / config.fps});
+        const auto start = Clock::now();
+        for (unsigned n = 0; n < frames; ++n) {
+            std::this_thread::sleep_until(start + n * interval);
+            sent[n] = Clock::now();
+            encoder.encode(n, 0, _source.frame(n), frameSize);
+        }
+        encoder.waitPending(0);
+        encoder.stop();
+        encoder.finalize();
+
+        result.latency = percentile(std::move(latencies), 0.95);
+    }
+
+    return result;
+}
+
+bool
+Calibrator::better(const CalibrationResult& lhs, const CalibrationResult& rhs) const
+{
+    if (_config.base.crf) {
+        /* The quality is fixed by CRF, so the smaller output wins */
+        if (lhs.frameSize != rhs.frameSize) {
+            return lhs.frameSize < rhs.frameSize;
+        }
+    } else if (lhs.psnr > 0.0 and rhs.psnr > 0.0) {
+        /* The bitrate is fixed, so the better quality wins */
+        if (lhs.psnr != rhs.psnr) {
+            return lhs.psnr > rhs.psnr;
+        }
+    } else if (lhs.frameSize != rhs.frameSize) {
+        return lhs.frameSize < rhs.frameSize;
+    }
+    return lhs.fps > rhs.fps;
+}
+
+} // namespace jar
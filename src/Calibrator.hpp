@@ -0,0 +1,76 @@
+#pragma once
+
+#include "Encoder.hpp"
+#include "FrameSource.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace jar {
+
+struct CalibrationConfig {
+    /* The base encoder config (codec, size, fps, rate control) */
+    EncoderConfig base;
+    /* The number of frames to encode per candidate config */
+    unsigned frames{120};
+    /* The presets to sweep */
+    std::vector<std::string> presets{"ultrafast", "superfast", "veryfast", "faster", "fast"};
+    /* The tunes to sweep (empty string means no tune) */
+    std::vector<std::string> tunes{"", "zerolatency"};
+    /* The thread counts to sweep (0 - chosen by encoder) */
+    std::vector<unsigned> threads{0};
+    /* The b-frames counts to sweep */
+    std::vector<unsigned> bFrames{0, 2};
+    /* The required encoding speed relative to real-time (e.g. 1.2 - 20% headroom) */
+    double realtimeFactor{1.2};
+    /* The maximum allowed latency (95th percentile) */
+    std::chrono::milliseconds maxLatency{100};
+};
+
+struct CalibrationResult {
+    EncoderConfig config;
+    /* The maximum encoding speed (frames per second) */
+    double fps{};
+    /* The 95th percentile of frame latency at real-time pace (ms) */
+    double latency{};
+    /* The average size of encoded frame (bytes) */
+    double frameSize{};
+    /* The average PSNR (dB) or zero if not supported by encoder */
+    double psnr{};
+};
+
+/*
+ * Sweeps encoder configurations on recorded or synthetic frames and picks the best one
+ * meeting real-time budget and latency ceiling.
+ */
+class Calibrator {
+public:
+    Calibrator(CalibrationConfig config, const FrameSource& source);
+
+    /* Run calibration and return the best config (if any of them fits) */
+    [[nodiscard]] std::optional<CalibrationResult>
+    run() const;
+
+    /* Save config in format of rawenc config file (see --config option) */
+    [[nodiscard]] static bool
+    save(const CalibrationResult& result, const std::filesystem::path& path);
+
+private:
+    [[nodiscard]] std::vector<EncoderConfig>
+    candidates() const;
+
+    [[nodiscard]] std::optional<CalibrationResult>
+    measure(const EncoderConfig& config) const;
+
+    [[nodiscard]] bool
+    better(const CalibrationResult& lhs, const CalibrationResult& rhs) const;
+
+private:
+    CalibrationConfig _config;
+    const FrameSource& _source;
+};
+
+} // namespace jar
@@ -1,15 +1,23 @@
 #include "Camera.hpp"
 
-#include <poll.h>
+#include <boost/asio/as_tuple.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <boost/asio/use_future.hpp>
+
 #include <fcntl.h>
+#include <poll.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <unistd.h>
 extern "C" {
 #include <linux/videodev2.h>
 }
 #include <libv4l2.h>
 
 #include "Logger.hpp"
+#include "Tracer.hpp"
 
 namespace {
 
@@ -26,10 +34,15 @@ xioctl(int fd, int request, void* arg)
 
 } // namespace
 
+namespace asio = boost::asio;
+
 namespace jar {
 
-Camera::Camera(std::string deviceName)
+Camera::Camera(asio::any_io_executor executor, std::string deviceName)
     : _deviceName{std::move(deviceName)}
+    , _strand{asio::make_strand(std::move(executor))}
+    , _descriptor{_strand}
+    , _timer{_strand}
 {
 }
 
@@ -186,11 +199,9 @@ Camera::configureDevice(const CameraConfig& config)
 
     if (xioctl(_fd, VIDIOC_S_FMT, &fmt) == 0) {
         LOGD("Stream data format: <{}x{}>", fmt.fmt.pix.width, fmt.fmt.pix.height);
-        _config = CameraConfig{
-            .width = fmt.fmt.pix.width,
-            .height = fmt.fmt.pix.height,
-            .bufferCount = config.bufferCount,
-        };
+        _config = config;
+        _config->width = fmt.fmt.pix.width;
+        _config->height = fmt.fmt.pix.height;
     } else {
         LOGE("Unable to set format for <{}> device", _deviceName);
         return false;
@@ -277,13 +288,12 @@ Camera::enqueueBuffers() const
 bool
 Camera::activateStream()
 {
-    v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    if (xioctl(_fd, VIDIOC_STREAMON, &type) == -1) {
-        LOGE("Unable to set stream to on");
+    if (not startStreaming()) {
         return false;
     }
 
-    _worker = std::jthread{&Camera::handleWorker, this};
+    _stopped = false;
+    _done = asio::co_spawn(_strand, capture(), asio::use_future);
 
     return true;
 }
@@ -291,62 +301,202 @@ Camera::activateStream()
 void
 Camera::deactivateStream()
 {
-    if (_worker.request_stop()) {
-        if (_worker.joinable()) {
-            _worker.join();
-        }
-    } else {
-        LOGE("Unable to stop worker");
+    if (_done.valid()) {
+        /* The flag covers the case when readiness is already reported but not yet handled */
+        asio::post(_strand, [this] {
+            _stopped = true;
+            boost::system::error_code error;
+            _descriptor.cancel(error);
+            _timer.cancel();
+        });
+        _done.wait();
+        _done = {};
+        std::ignore = _descriptor.release();
     }
 
+    /* The device might be lost and not reopened yet */
+    if (not deviceOpened()) {
+        return;
+    }
     v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
     if (xioctl(_fd, VIDIOC_STREAMOFF, &type) == -1) {
         LOGE("Unable to set stream to off");
     }
 }
 
+bool
+Camera::startStreaming()
+{
+    v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    if (xioctl(_fd, VIDIOC_STREAMON, &type) == -1) {
+        LOGE("Unable to set stream to on");
+        return false;
+    }
+
+    /* The descriptor is only used to await readiness (it's released without closing) */
+    boost::system::error_code error;
+    if (_descriptor.assign(_fd, error); error) {
+        LOGE("Unable to assign device descriptor: {}", error.message());
+        return false;
+    }
+    return true;
+}
+
 void
-Camera::readFrame() const
+Camera::teardownDevice()
+{
+    if (_descriptor.is_open()) {
+        std::ignore = _descriptor.release();
+    }
+    if (deviceOpened()) {
+        /* The lost device fails to stop streaming, its buffers are released anyway */
+        v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        std::ignore = xioctl(_fd, VIDIOC_STREAMOFF, &type);
+    }
+    releaseBuffers();
+    if (deviceOpened()) {
+        closeDevice();
+    }
+}
+
+bool
+Camera::reopenDevice(const CameraConfig& config)
+{
+    /* The device node is absent until the device is enumerated again */
+    if (access(_deviceName.data(), F_OK) == -1) {
+        return false;
+    }
+    if (not openDevice() or not configureDevice(config)) {
+        return false;
+    }
+    if (_config->width != config.width or _config->height != config.height) {
+        LOGE("Device <{}> is renegotiated to different <{}x{}> format",
+             _deviceName,
+             _config->width,
+             _config->height);
+        _config = config;
+        return false;
+    }
+    return requestBuffers(config.bufferCount) and enqueueBuffers() and startStreaming();
+}
+
+bool
+Camera::deviceFailed() const
+{
+    pollfd fd{.fd = _fd, .events = POLLIN, .revents = 0};
+    if (poll(&fd, 1, 0) == -1) {
+        return false;
+    }
+    return (fd.revents & (POLLERR | POLLHUP | POLLNVAL)) != 0;
+}
+
+Camera::ReadStatus
+Camera::readFrame()
 {
     v4l2_buffer buffer{};
     buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
     buffer.memory = V4L2_MEMORY_MMAP;
 
-    if (xioctl(_fd, VIDIOC_DQBUF, &buffer) == -1) {
-        LOGE("Unable to dequeue buffer: {}, {}", errno, strerror(errno));
-        return;
+    {
+        TRACE_SCOPE("VIDIOC_DQBUF");
+        if (xioctl(_fd, VIDIOC_DQBUF, &buffer) == -1) {
+            if (errno == ENODEV) {
+                return ReadStatus::Lost;
+            }
+            if (errno != EAGAIN) {
+                LOGE_LIMITED("Unable to dequeue buffer: {}, {}", errno, strerror(errno));
+            }
+            return ReadStatus::Again;
+        }
     }
 
+    _lastSequence = _sequenceBase + buffer.sequence;
     notifyFrameReady({
-        .sequence = buffer.sequence,
+        .sequence = _lastSequence,
         .data = _buffers[buffer.index].ptr,
         .size = buffer.bytesused,
+        .timestamp = buffer.timestamp.tv_sec * 1000000LL + buffer.timestamp.tv_usec,
+        .resumed = std::exchange(_resumed, false),
     });
 
+    TRACE_SCOPE("VIDIOC_QBUF");
     if (xioctl(_fd, VIDIOC_QBUF, &buffer) == -1) {
-        LOGE("Unable to enqueue buffer: {}, {}", errno, strerror(errno));
+        if (errno == ENODEV) {
+            return ReadStatus::Lost;
+        }
+        LOGE_LIMITED("Unable to enqueue buffer: {}, {}", errno, strerror(errno));
     }
+    return ReadStatus::Ready;
 }
 
-void
-Camera::handleWorker(const std::stop_token& token) const
+asio::awaitable<void>
+Camera::capture()
 {
-    while (not token.stop_requested()) {
-        pollfd p = {_fd, POLLIN, 0};
-        if (const int rv = ::poll(&p, 1, 200); rv == -1) {
-            if (errno == EINTR) {
-                continue;
+    while (not _stopped) {
+        const auto [error] = co_await _descriptor.async_wait(
+            asio::posix::stream_descriptor::wait_read, asio::as_tuple(asio::use_awaitable));
+        if (error == asio::error::operation_aborted) {
+            break;
+        }
+
+        bool lost{false};
+        if (error) {
+            LOGE("Unable to wait for device readiness: {}", error.message());
+            lost = true;
+        } else {
+            /* Drain all ready buffers as the readiness is reported once per wake-up */
+            TRACE_SCOPE("Camera::capture");
+            std::size_t frames{};
+            ReadStatus status{ReadStatus::Again};
+            while (not _stopped and (status = readFrame()) == ReadStatus::Ready) {
+                ++frames;
             }
+            /* The disconnected device keeps reporting readiness without frames */
+            lost = (status == ReadStatus::Lost) or (frames == 0 and deviceFailed());
+        }
+        if (lost and not _stopped and not co_await recover()) {
+            break;
+        }
+    }
+}
+
+asio::awaitable<bool>
+Camera::recover()
+{
+    LOGW("Device <{}> is lost, reopening", _deviceName);
+    const auto lostTime = std::chrono::steady_clock::now();
+    const CameraConfig config = *_config;
+    teardownDevice();
+
+    auto delay = config.reconnectDelay;
+    for (unsigned attempt = 1; not _stopped; ++attempt) {
+        _timer.expires_after(delay);
+        if (const auto [error] = co_await _timer.async_wait(asio::as_tuple(asio::use_awaitable));
+            error or _stopped) {
+            co_return false;
         }
-        if (p.revents & POLLIN) {
-            readFrame();
+        if (reopenDevice(config)) {
+            /* The sequence of reopened device starts over */
+            _sequenceBase = _lastSequence + 1;
+            _resumed = true;
+            LOGI("Device <{}> is reopened: attempts<{}>, gap<{}ms>",
+                 _deviceName,
+                 attempt,
+                 std::chrono::duration_cast<std::chrono::milliseconds>(
+                     std::chrono::steady_clock::now() - lostTime)
+                     .count());
+            co_return true;
         }
+        teardownDevice();
+        delay = std::min(delay * 2, config.reconnectMaxDelay);
     }
+    co_return false;
 }
 
 void
 Camera::notifyFrameReady(const CapturedFrame& frame) const
 {
+    TRACE_SCOPE("Camera::notifyFrameReady");
     _frameReadySig(frame);
 }
 
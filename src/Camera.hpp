@@ -1,11 +1,18 @@
 #pragma once
 
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/posix/stream_descriptor.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/strand.hpp>
 #include <sigc++/signal.h>
 
+#include <chrono>
+#include <cstdint>
+#include <future>
 #include <optional>
 #include <string>
 #include <vector>
-#include <thread>
 
 namespace jar {
 
@@ -13,21 +20,35 @@ struct CameraConfig {
     unsigned width{};
     unsigned height{};
     unsigned bufferCount{8};
+    /* The delay before the first attempt to reopen lost device (doubled after each failure) */
+    std::chrono::milliseconds reconnectDelay{100};
+    /* The maximum delay between attempts to reopen lost device */
+    std::chrono::milliseconds reconnectMaxDelay{2000};
 };
 
 struct CapturedFrame {
     unsigned sequence{};
     void* data{};
     unsigned int size{};
+    /* The V4L2 buffer timestamp (microseconds) */
+    int64_t timestamp{};
+    /* Whether it's the first frame after lost device is reopened (the stream has a gap) */
+    bool resumed{false};
 };
 
+/*
+ * Captures frames from V4L2 device. The device readiness is awaited by coroutine on a strand of
+ * given executor, the frames are notified on the same strand. If the device is lost (e.g. USB
+ * camera is reset), it's reopened and renegotiated to the same format with backoff, and the
+ * capture resumes with continuous frame sequence.
+ */
 class Camera {
 public:
     static constexpr int kInvalidFd = -1;
 
     using OnFrameReadySig = sigc::signal<void(const CapturedFrame& frame)>;
 
-    explicit Camera(std::string deviceName = "/dev/video0");
+    explicit Camera(boost::asio::any_io_executor executor, std::string deviceName = "/dev/video0");
 
     ~Camera();
 
@@ -71,17 +92,31 @@ private:
     void
     deactivateStream();
 
-    void
-    readFrame() const;
+    [[nodiscard]] bool
+    startStreaming();
 
+    /* Release all resources of the device (the capture coroutine keeps running) */
     void
-    runWorker();
+    teardownDevice();
 
-    void
-    stopWorker();
+    [[nodiscard]] bool
+    reopenDevice(const CameraConfig& config);
 
-    void
-    handleWorker(const std::stop_token& token) const;
+    /* Check whether the device reports error condition (e.g. it's disconnected) */
+    [[nodiscard]] bool
+    deviceFailed() const;
+
+    enum class ReadStatus { Ready, Again, Lost };
+
+    [[nodiscard]] ReadStatus
+    readFrame();
+
+    boost::asio::awaitable<void>
+    capture();
+
+    /* Reopen lost device with backoff, returns false if camera is stopped meanwhile */
+    boost::asio::awaitable<bool>
+    recover();
 
     void
     notifyFrameReady(const CapturedFrame& frame) const;
@@ -97,7 +132,15 @@ private:
     int _fd{kInvalidFd};
     std::vector<FrameBuffer> _buffers;
     std::optional<CameraConfig> _config;
-    std::jthread _worker;
+    boost::asio::strand<boost::asio::any_io_executor> _strand;
+    boost::asio::posix::stream_descriptor _descriptor;
+    boost::asio::steady_timer _timer;
+    std::future<void> _done;
+    bool _stopped{false};
+    /* The sequence of frames continues over device reopening */
+    unsigned _sequenceBase{};
+    unsigned _lastSequence{};
+    bool _resumed{false};
     OnFrameReadySig _frameReadySig;
 };
 
@@ -0,0 +1,196 @@
+#include "ControlServer.hpp"
+
+#include "Logger.hpp"
+
+#include <boost/asio/post.hpp>
+#include <boost/asio/read_until.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/asio/streambuf.hpp>
+#include <boost/asio/write.hpp>
+
+#include <filesystem>
+#include <future>
+#include <istream>
+#include <memory>
+#include <sstream>
+
+namespace asio = boost::asio;
+namespace fs = std::filesystem;
+
+using boost::system::error_code;
+using Protocol = asio::local::stream_protocol;
+
+namespace jar {
+
+/* The maximum length of command line */
+static constexpr std::size_t kMaxCommandSize = 1024;
+
+class ControlServer::Session : public std::enable_shared_from_this<Session> {
+public:
+    Session(const ControlServer& server, Protocol::socket socket)
+        : _server{server}
+        , _socket{std::move(socket)}
+        , _input{kMaxCommandSize}
+    {
+    }
+
+    void
+    start()
+    {
+        asio::async_read_until(
+            _socket,
+            _input,
+            '\n',
+            [self = shared_from_this()](const error_code& error, std::size_t /*bytes*/) {
+                self->onRead(error);
+            });
+    }
+
+private:
+    void
+    onRead(const error_code& error)
+    {
+        if (error) {
+            LOGW("Unable to read control command: {}", error.message());
+            return;
+        }
+
+        std::string line;
+        std::istream is{&_input};
+        std::getline(is, line);
+
+        _server.dispatch(line, [self = shared_from_this()](std::string payload) {
+            asio::post(self->_socket.get_executor(),
+                       [self, payload = std::move(payload)]() mutable {
+                           self->write(std::move(payload));
+                       });
+        });
+    }
+
+    void
+    write(std::string payload)
+    {
+        _output = std::move(payload);
+        asio::async_write(_socket,
+                          asio::buffer(_output),
+                          [self = shared_from_this()](const error_code& error, std::size_t) {
+                              if (error) {
+                                  LOGW("Unable to write control response: {}", error.message());
+                              }
+                              error_code ec;
+                              self->_socket.shutdown(Protocol::socket::shutdown_both, ec);
+                          });
+    }
+
+private:
+    const ControlServer& _server;
+    Protocol::socket _socket;
+    asio::streambuf _input;
+    std::string _output;
+};
+
+ControlServer::ControlServer(asio::any_io_executor executor, std::string socketPath)
+    : _socketPath{std::move(socketPath)}
+    , _acceptor{asio::make_strand(std::move(executor))}
+{
+}
+
+ControlServer::~ControlServer()
+{
+    stop();
+}
+
+void
+ControlServer::addCommand(std::string name, CommandHandler handler)
+{
+    _commands.insert_or_assign(std::move(name), std::move(handler));
+}
+
+bool
+ControlServer::start()
+{
+    std::error_code ec;
+    fs::remove(_socketPath, ec);
+
+    error_code error;
+    const Protocol::endpoint endpoint{_socketPath};
+    if (_acceptor.open(endpoint.protocol(), error); error) {
+        LOGE("Unable to open control socket: {}", error.message());
+        return false;
+    }
+    if (_acceptor.bind(endpoint, error); error) {
+        LOGE("Unable to bind control socket <{}>: {}", _socketPath, error.message());
+        _acceptor.close(error);
+        return false;
+    }
+    if (_acceptor.listen(asio::socket_base::max_listen_connections, error); error) {
+        LOGE("Unable to listen control socket: {}", error.message());
+        _acceptor.close(error);
+        return false;
+    }
+
+    LOGI("Control server is listening on <{}>", _socketPath);
+    accept();
+    return true;
+}
+
+void
+ControlServer::stop()
+{
+    if (not _acceptor.is_open()) {
+        return;
+    }
+
+    /* The accept handler may run concurrently, so close the acceptor on its strand */
+    std::promise<void> closed;
+    asio::post(_acceptor.get_executor(), [this, &closed] {
+        error_code error;
+        _acceptor.close(error);
+        closed.set_value();
+    });
+    closed.get_future().wait();
+
+    std::error_code ec;
+    fs::remove(_socketPath, ec);
+}
+
+void
+ControlServer::accept()
+{
+    _acceptor.async_accept([this](const error_code& error, Protocol::socket socket) {
+        if (error == asio::error::operation_aborted) {
+            return;
+        }
+        if (error) {
+            LOGW("Unable to accept control connection: {}", error.message());
+        } else {
+            std::make_shared<Session>(*this, std::move(socket))->start();
+        }
+        accept();
+    });
+}
+
+void
+ControlServer::dispatch(const std::string& line, Responder responder) const
+{
+    std::vector<std::string> args;
+    std::istringstream is{line};
+    for (std::string arg; is >> arg;) {
+        args.push_back(std::move(arg));
+    }
+
+    if (args.empty()) {
+        responder("error: empty command\n");
+        return;
+    }
+
+    if (const auto it = _commands.find(args.front()); it != _commands.cend()) {
+        LOGD("Handle <{}> control command", args.front());
+        it->second(args, std::move(responder));
+    } else {
+        LOGW("Unknown <{}> control command", args.front());
+        responder("error: unknown command\n");
+    }
+}
+
+} // namespace jar
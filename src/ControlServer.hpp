@@ -0,0 +1,53 @@
+#pragma once
+
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace jar {
+
+/*
+ * Line-based command server on local (UNIX domain) socket. Each connection carries one
+ * command (e.g. "snapshot jpeg 320\n"), the response payload is written back as is and
+ * the connection is closed. The acceptor and sessions are served on a strand of given executor.
+ */
+class ControlServer {
+public:
+    /* Send response to the client (may be called from any thread) */
+    using Responder = std::function<void(std::string payload)>;
+    using CommandHandler
+        = std::function<void(const std::vector<std::string>& args, Responder responder)>;
+
+    ControlServer(boost::asio::any_io_executor executor, std::string socketPath);
+
+    ~ControlServer();
+
+    void
+    addCommand(std::string name, CommandHandler handler);
+
+    [[nodiscard]] bool
+    start();
+
+    void
+    stop();
+
+private:
+    class Session;
+
+    void
+    accept();
+
+    void
+    dispatch(const std::string& line, Responder responder) const;
+
+private:
+    std::string _socketPath;
+    boost::asio::local::stream_protocol::acceptor _acceptor;
+    std::map<std::string, CommandHandler, std::less<>> _commands;
+};
+
+} // namespace jar
@@ -1,6 +1,16 @@
 #include "Encoder.hpp"
 
+#include "FrameSource.hpp"
+#include "HugePageAllocator.hpp"
 #include "Logger.hpp"
+#include "Tracer.hpp"
+
+#include <boost/asio/as_tuple.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/experimental/concurrent_channel.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <boost/asio/use_future.hpp>
 
 extern "C" {
 #include <libavcodec/avcodec.h>
@@ -8,19 +18,51 @@ extern "C" {
 #include <libavutil/imgutils.h>
 }
 
-#include <thread>
-#include <queue>
-#include <mutex>
-#include <condition_variable>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <future>
+#include <optional>
+#include <tuple>
+
+namespace asio = boost::asio;
 
 namespace jar {
 
+namespace {
+
+/* The number of submission times kept for latency measurement (covers lookahead and queue) */
+constexpr std::size_t kSubmitSlots = 256;
+
+/* The maximum age of capture timestamp at submission (older ones aren't of monotonic clock) */
+constexpr std::chrono::seconds kMaxCaptureAge{1};
+
+/* The layout of AV_PKT_DATA_QUALITY_STATS side data: quality (u32), picture type (u8),
+ * error count (u8), reserved (u16), and sum of squared errors (u64) per plane */
+constexpr std::size_t kPictTypeOffset = 4;
+constexpr std::size_t kErrorCountOffset = 5;
+constexpr std::size_t kErrorsOffset = 8;
+
+/* The alignment of frame planes and lines (suitable for SIMD of any width) */
+constexpr int kFrameAlign = 64;
+
+/* The maximum number of distinct synthetic frames generated for warm-up (cycled) */
+constexpr std::size_t kWarmUpSourceFrames = 8;
+
+} // namespace
+
 class Encoder::Impl {
 public:
-    Impl() = default;
+    explicit Impl(asio::any_io_executor executor)
+        : _strand{asio::make_strand(std::move(executor))}
+    {
+    }
 
     ~Impl()
     {
+        stop();
         cleanup();
     }
 
@@ -28,7 +70,7 @@ public:
     configure(const EncoderConfig& config)
     {
         LOGI("Encoder config: codec<{}>, width<{}>, height<{}>, fps<{}>, preset<{}>, tune<{}>, "
-             "bitrate<{}>, bFrames<{}>, gopSize<{}>",
+             "bitrate<{}>, bFrames<{}>, gopSize<{}>, threads<{}>, lowLatency<{}>",
              config.codec,
              config.width,
              config.height,
@@ -37,8 +79,14 @@ public:
              config.tune,
              config.bitrate,
              config.bFrames,
-             config.gopSize);
-
+             config.gopSize,
+             config.threads,
+             config.lowLatency);
+
+        _config = config;
+        _config.fps = std::max(1u, config.fps);
+        _outputFps = std::clamp(config.targetFps.value_or(_config.fps), 1u, _config.fps);
+        _queueSize = std::max(1u, config.queueSize);
         av_log_set_level(AV_LOG_QUIET);
 
         _codec = avcodec_find_encoder_by_name(config.codec.data());
@@ -53,71 +101,126 @@ public:
             return false;
         }
 
-        _ctx = avcodec_alloc_context3(_codec);
+        _ctx = openContext(_config);
         if (not _ctx) {
             cleanup();
-            LOGE("Unable to allocate codec context");
             return false;
         }
-        _ctx->width = static_cast<int>(config.width);
-        _ctx->height = static_cast<int>(config.height);
-        _ctx->time_base = {1, static_cast<int>(config.fps)};
-        _ctx->framerate = {static_cast<int>(config.fps), 1};
-        _ctx->pix_fmt = AV_PIX_FMT_YUV420P;
 
-        if (config.bitrate) {
-            _ctx->bit_rate = static_cast<int>(*config.bitrate);
+        return createPool(_config);
+    }
+
+    bool
+    warmUp(const std::size_t frames)
+    {
+        TRACE_SCOPE("Encoder::warmUp");
+        if (not _ctx) {
+            return false;
         }
-        if (config.gopSize) {
-            _ctx->gop_size = static_cast<int>(*config.gopSize);
+
+        const auto begin = Clock::now();
+        /* The throwaway context shares nothing but the frame pool with the actual one, so the
+         * pool buffers are faulted in and the encoder code and tables are cached */
+        AVCodecContext* ctx = openContext(_config);
+        if (not ctx) {
+            return false;
         }
-        if (config.bFrames) {
-            _ctx->max_b_frames = static_cast<int>(*config.bFrames);
+        AVPacket* packet = av_packet_alloc();
+        if (not packet) {
+            avcodec_free_context(&ctx);
+            return false;
         }
-        if (_codec->id == AV_CODEC_ID_H264 or _codec->id == AV_CODEC_ID_H265) {
-            if (config.preset) {
-                av_opt_set(_ctx->priv_data, "preset", config.preset->data(), 0);
-            }
-            if (config.tune) {
-                av_opt_set(_ctx->priv_data, "tune", config.tune->data(), 0);
-            }
-            if (config.crf) {
-                av_opt_set_int(_ctx->priv_data, "crf", *config.crf, 0);
+
+        FrameSource source{_config.width, _config.height};
+        source.generate(std::min(frames, kWarmUpSourceFrames));
+        std::size_t packets{};
+        for (std::size_t n = 0; n < frames; ++n) {
+            const auto frame = createFrame(n, source.frame(n), source.frameSize());
+            if (not frame or avcodec_send_frame(ctx, frame.get()) < 0) {
+                break;
             }
+            packets += dropPackets(ctx, packet);
         }
-
-        if (const int rv = avcodec_open2(_ctx, _codec, nullptr); rv < 0) {
-            cleanup();
-            LOGE("Unable to open encoder: {}", av_err2str(rv));
-            return false;
+        if (avcodec_send_frame(ctx, nullptr) >= 0) {
+            packets += dropPackets(ctx, packet);
         }
 
+        av_packet_free(&packet);
+        avcodec_free_context(&ctx);
+        LOGI("Encoder warm-up: frames<{}>, packets<{}>, duration<{}ms>",
+             frames,
+             packets,
+             std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - begin).count());
         return true;
     }
 
     void
     start()
     {
-        _worker = std::jthread{&Impl::handleWorker, this};
+        _channel.emplace(_strand, _queueSize);
+        _done = asio::co_spawn(_strand, handleFrames(), asio::use_future);
     }
 
     void
     stop()
     {
-        _worker.request_stop();
-        if (_worker.joinable()) {
-            _worker.join();
+        if (not _done.valid()) {
+            return;
+        }
+        /* The frame being encoded is completed, the queued frames are discarded */
+        _channel->close();
+        _done.wait();
+        _done = {};
+        _channel.reset();
+        /* The discarded frames are no longer pending (reset encoder starts with empty queue) */
+        _pending = 0;
+        _pending.notify_all();
+        if (_decimated > 0) {
+            LOGI("Encoder decimated <{}> frames to <{}> fps", _decimated, _outputFps);
         }
     }
 
     void
-    encode(const unsigned int sequence, void* data, const unsigned int size)
+    encode(const unsigned int sequence,
+           const int64_t timestamp,
+           const void* data,
+           const unsigned int size)
     {
-        if (auto frame = createFrame(sequence, data, size); frame) {
-            enqueueFrame(std::move(frame));
-        } else {
-            LOGE("Unable to send <{}> frame to encode", sequence);
+        const auto submitted = Clock::now().time_since_epoch().count();
+        const auto pts = framePts(sequence, timestamp);
+        if (not pts) {
+            ++_decimated;
+            return;
+        }
+        auto frame = createFrame(*pts, data, size);
+        if (not frame) {
+            LOGE_LIMITED("Unable to send <{}> frame to encode", sequence);
+            return;
+        }
+        const bool keyframe = _keyframeRequested.exchange(false, std::memory_order_relaxed);
+        if (keyframe) {
+            frame->pict_type = AV_PICTURE_TYPE_I;
         }
+
+        const auto slot = static_cast<uint64_t>(*pts) % kSubmitSlots;
+        _submitted[slot].store(submitted, std::memory_order_relaxed);
+        _captured[slot].store(captureTime(timestamp).time_since_epoch().count(),
+                              std::memory_order_relaxed);
+        ++_pending;
+        if (not _channel or not _channel->try_send(boost::system::error_code{}, std::move(frame))) {
+            --_pending;
+            _pending.notify_all();
+            LOGW_LIMITED("Encoder queue is full, drop <{}> frame", sequence);
+            if (keyframe) {
+                requestKeyframe();
+            }
+        }
+    }
+
+    void
+    requestKeyframe()
+    {
+        _keyframeRequested.store(true, std::memory_order_relaxed);
     }
 
     void
@@ -130,6 +233,50 @@ public:
         }
     }
 
+    bool
+    reset()
+    {
+        stop();
+        if (not _ctx) {
+            return false;
+        }
+        if (_codec->capabilities & AV_CODEC_CAP_ENCODER_FLUSH) {
+            avcodec_flush_buffers(_ctx);
+        } else {
+            AVCodecContext* ctx = openContext(_config);
+            if (not ctx) {
+                return false;
+            }
+            avcodec_free_context(&_ctx);
+            _ctx = ctx;
+        }
+        _firstTime.reset();
+        _lastPts.reset();
+        _decimated = 0;
+        _keyframeRequested = false;
+        return true;
+    }
+
+    std::size_t
+    pending() const
+    {
+        return _pending;
+    }
+
+    void
+    waitPending(const std::size_t limit) const
+    {
+        for (auto pending = _pending.load(); pending > limit; pending = _pending.load()) {
+            _pending.wait(pending);
+        }
+    }
+
+    unsigned
+    outputFps() const
+    {
+        return _outputFps;
+    }
+
     OnPacketReadySig
     onPacketReady()
     {
@@ -137,7 +284,10 @@ public:
     }
 
 private:
+    using Clock = std::chrono::steady_clock;
     using FramePtr = std::shared_ptr<AVFrame>;
+    using FrameChannel
+        = asio::experimental::concurrent_channel<void(boost::system::error_code, FramePtr)>;
 
     void
     cleanup()
@@ -148,15 +298,214 @@ private:
         if (_ctx) {
             avcodec_free_context(&_ctx);
         }
+        if (_pool) {
+            const HugePageStats stats = _allocator->stats();
+            LOGI("Frame pool: buffers<{}>, hugetlb<{}>, thp<{}/{}>, regular<{}>, "
+                 "coverage<{:.1f}%>",
+                 stats.allocations,
+                 stats.hugetlb,
+                 stats.transparent,
+                 stats.advised,
+                 stats.regular,
+                 stats.coverage() * 100.0);
+            /* The pool is freed when the last buffer is returned */
+            av_buffer_pool_uninit(&_pool);
+        }
+    }
+
+    [[nodiscard]] AVCodecContext*
+    openContext(const EncoderConfig& config) const
+    {
+        AVCodecContext* ctx = avcodec_alloc_context3(_codec);
+        if (not ctx) {
+            LOGE("Unable to allocate codec context");
+            return nullptr;
+        }
+        ctx->width = static_cast<int>(config.width);
+        ctx->height = static_cast<int>(config.height);
+        ctx->time_base = {1, static_cast<int>(_outputFps)};
+        ctx->framerate = {static_cast<int>(_outputFps), 1};
+        ctx->pix_fmt = AV_PIX_FMT_YUV420P;
+
+        if (config.bitrate) {
+            ctx->bit_rate = static_cast<int>(*config.bitrate);
+        }
+        if (config.gopSize) {
+            ctx->gop_size = static_cast<int>(*config.gopSize);
+        }
+        if (config.bFrames) {
+            ctx->max_b_frames = static_cast<int>(*config.bFrames);
+        }
+        if (config.threads) {
+            ctx->thread_count = static_cast<int>(*config.threads);
+        }
+        if (config.psnr) {
+            ctx->flags |= AV_CODEC_FLAG_PSNR;
+        }
+        if (_codec->id == AV_CODEC_ID_H264 or _codec->id == AV_CODEC_ID_H265) {
+            if (config.preset) {
+                av_opt_set(ctx->priv_data, "preset", config.preset->data(), 0);
+            }
+            if (config.tune) {
+                av_opt_set(ctx->priv_data, "tune", config.tune->data(), 0);
+            }
+            if (config.crf) {
+                av_opt_set_int(ctx->priv_data, "crf", *config.crf, 0);
+            }
+        }
+
+        /* The x264/x265 specific parameters ("key=value:key=value", the latter wins) */
+        std::string params;
+        if (config.lookahead) {
+            params += ":rc-lookahead=" + std::to_string(*config.lookahead);
+        }
+        if (config.lowLatency) {
+            applyLowLatency(ctx, config, params);
+        }
+        if (not params.empty()
+            and (_codec->id == AV_CODEC_ID_H264 or _codec->id == AV_CODEC_ID_H265)) {
+            const char* name = (_codec->id == AV_CODEC_ID_H264) ? "x264-params" : "x265-params";
+            av_opt_set(ctx->priv_data, name, params.data() + 1, 0);
+        }
+
+        if (const int rv = avcodec_open2(ctx, _codec, nullptr); rv < 0) {
+            LOGE("Unable to open encoder: {}", av_err2str(rv));
+            avcodec_free_context(&ctx);
+            return nullptr;
+        }
+        return ctx;
+    }
+
+    void
+    applyLowLatency(AVCodecContext* ctx, const EncoderConfig& config, std::string& params) const
+    {
+        /* Each frame is output right after it's encoded */
+        ctx->max_b_frames = 0;
+        if (config.bitrate) {
+            /* The VBV buffer of single frame keeps every frame around the average frame size */
+            ctx->rc_max_rate = static_cast<int64_t>(*config.bitrate);
+            ctx->rc_buffer_size = static_cast<int>(*config.bitrate / _outputFps);
+        } else {
+            LOGW("The frame size isn't capped in low latency profile without bitrate");
+        }
+
+        if (_codec->id == AV_CODEC_ID_H264) {
+            if (not config.tune) {
+                av_opt_set(ctx->priv_data, "tune", "zerolatency", 0);
+            }
+            /* The intra blocks are spread over GOP, so there are no keyframe bitrate spikes */
+            av_opt_set_int(ctx->priv_data, "intra-refresh", 1, 0);
+            params += ":sliced-threads=1:sync-lookahead=0:rc-lookahead=0";
+            if (config.sliceMaxSize) {
+                params += ":slice-max-size=" + std::to_string(*config.sliceMaxSize);
+            }
+        } else if (_codec->id == AV_CODEC_ID_H265) {
+            if (not config.tune) {
+                av_opt_set(ctx->priv_data, "tune", "zerolatency", 0);
+            }
+            params += ":intra-refresh=1:frame-threads=1:rc-lookahead=0";
+        }
+    }
+
+    /* Receive and discard all available packets, returns the number of them */
+    static std::size_t
+    dropPackets(AVCodecContext* ctx, AVPacket* packet)
+    {
+        std::size_t count{};
+        while (avcodec_receive_packet(ctx, packet) >= 0) {
+            av_packet_unref(packet);
+            ++count;
+        }
+        return count;
+    }
+
+    [[nodiscard]] bool
+    createPool(const EncoderConfig& config)
+    {
+        if (not _allocator) {
+            /* The memory is first touched by the copy into frame, bind it to the node of
+             * encoder threads (the configuring thread by default) */
+            const auto node = config.numaNode ? config.numaNode
+                                              : HugePageAllocator::currentNumaNode();
+            _allocator = std::make_unique<HugePageAllocator>(config.hugePages, node);
+        }
+
+        const int size
+            = av_image_get_buffer_size(_ctx->pix_fmt, _ctx->width, _ctx->height, kFrameAlign);
+        if (size < 0) {
+            LOGE("Unable to get frame size: {}", av_err2str(size));
+            return false;
+        }
+        _pool = av_buffer_pool_init2(
+            size + AV_INPUT_BUFFER_PADDING_SIZE, _allocator.get(), allocateBuffer, nullptr);
+        if (not _pool) {
+            LOGE("Unable to create frame pool");
+            return false;
+        }
+        return true;
+    }
+
+    static AVBufferRef*
+    allocateBuffer(void* opaque, const std::size_t size)
+    {
+        auto* allocator = static_cast<HugePageAllocator*>(opaque);
+        auto* data = static_cast<uint8_t*>(allocator->allocate(size));
+        if (not data) {
+            return nullptr;
+        }
+        AVBufferRef* buffer = av_buffer_create(data, size, freeBuffer, opaque, 0);
+        if (not buffer) {
+            allocator->deallocate(data);
+        }
+        return buffer;
+    }
+
+    static void
+    freeBuffer(void* opaque, uint8_t* data)
+    {
+        static_cast<HugePageAllocator*>(opaque)->deallocate(data);
+    }
+
+    /* Get pts of frame in output time base or nothing if the frame is to be dropped */
+    [[nodiscard]] std::optional<int64_t>
+    framePts(const unsigned int sequence, const int64_t timestamp)
+    {
+        /* The sequence is used when device doesn't provide timestamps */
+        const int64_t time = (timestamp > 0) ? timestamp : sequence * 1000000LL / _config.fps;
+        if (not _firstTime) {
+            _firstTime = time;
+        }
+        const int64_t elapsed = time - *_firstTime;
+
+        if (_lastPts) {
+            /* Accept the frame from half of output period (or of input one, whichever is less)
+             * before the next output slot, so the timestamp jitter doesn't drop frames */
+            const double period = 1000000.0 / _outputFps;
+            const double tolerance = std::min(period, 1000000.0 / _config.fps) / 2.0;
+            if (static_cast<double>(elapsed) < (*_lastPts + 1) * period - tolerance) {
+                return std::nullopt;
+            }
+        }
+
+        /* The dropped (by camera) frames leave gaps in pts */
+        int64_t pts = std::llround(static_cast<double>(elapsed) * _outputFps / 1000000.0);
+        if (_lastPts) {
+            pts = std::max(pts, *_lastPts + 1);
+        }
+        _lastPts = pts;
+        return pts;
     }
 
     [[nodiscard]] FramePtr
-    createFrame(const unsigned int sequence, void* data, const unsigned int /*size*/) const
+    createFrame(const int64_t pts,
+                const void* data,
+                const unsigned int /*size*/) const
     {
+        TRACE_SCOPE("Encoder::createFrame");
         auto frame = std::shared_ptr<AVFrame>(av_frame_alloc(),
                                               [](AVFrame* self) { av_frame_free(&self); });
         if (not frame) {
-            LOGE("Unable to allocate frame");
+            LOGE_LIMITED("Unable to allocate frame");
             return {};
         }
 
@@ -165,54 +514,49 @@ private:
         frame->width = width;
         const int height{_ctx->height};
         frame->height = height;
-        frame->pts = sequence;
+        frame->pts = pts;
 
-        if (const int rv = av_frame_get_buffer(frame.get(), 0); rv < 0) {
-            LOGE("Unable to allocate frame buffer: {}", av_err2str(rv));
+        /* The pooled buffer is referenced by this frame only, so it's writable */
+        frame->buf[0] = av_buffer_pool_get(_pool);
+        if (not frame->buf[0]) {
+            LOGE_LIMITED("Unable to allocate frame buffer");
             return {};
         }
-
-        av_frame_make_writable(frame.get());
-
-        int offset{0}, bytes = width * height;
-        memcpy(frame->data[0], data, bytes);
-        offset += bytes, bytes /= 4;
-        memcpy(frame->data[1], static_cast<uint8_t*>(data) + offset, bytes);
-        offset += bytes;
-        memcpy(frame->data[2], static_cast<uint8_t*>(data) + offset, bytes);
-
-        return frame;
-    }
-
-    void
-    enqueueFrame(FramePtr frame)
-    {
-        {
-            std::scoped_lock lock{_guard};
-            _queue.push(std::move(frame));
+        const int rv = av_image_fill_arrays(frame->data,
+                                            frame->linesize,
+                                            frame->buf[0]->data,
+                                            _ctx->pix_fmt,
+                                            width,
+                                            height,
+                                            kFrameAlign);
+        if (rv < 0) {
+            LOGE_LIMITED("Unable to fill frame planes: {}", av_err2str(rv));
+            return {};
         }
-        _whenNotEmpty.notify_one();
-    }
 
-    FramePtr
-    dequeueFrame()
-    {
-        std::unique_lock lock{_guard};
-        const bool ok = _whenNotEmpty.wait(
-            lock, _worker.get_stop_token(), [this] { return not _queue.empty(); });
-        FramePtr output;
-        if (ok) {
-            output = _queue.front();
-            _queue.pop();
+        /* The source planes are tightly packed, the frame lines are aligned */
+        const auto* source = static_cast<const uint8_t*>(data);
+        for (int plane = 0; plane < 3; ++plane) {
+            const int planeWidth = (plane == 0) ? width : width / 2;
+            const int planeHeight = (plane == 0) ? height : height / 2;
+            av_image_copy_plane(frame->data[plane],
+                                frame->linesize[plane],
+                                source,
+                                planeWidth,
+                                planeWidth,
+                                planeHeight);
+            source += planeWidth * planeHeight;
         }
-        return output;
+
+        return frame;
     }
 
     [[nodiscard]] bool
     sendFrame(const AVFrame* frame) const
     {
+        TRACE_SCOPE("avcodec_send_frame");
         if (const int rv = avcodec_send_frame(_ctx, frame); rv < 0) {
-            LOGE("Error on sending frame to encode: {}", av_err2str(rv));
+            LOGE_LIMITED("Error on sending frame to encode: {}", av_err2str(rv));
             return false;
         }
         return true;
@@ -223,58 +567,182 @@ private:
     {
         int rv{};
         do {
-            rv = avcodec_receive_packet(_ctx, _packet);
+            {
+                TRACE_SCOPE("avcodec_receive_packet");
+                rv = avcodec_receive_packet(_ctx, _packet);
+            }
             if (rv == AVERROR(EAGAIN) or rv == AVERROR_EOF) {
                 break;
             }
             if (rv >= 0) {
+                std::size_t statsSize{};
+                const uint8_t* stats
+                    = av_packet_get_side_data(_packet, AV_PKT_DATA_QUALITY_STATS, &statsSize);
+                if (statsSize < kErrorsOffset) {
+                    stats = nullptr;
+                }
+                const auto pictType = stats ? static_cast<AVPictureType>(stats[kPictTypeOffset])
+                                            : AV_PICTURE_TYPE_NONE;
                 notifyPacketReady({
                     .data = _packet->data,
                     .size = _packet->size,
+                    .pts = _packet->pts,
+                    .dts = _packet->dts,
+                    .key = (_packet->flags & AV_PKT_FLAG_KEY) != 0,
+                    .psnr = calculatePsnr(stats, statsSize),
+                    .type = av_get_picture_type_char(pictType),
+                    .qp = calculateQp(stats),
+                    .latency = calculateLatency(),
+                    .captureTime = capturedAt(),
                 });
             } else {
-                LOGE("Error during encoding: {}", av_err2str(rv));
+                LOGE_LIMITED("Error during encoding: {}", av_err2str(rv));
             }
             av_packet_unref(_packet);
         }
         while (rv >= 0);
     }
 
+    [[nodiscard]] double
+    calculatePsnr(const uint8_t* stats, const std::size_t size) const
+    {
+        if (not stats) {
+            return 0.0;
+        }
+
+        const std::size_t planes = std::min<std::size_t>(stats[kErrorCountOffset], 3);
+        if (size < kErrorsOffset + planes * sizeof(uint64_t)) {
+            return 0.0;
+        }
+
+        double sse{};
+        for (std::size_t n = 0; n < planes; ++n) {
+            uint64_t error{};
+            std::memcpy(&error, stats + kErrorsOffset + n * sizeof(uint64_t), sizeof(error));
+            sse += static_cast<double>(error);
+        }
+        if (sse <= 0.0) {
+            return 0.0;
+        }
+
+        /* YUV420: the chroma planes have quarter of luma samples each */
+        const double samples = _ctx->width * _ctx->height * 1.5;
+        return 10.0 * std::log10(255.0 * 255.0 * samples / sse);
+    }
+
+    [[nodiscard]] static double
+    calculateQp(const uint8_t* stats)
+    {
+        if (not stats) {
+            return 0.0;
+        }
+        /* The quality is reported as lambda */
+        uint32_t quality{};
+        std::memcpy(&quality, stats, sizeof(quality));
+        return static_cast<double>(quality) / FF_QP2LAMBDA;
+    }
+
+    [[nodiscard]] std::chrono::microseconds
+    calculateLatency() const
+    {
+        if (_packet->pts == AV_NOPTS_VALUE) {
+            return {};
+        }
+        const auto slot = static_cast<uint64_t>(_packet->pts) % kSubmitSlots;
+        const Clock::duration submitted{_submitted[slot].load(std::memory_order_relaxed)};
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+            Clock::now().time_since_epoch() - submitted);
+    }
+
+    [[nodiscard]] std::chrono::system_clock::time_point
+    capturedAt() const
+    {
+        if (_packet->pts == AV_NOPTS_VALUE) {
+            return std::chrono::system_clock::now();
+        }
+        const auto slot = static_cast<uint64_t>(_packet->pts) % kSubmitSlots;
+        return std::chrono::system_clock::time_point{std::chrono::system_clock::duration{
+            _captured[slot].load(std::memory_order_relaxed)}};
+    }
+
+    /* Get wall-clock time of capture by V4L2 timestamp (monotonic clock, microseconds) */
+    [[nodiscard]] static std::chrono::system_clock::time_point
+    captureTime(const int64_t timestamp)
+    {
+        const auto now = std::chrono::system_clock::now();
+        if (timestamp <= 0) {
+            return now;
+        }
+        const auto age = Clock::now().time_since_epoch() - std::chrono::microseconds{timestamp};
+        if (age < Clock::duration::zero() or age > kMaxCaptureAge) {
+            /* Not a timestamp of live capture (e.g. replayed spool file) */
+            return now;
+        }
+        return now - std::chrono::duration_cast<std::chrono::system_clock::duration>(age);
+    }
+
     void
     notifyPacketReady(const EncodedPacket& packet) const
     {
         _packetReadySig(packet);
     }
 
-    void
-    handleWorker(const std::stop_token& token)
-    {
-        while (not token.stop_requested()) {
-            if (auto frame = dequeueFrame(); frame) {
-                if (sendFrame(frame.get())) {
-                    recvPackets();
-                } else {
-                    LOGE("Unable to send frame");
-                }
+    asio::awaitable<void>
+    handleFrames()
+    {
+        while (true) {
+            boost::system::error_code error;
+            FramePtr frame;
+            {
+                /* The time encoder waits for the next frame in queue */
+                TRACE_SCOPE("Encoder::dequeueFrame");
+                std::tie(error, frame) = co_await _channel->async_receive(
+                    asio::as_tuple(asio::use_awaitable));
+            }
+            if (error) {
+                /* The channel is closed on stop */
+                break;
             }
+            if (sendFrame(frame.get())) {
+                recvPackets();
+            } else {
+                LOGE_LIMITED("Unable to send frame");
+            }
+            --_pending;
+            _pending.notify_all();
         }
     }
 
 private:
+    EncoderConfig _config;
     const AVCodec* _codec{};
     AVPacket* _packet{};
     AVCodecContext* _ctx{};
 
-    std::queue<FramePtr> _queue;
-    std::mutex _guard;
-    std::condition_variable_any _whenNotEmpty;
-    std::jthread _worker;
+    asio::strand<asio::any_io_executor> _strand;
+    std::optional<FrameChannel> _channel;
+    std::future<void> _done;
+    unsigned _queueSize{8};
+    unsigned _outputFps{30};
+    /* The timing of accepted frames (accessed by the thread calling encode) */
+    std::optional<int64_t> _firstTime;
+    std::optional<int64_t> _lastPts;
+    uint64_t _decimated{};
+    std::atomic<bool> _keyframeRequested{false};
+    std::atomic<std::size_t> _pending{};
+    /* The allocator outlives the pool (the pool is freed when the last frame is released) */
+    std::unique_ptr<HugePageAllocator> _allocator;
+    AVBufferPool* _pool{};
+    /* The submission time of frames indexed by pts (written by producer, read on strand) */
+    std::array<std::atomic<Clock::rep>, kSubmitSlots> _submitted{};
+    /* The wall-clock capture times (system clock ticks) of accepted frames by pts slot */
+    std::array<std::atomic<std::chrono::system_clock::rep>, kSubmitSlots> _captured{};
 
     OnPacketReadySig _packetReadySig;
 };
 
-Encoder::Encoder()
-    : _impl{std::make_unique<Impl>()}
+Encoder::Encoder(asio::any_io_executor executor)
+    : _impl{std::make_unique<Impl>(std::move(executor))}
 {
 }
 
@@ -302,10 +770,27 @@ Encoder::stop() const
 }
 
 void
-Encoder::encode(unsigned int sequence, void* data, unsigned int size) const
+Encoder::encode(const unsigned int sequence,
+                const int64_t timestamp,
+                const void* data,
+                const unsigned int size) const
 {
     assert(_impl);
-    _impl->encode(sequence, data, size);
+    _impl->encode(sequence, timestamp, data, size);
+}
+
+void
+Encoder::requestKeyframe() const
+{
+    assert(_impl);
+    _impl->requestKeyframe();
+}
+
+bool
+Encoder::warmUp(const std::size_t frames) const
+{
+    assert(_impl);
+    return _impl->warmUp(frames);
 }
 
 void
@@ -315,6 +800,34 @@ Encoder::finalize() const
     _impl->finalize();
 }
 
+bool
+Encoder::reset() const
+{
+    assert(_impl);
+    return _impl->reset();
+}
+
+std::size_t
+Encoder::pending() const
+{
+    assert(_impl);
+    return _impl->pending();
+}
+
+void
+Encoder::waitPending(const std::size_t limit) const
+{
+    assert(_impl);
+    _impl->waitPending(limit);
+}
+
+unsigned
+Encoder::outputFps() const
+{
+    assert(_impl);
+    return _impl->outputFps();
+}
+
 Encoder::OnPacketReadySig
 Encoder::onPacketReady() const
 {
@@ -1,9 +1,12 @@
 #pragma once
 
+#include <boost/asio/any_io_executor.hpp>
 #include <sigc++/signal.h>
 
+#include <chrono>
 #include <memory>
 #include <optional>
+#include <string>
 
 namespace jar {
 
@@ -16,6 +19,8 @@ struct EncoderConfig {
     unsigned height{480};
     /* The frame rate of incoming stream */
     unsigned fps{30};
+    /* The frame rate of encoded output (the incoming frames are decimated when lower) */
+    std::optional<unsigned> targetFps;
     /* The preset to use while encoding */
     std::optional<std::string> preset;
     /* The tune to apply after applying preset  */
@@ -28,6 +33,29 @@ struct EncoderConfig {
     std::optional<unsigned> gopSize;
     /* The maximum number of B-frames (the output will be delayed by bFrame+1 relative to input) */
     std::optional<unsigned> bFrames;
+    /* The number of encoder threads (0 - chosen by encoder) */
+    std::optional<unsigned> threads;
+    /* The number of frames of rate control lookahead (libx264, libx265) */
+    std::optional<unsigned> lookahead;
+    /*
+     * Whether to use low latency profile: periodic intra refresh instead of keyframes, frame size
+     * capped by VBV to single frame of bitrate, no B-frames and sliced threads (libx264)
+     */
+    bool lowLatency{false};
+    /* The maximum size of slice (bytes) in low latency profile (libx264, e.g. RTP payload size) */
+    std::optional<unsigned> sliceMaxSize;
+    /* Whether to compute PSNR of encoded frames (if supported by encoder) */
+    bool psnr{false};
+    /* The maximum number of frames waiting for encoding (new frames are dropped when full) */
+    unsigned queueSize{8};
+    /* Whether to allocate frame pool from huge pages (falls back to regular pages) */
+    bool hugePages{true};
+    /* The NUMA node to allocate frame pool on (the node of configuring thread if not set) */
+    std::optional<int> numaNode;
+
+    bool
+    operator==(const EncoderConfig&) const
+        = default;
 };
 
 struct EncodedPacket {
@@ -35,13 +63,33 @@ struct EncodedPacket {
     uint8_t* data{};
     /* The size of payload */
     int size{};
+    /* The presentation timestamp (in encoder time base, 1/output fps) */
+    int64_t pts{};
+    /* The decoding timestamp (in encoder time base, 1/output fps) */
+    int64_t dts{};
+    /* Whether the packet contains keyframe */
+    bool key{};
+    /* The PSNR of encoded frame (dB) or zero if not computed */
+    double psnr{};
+    /* The picture type of encoded frame ('I', 'P', 'B' or '?' if not reported by encoder) */
+    char type{'?'};
+    /* The average quantizer of encoded frame or zero if not reported by encoder */
+    double qp{};
+    /* The time from frame submission to packet output */
+    std::chrono::microseconds latency{};
+    /* The wall-clock time of frame capture (the submission time if it isn't known) */
+    std::chrono::system_clock::time_point captureTime;
 };
 
+/*
+ * Encodes frames on a strand of given executor. The frames are handed off through bounded
+ * channel to encoding coroutine, the packets are notified on the same strand.
+ */
 class Encoder {
 public:
     using OnPacketReadySig = sigc::signal<void(const EncodedPacket& packet)>;
 
-    Encoder();
+    explicit Encoder(boost::asio::any_io_executor executor);
 
     ~Encoder();
 
@@ -54,12 +102,39 @@ public:
     void
     stop() const;
 
+    /* Encode frame captured at given time (microseconds, zero if unknown), the frames exceeding
+     * output frame rate are dropped before copying (must be called from single thread) */
     void
-    encode(unsigned int sequence, void* data, unsigned int size) const;
+    encode(unsigned int sequence, int64_t timestamp, const void* data, unsigned int size) const;
+
+    /* Force the next encoded frame to be keyframe (e.g. after the input stream gap) */
+    void
+    requestKeyframe() const;
+
+    /* Encode given number of synthetic frames by throwaway context (before start) */
+    [[nodiscard]] bool
+    warmUp(std::size_t frames) const;
 
     void
     finalize() const;
 
+    /* Prepare finalized encoder for the next stream with the same config (the codec context is
+     * flushed if supported or reopened, the frame pool is kept) */
+    [[nodiscard]] bool
+    reset() const;
+
+    /* Get the number of frames waiting for encoding or being encoded */
+    [[nodiscard]] std::size_t
+    pending() const;
+
+    /* Block until at most given number of frames are pending (the caller feeds no frames) */
+    void
+    waitPending(std::size_t limit) const;
+
+    /* Get the frame rate of encoded output (defines time base of packets) */
+    [[nodiscard]] unsigned
+    outputFps() const;
+
     [[nodiscard]] OnPacketReadySig
     onPacketReady() const;
 
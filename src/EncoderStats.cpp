@@ -0,0 +1,235 @@
+#include "EncoderStats.hpp"
+
+#include "Logger.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <vector>
+
+namespace jar {
+
+namespace {
+
+/* The interval of moving queued stats into rolling windows */
+constexpr std::chrono::milliseconds kDrainInterval{100};
+
+struct TypeStats {
+    uint64_t count{};
+    uint64_t bytes{};
+    uint32_t maxSize{};
+    double qp{};
+
+    [[nodiscard]] double
+    avgSize() const
+    {
+        return count > 0 ? static_cast<double>(bytes) / static_cast<double>(count) : 0.0;
+    }
+
+    [[nodiscard]] double
+    avgQp() const
+    {
+        return count > 0 ? qp / static_cast<double>(count) : 0.0;
+    }
+};
+
+template<typename T>
+[[nodiscard]] T
+percentile(const std::vector<T>& sorted, const double p)
+{
+    if (sorted.empty()) {
+        return T{};
+    }
+    const auto index = static_cast<std::size_t>(p * static_cast<double>(sorted.size() - 1));
+    return sorted[index];
+}
+
+} // namespace
+
+EncoderStats::EncoderStats(EncoderStatsConfig config)
+    : _config{std::move(config)}
+{
+    _config.fps = std::max(1u, _config.fps);
+    _config.frames = std::max<std::size_t>(1, _config.frames);
+    _config.gops = std::max<std::size_t>(1, _config.gops);
+    _config.queueSize = std::max<std::size_t>(1, _config.queueSize);
+    _queue = std::make_unique<FrameStats[]>(_config.queueSize);
+}
+
+EncoderStats::~EncoderStats()
+{
+    stop();
+}
+
+void
+EncoderStats::start()
+{
+    _worker = std::jthread{[this](const std::stop_token& token) { handleWorker(token); }};
+}
+
+void
+EncoderStats::stop()
+{
+    _worker.request_stop();
+    if (_worker.joinable()) {
+        _worker.join();
+    }
+}
+
+void
+EncoderStats::push(const EncodedPacket& packet) noexcept
+{
+    const uint64_t head = _head.load(std::memory_order_relaxed);
+    if (head - _tail.load(std::memory_order_acquire) >= _config.queueSize) {
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    _queue[head % _config.queueSize] = FrameStats{
+        .pts = packet.pts,
+        .dts = packet.dts,
+        .size = static_cast<uint32_t>(packet.size),
+        .type = packet.type,
+        .key = packet.key,
+        .qp = static_cast<float>(packet.qp),
+        .latency = packet.latency,
+    };
+    _head.store(head + 1, std::memory_order_release);
+}
+
+std::string
+EncoderStats::report()
+{
+    std::scoped_lock lock{_guard};
+    drain();
+
+    TypeStats types[3];
+    std::vector<float> qps;
+    std::vector<std::chrono::microseconds> latencies;
+    qps.reserve(_frames.size());
+    latencies.reserve(_frames.size());
+    for (const FrameStats& frame : _frames) {
+        TypeStats* type{};
+        switch (frame.type) {
+        case 'I':
+            type = &types[0];
+            break;
+        case 'P':
+            type = &types[1];
+            break;
+        case 'B':
+            type = &types[2];
+            break;
+        default:
+            /* The picture type is not reported, the keyframes are still distinguishable */
+            type = frame.key ? &types[0] : &types[1];
+            break;
+        }
+        ++type->count, type->bytes += frame.size, type->qp += frame.qp;
+        type->maxSize = std::max(type->maxSize, frame.size);
+        qps.push_back(frame.qp);
+        latencies.push_back(frame.latency);
+    }
+    std::sort(qps.begin(), qps.end());
+    std::sort(latencies.begin(), latencies.end());
+
+    /* The bitrate is computed over complete GOPs unless the first one is still in progress */
+    std::vector<double> bitrates;
+    const std::size_t complete = (_gops.size() > 1) ? _gops.size() - 1 : _gops.size();
+    for (std::size_t n = 0; n < complete; ++n) {
+        const Gop& gop = _gops[n];
+        if (gop.frames > 0) {
+            bitrates.push_back(static_cast<double>(gop.bytes) * 8.0 * _config.fps
+                               / static_cast<double>(gop.frames) / 1000.0);
+        }
+    }
+    double avgBitrate{};
+    for (const double bitrate : bitrates) {
+        avgBitrate += bitrate / static_cast<double>(bitrates.size());
+    }
+
+    const auto ms = [](const std::chrono::microseconds value) { return value.count() / 1000.0; };
+
+    std::string out;
+    auto it = std::back_inserter(out);
+    fmt::format_to(it,
+                   "frames: total<{}>, dropped<{}>, window<{}>\n",
+                   _total,
+                   _dropped.load(std::memory_order_relaxed),
+                   _frames.size());
+    fmt::format_to(it,
+                   "gop bitrate (kbps): gops<{}>, last<{:.1f}>, min<{:.1f}>, avg<{:.1f}>, "
+                   "max<{:.1f}>\n",
+                   bitrates.size(),
+                   bitrates.empty() ? 0.0 : bitrates.back(),
+                   bitrates.empty() ? 0.0 : *std::min_element(bitrates.begin(), bitrates.end()),
+                   avgBitrate,
+                   bitrates.empty() ? 0.0 : *std::max_element(bitrates.begin(), bitrates.end()));
+    for (std::size_t n = 0; n < std::size(types); ++n) {
+        fmt::format_to(it,
+                       "{} frames: count<{}>, avg size<{:.0f}>, max size<{}>, avg qp<{:.1f}>\n",
+                       "IPB"[n],
+                       types[n].count,
+                       types[n].avgSize(),
+                       types[n].maxSize,
+                       types[n].avgQp());
+    }
+    fmt::format_to(it,
+                   "i/p size ratio: {:.2f}\n",
+                   types[1].avgSize() > 0 ? types[0].avgSize() / types[1].avgSize() : 0.0);
+    fmt::format_to(it,
+                   "qp: min<{:.1f}>, p10<{:.1f}>, p50<{:.1f}>, p90<{:.1f}>, max<{:.1f}>\n",
+                   percentile(qps, 0.0),
+                   percentile(qps, 0.1),
+                   percentile(qps, 0.5),
+                   percentile(qps, 0.9),
+                   percentile(qps, 1.0));
+    fmt::format_to(it,
+                   "latency (ms): p50<{:.2f}>, p99<{:.2f}>, max<{:.2f}>\n",
+                   ms(percentile(latencies, 0.5)),
+                   ms(percentile(latencies, 0.99)),
+                   ms(percentile(latencies, 1.0)));
+    return out;
+}
+
+void
+EncoderStats::handleWorker(const std::stop_token& token)
+{
+    while (not token.stop_requested()) {
+        std::unique_lock lock{_guard};
+        _whenStopped.wait_for(lock, token, kDrainInterval, [] { return false; });
+        drain();
+    }
+}
+
+void
+EncoderStats::drain()
+{
+    const uint64_t head = _head.load(std::memory_order_acquire);
+    uint64_t tail = _tail.load(std::memory_order_relaxed);
+    for (; tail < head; ++tail) {
+        aggregate(_queue[tail % _config.queueSize]);
+    }
+    _tail.store(tail, std::memory_order_release);
+}
+
+void
+EncoderStats::aggregate(const FrameStats& stats)
+{
+    ++_total;
+
+    _frames.push_back(stats);
+    if (_frames.size() > _config.frames) {
+        _frames.pop_front();
+    }
+
+    if (stats.key or _gops.empty()) {
+        /* Keep the window of complete GOPs plus the one in progress */
+        _gops.emplace_back();
+        if (_gops.size() > _config.gops + 1) {
+            _gops.pop_front();
+        }
+    }
+    ++_gops.back().frames, _gops.back().bytes += stats.size;
+}
+
+} // namespace jar
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "Encoder.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace jar {
+
+struct EncoderStatsConfig {
+    /* The frame rate of encoded stream (used to compute bitrate) */
+    unsigned fps{30};
+    /* The number of recent frames in rolling window (sizes, QP and latency) */
+    std::size_t frames{300};
+    /* The number of recent GOPs in rolling window (bitrate) */
+    std::size_t gops{8};
+    /* The capacity of hand-off queue between encoder and aggregator (frames) */
+    std::size_t queueSize{1024};
+};
+
+/* The statistics of single encoded frame */
+struct FrameStats {
+    int64_t pts{};
+    int64_t dts{};
+    uint32_t size{};
+    char type{'?'};
+    bool key{};
+    float qp{};
+    std::chrono::microseconds latency{};
+};
+
+/*
+ * Aggregates per-frame encoder statistics into rolling windows: bitrate per GOP, frame sizes
+ * by picture type, QP distribution and encode latency. The encoder pushes frame stats into
+ * lock-free single-producer queue (never blocks, drops when full), the aggregation runs on
+ * background thread.
+ */
+class EncoderStats {
+public:
+    explicit EncoderStats(EncoderStatsConfig config);
+
+    ~EncoderStats();
+
+    void
+    start();
+
+    void
+    stop();
+
+    /* Push stats of encoded packet (single producer, e.g. encoder strand) */
+    void
+    push(const EncodedPacket& packet) noexcept;
+
+    /* Get the report on rolling windows (human readable, one metric per line) */
+    [[nodiscard]] std::string
+    report();
+
+private:
+    struct Gop {
+        uint64_t frames{};
+        uint64_t bytes{};
+    };
+
+    void
+    handleWorker(const std::stop_token& token);
+
+    /* Move queued frames into rolling windows */
+    void
+    drain();
+
+    void
+    aggregate(const FrameStats& stats);
+
+private:
+    EncoderStatsConfig _config;
+
+    /* The ring of single-producer single-consumer queue */
+    std::unique_ptr<FrameStats[]> _queue;
+    std::atomic<uint64_t> _head{};
+    std::atomic<uint64_t> _tail{};
+    std::atomic<uint64_t> _dropped{};
+
+    std::mutex _guard;
+    std::deque<FrameStats> _frames;
+    std::deque<Gop> _gops;
+    uint64_t _total{};
+    std::condition_variable_any _whenStopped;
+    std::jthread _worker;
+};
+
+} // namespace jar
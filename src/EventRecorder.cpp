@@ -0,0 +1,186 @@
+#include "EventRecorder.hpp"
+
+#include "Logger.hpp"
+#include "RecordingFile.hpp"
+
+#include <ctime>
+
+namespace fs = std::filesystem;
+
+namespace jar {
+
+namespace {
+
+/* The interval to check recording deadline while waiting for packets */
+constexpr std::chrono::milliseconds kReadTimeout{100};
+/* The initial capacity of packet buffer */
+constexpr std::size_t kPayloadCapacity = 1024 * 1024;
+
+} // namespace
+
+EventRecorder::EventRecorder(PreRollBuffer& buffer, EventRecorderConfig config, FileSink* sink)
+    : _buffer{buffer}
+    , _config{std::move(config)}
+    , _sink{sink}
+{
+}
+
+EventRecorder::~EventRecorder()
+{
+    stop();
+}
+
+void
+EventRecorder::start()
+{
+    std::error_code ec;
+    fs::create_directories(_config.directory, ec);
+    if (ec) {
+        LOGW("Unable to create <{}> directory: {}", _config.directory, ec.message());
+    }
+
+    _worker = std::jthread{[this](const std::stop_token& token) { handleWorker(token); }};
+}
+
+void
+EventRecorder::stop()
+{
+    _worker.request_stop();
+    if (_worker.joinable()) {
+        _worker.join();
+    }
+}
+
+fs::path
+EventRecorder::trigger(const std::optional<std::chrono::milliseconds> duration)
+{
+    fs::path path;
+    {
+        std::scoped_lock lock{_guard};
+        _deadline = std::max(_deadline, Clock::now() + duration.value_or(_config.duration));
+        if (not _active.empty()) {
+            LOGI("Extend <{}> event recording", _active);
+            return _active;
+        }
+        if (not _pending) {
+            _pending = makeFilePath();
+        }
+        path = *_pending;
+    }
+    _whenTriggered.notify_one();
+    return path;
+}
+
+void
+EventRecorder::handleWorker(const std::stop_token& token)
+{
+    while (not token.stop_requested()) {
+        fs::path path;
+        {
+            std::unique_lock lock{_guard};
+            if (not _whenTriggered.wait(lock, token, [this] { return _pending.has_value(); })) {
+                break;
+            }
+            path = _active = std::move(*_pending);
+            _pending.reset();
+        }
+
+        record(token, path);
+
+        /* Already cleared unless the recording was interrupted by failure or stop */
+        std::scoped_lock lock{_guard};
+        _active.clear();
+    }
+}
+
+void
+EventRecorder::record(const std::stop_token& token, const fs::path& path)
+{
+    RecordingFile file;
+    if (not file.open(path, 1, static_cast<int32_t>(_config.fps), _sink)) {
+        return;
+    }
+
+    LOGI("Start <{}> event recording", path);
+
+    std::vector<uint8_t> payload;
+    payload.reserve(kPayloadCapacity);
+    PreRollBuffer::PacketInfo info;
+    std::size_t packets{}, bytes{};
+    uint64_t cursor = _buffer.tail();
+
+    bool recording{true}, skipping{false};
+    while (recording) {
+        switch (_buffer.read(cursor, payload, info, kReadTimeout, token)) {
+        case PreRollBuffer::ReadResult::Ok: {
+            /* The packets following the dropped one can't be decoded until the next keyframe */
+            if (skipping and not info.key) {
+                recording = keepRecording(info.timestamp);
+                break;
+            }
+            /* The packets are stamped by steady clock, translate it into wall-clock time */
+            const auto time = RecordingFile::WallClock::now()
+                              - std::chrono::duration_cast<RecordingFile::WallClock::duration>(
+                                  Clock::now() - info.timestamp);
+            if (file.write(payload.data(), payload.size(), info.pts, info.key, time)) {
+                skipping = false;
+                ++packets, bytes += payload.size();
+            } else if (_sink) {
+                /* The sink only drops packets when it has no room, the recording goes on */
+                LOGW_LIMITED("Event recording packet was dropped, skip to the next keyframe");
+                skipping = true;
+            } else {
+                recording = false;
+                break;
+            }
+            recording = keepRecording(info.timestamp);
+            break;
+        }
+        case PreRollBuffer::ReadResult::Timeout:
+            recording = keepRecording(Clock::now());
+            break;
+        case PreRollBuffer::ReadResult::Overrun:
+            LOGW("Event recording is too slow, skip to the next keyframe");
+            break;
+        case PreRollBuffer::ReadResult::Stopped:
+            recording = false;
+            break;
+        }
+    }
+
+    file.close();
+    LOGI("Stop <{}> event recording: packets<{}>, bytes<{}>, keyframes<{}>",
+         path,
+         packets,
+         bytes,
+         file.keyframes());
+}
+
+bool
+EventRecorder::keepRecording(const Clock::time_point until)
+{
+    /*
+     * The recording is deactivated under the same lock as the deadline is checked, so the trigger
+     * either extends it in time or starts a new one
+     */
+    std::scoped_lock lock{_guard};
+    if (until <= _deadline) {
+        return true;
+    }
+    _active.clear();
+    return false;
+}
+
+fs::path
+EventRecorder::makeFilePath() const
+{
+    const std::time_t now = std::time(nullptr);
+    std::tm tm{};
+    localtime_r(&now, &tm);
+
+    char name[64];
+    std::strftime(name, sizeof(name), "event-%Y%m%d-%H%M%S", &tm);
+    return _config.directory / (name + _config.extension);
+}
+
+} // namespace jar
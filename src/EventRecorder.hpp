@@ -0,0 +1,77 @@
+#pragma once
+
+#include "FileSink.hpp"
+#include "PreRollBuffer.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
+namespace jar {
+
+struct EventRecorderConfig {
+    /* The directory to store event recordings */
+    std::filesystem::path directory;
+    /* The extension of recording files (depends on codec) */
+    std::string extension{".h264"};
+    /* The duration of recording after the trigger */
+    std::chrono::milliseconds duration{std::chrono::seconds{10}};
+    /* The frame rate of encoder (pts time base of keyframe index) */
+    unsigned fps{30};
+};
+
+/*
+ * Flushes pre-roll and live packets from pre-roll buffer into file on trigger. All file
+ * operations are performed on background thread. Triggering during active recording
+ * extends it. Each recording gets keyframe index next to it (see RecordingFile). If file sink
+ * is given, the recordings are written through it.
+ */
+class EventRecorder {
+public:
+    EventRecorder(PreRollBuffer& buffer, EventRecorderConfig config, FileSink* sink = nullptr);
+
+    ~EventRecorder();
+
+    void
+    start();
+
+    void
+    stop();
+
+    /* Trigger recording, returns the path of recording file */
+    [[nodiscard]] std::filesystem::path
+    trigger(std::optional<std::chrono::milliseconds> duration = std::nullopt);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void
+    handleWorker(const std::stop_token& token);
+
+    void
+    record(const std::stop_token& token, const std::filesystem::path& path);
+
+    /* Check the deadline, the recording is deactivated at once when it's passed */
+    [[nodiscard]] bool
+    keepRecording(Clock::time_point until);
+
+    [[nodiscard]] std::filesystem::path
+    makeFilePath() const;
+
+private:
+    PreRollBuffer& _buffer;
+    EventRecorderConfig _config;
+    FileSink* _sink{};
+    std::optional<std::filesystem::path> _pending;
+    std::filesystem::path _active;
+    Clock::time_point _deadline;
+    std::mutex _guard;
+    std::condition_variable_any _whenTriggered;
+    std::jthread _worker;
+};
+
+} // namespace jar
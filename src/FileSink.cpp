@@ -0,0 +1,720 @@
+#include "FileSink.hpp"
+
+#include "Logger.hpp"
+
+#include <boost/asio/post.hpp>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <tuple>
+
+namespace asio = boost::asio;
+
+namespace jar {
+
+namespace {
+
+/* The alignment of staging buffers (suitable for O_DIRECT as well) */
+constexpr std::size_t kBufferAlignment = 4096;
+
+/* The number of recent writes per stream used for latency percentiles */
+constexpr std::size_t kLatencySamples = 1024;
+
+/* The user data of completions which are not writes */
+constexpr uint64_t kEventTag = std::numeric_limits<uint64_t>::max();
+constexpr uint64_t kTickTag = kEventTag - 1;
+constexpr uint64_t kSyncTag = kEventTag - 2;
+
+[[nodiscard]] int64_t
+writeAll(const int fd, const uint8_t* data, const std::size_t size, const uint64_t offset)
+{
+    std::size_t written{};
+    while (written < size) {
+        const ssize_t rv
+            = pwrite(fd, data + written, size - written, static_cast<off_t>(offset + written));
+        if (rv == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -errno;
+        }
+        written += rv;
+    }
+    return static_cast<int64_t>(written);
+}
+
+template<typename T>
+[[nodiscard]] T
+percentile(const std::vector<T>& sorted, const double p)
+{
+    if (sorted.empty()) {
+        return T{};
+    }
+    const auto index = static_cast<std::size_t>(p * static_cast<double>(sorted.size() - 1));
+    return sorted[index];
+}
+
+} // namespace
+
+void
+FileSink::AlignedDeleter::operator()(uint8_t* ptr) const
+{
+    std::free(ptr);
+}
+
+FileSink::FileSink(FileSinkConfig config)
+    : _config{std::move(config)}
+{
+    _config.bufferSize = std::max(kBufferAlignment,
+                                  (_config.bufferSize + kBufferAlignment - 1) / kBufferAlignment
+                                      * kBufferAlignment);
+    _config.bufferCount = std::max(2u, _config.bufferCount);
+    _config.queueDepth = std::clamp(_config.queueDepth, 1u, _config.bufferCount);
+    _config.threads = std::max(1u, _config.threads);
+}
+
+FileSink::~FileSink()
+{
+    stop();
+}
+
+bool
+FileSink::start()
+{
+    _buffers.resize(_config.bufferCount);
+    for (auto& buffer : _buffers) {
+        auto* ptr = std::aligned_alloc(kBufferAlignment, _config.bufferSize);
+        buffer.reset(static_cast<uint8_t*>(ptr));
+        if (not buffer) {
+            LOGE("Unable to allocate sink buffer");
+            return false;
+        }
+    }
+    _free.clear();
+    for (unsigned n = _config.bufferCount; n > 0; --n) {
+        _free.push_back(n - 1);
+    }
+
+    _event = eventfd(0, EFD_CLOEXEC);
+    if (_event == -1) {
+        LOGE("Unable to create event: {}", strerror(errno));
+        return false;
+    }
+
+    /* Each write may be followed by linked sync, plus the wake-up read and the tick timeout */
+    if (_config.ioUring and _ring.setup(_config.queueDepth * 2 + 2)) {
+        if (_ring.features() & IORING_FEAT_RW_CUR_POS) {
+            std::vector<iovec> iovecs;
+            for (const auto& buffer : _buffers) {
+                iovecs.push_back(iovec{.iov_base = buffer.get(), .iov_len = _config.bufferSize});
+            }
+            /* The buffers may exceed locked memory limit, plain writes are used then */
+            _fixedBuffers = _ring.registerBuffers(iovecs);
+            _slots.resize(_config.queueDepth);
+            _freeSlots.clear();
+            for (unsigned n = _config.queueDepth; n > 0; --n) {
+                _freeSlots.push_back(n - 1);
+            }
+            const auto ns = std::chrono::nanoseconds{_config.flushInterval}.count();
+            _tick = __kernel_timespec{.tv_sec = ns / 1000000000, .tv_nsec = ns % 1000000000};
+        } else {
+            _ring.close();
+        }
+    }
+    if (not _ring.ready()) {
+        if (_config.ioUring) {
+            LOGW("The io_uring is not available, use writer threads");
+        }
+        _pool = std::make_unique<asio::thread_pool>(_config.threads);
+    }
+
+    LOGI("File sink config: ioUring<{}>, fixedBuffers<{}>, bufferSize<{}>, bufferCount<{}>, "
+         "queueDepth<{}>, syncInterval<{}ms>",
+         _ring.ready(),
+         _fixedBuffers,
+         _config.bufferSize,
+         _config.bufferCount,
+         _config.queueDepth,
+         _config.syncInterval.count());
+
+    _submitter = std::jthread{[this](const std::stop_token& token) { handleSubmission(token); }};
+    return true;
+}
+
+void
+FileSink::stop()
+{
+    if (_submitter.joinable()) {
+        std::vector<StreamId> ids;
+        {
+            std::scoped_lock lock{_streamsGuard};
+            for (const auto& [id, stream] : _streams) {
+                ids.push_back(id);
+            }
+        }
+        for (const StreamId id : ids) {
+            close(id);
+        }
+        _submitter.request_stop();
+        wakeUp();
+        _submitter.join();
+    }
+    if (_pool) {
+        _pool->join();
+        _pool.reset();
+    }
+    _ring.close();
+    _eventArmed = _tickArmed = _fixedBuffers = false;
+    if (_event != -1) {
+        ::close(_event);
+        _event = -1;
+    }
+}
+
+bool
+FileSink::usingIoUring() const
+{
+    return _ring.ready();
+}
+
+std::optional<FileSink::StreamId>
+FileSink::open(const std::filesystem::path& path)
+{
+    const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        LOGE("Unable to open <{}> file: {}", path, strerror(errno));
+        return std::nullopt;
+    }
+
+    auto stream = std::make_shared<Stream>();
+    stream->path = path;
+    stream->fd = fd;
+    stream->lastSync = Clock::now();
+    stream->latencies.reserve(kLatencySamples);
+
+    std::scoped_lock lock{_streamsGuard};
+    const StreamId id = _nextId++;
+    _streams.emplace(id, std::move(stream));
+    return id;
+}
+
+void
+FileSink::close(const StreamId id)
+{
+    std::shared_ptr<Stream> stream;
+    {
+        std::scoped_lock lock{_streamsGuard};
+        if (const auto it = _streams.find(id); it != _streams.end()) {
+            stream = std::move(it->second);
+            _streams.erase(it);
+        }
+    }
+    if (not stream) {
+        return;
+    }
+
+    {
+        std::scoped_lock lock{stream->guard};
+        stream->closed = true;
+        if (stream->buffer and stream->filled > 0) {
+            enqueue(stream);
+        } else if (stream->buffer) {
+            releaseBuffer(*stream->buffer);
+            stream->buffer.reset();
+        }
+    }
+    {
+        /* The stream is finalized by submission thread after all its writes complete */
+        std::scoped_lock lock{_queueGuard};
+        _closed.push_back(std::move(stream));
+    }
+    wakeUp();
+}
+
+bool
+FileSink::write(const StreamId id, const uint8_t* data, const std::size_t size)
+{
+    const auto stream = findStream(id);
+    if (not stream) {
+        return false;
+    }
+    if (size == 0) {
+        return true;
+    }
+
+    std::scoped_lock lock{stream->guard};
+    if (stream->closed) {
+        return false;
+    }
+
+    /* All needed buffers are taken upfront, so the data is either queued entirely or dropped */
+    std::vector<unsigned> spare;
+    const std::size_t room = stream->buffer ? _config.bufferSize - stream->filled : 0;
+    if (size > room) {
+        const std::size_t count = (size - room + _config.bufferSize - 1) / _config.bufferSize;
+        if (not acquireBuffers(count, spare)) {
+            stream->dropped.fetch_add(1, std::memory_order_relaxed);
+            LOGW_LIMITED("No free sink buffer, drop <{}> bytes of <{}> file", size, stream->path);
+            return false;
+        }
+    }
+
+    std::size_t copied{};
+    while (copied < size) {
+        if (not stream->buffer) {
+            stream->buffer = spare.back();
+            spare.pop_back();
+            stream->filled = 0;
+            stream->filledSince = Clock::now();
+        }
+        const std::size_t chunk = std::min(size - copied, _config.bufferSize - stream->filled);
+        std::memcpy(_buffers[*stream->buffer].get() + stream->filled, data + copied, chunk);
+        stream->filled += chunk;
+        copied += chunk;
+        if (stream->filled == _config.bufferSize) {
+            enqueue(stream);
+        }
+    }
+    return true;
+}
+
+std::vector<FileSinkStreamStats>
+FileSink::stats() const
+{
+    std::vector<FileSinkStreamStats> output;
+    std::scoped_lock lock{_streamsGuard};
+    for (const auto& [id, stream] : _streams) {
+        std::vector<uint32_t> latencies;
+        uint32_t latencyMax{};
+        {
+            std::scoped_lock statsLock{stream->statsGuard};
+            latencies = stream->latencies;
+            latencyMax = stream->latencyMax;
+        }
+        std::sort(latencies.begin(), latencies.end());
+        output.push_back(FileSinkStreamStats{
+            .path = stream->path,
+            .bytes = stream->bytes.load(std::memory_order_relaxed),
+            .writes = stream->writes.load(std::memory_order_relaxed),
+            .dropped = stream->dropped.load(std::memory_order_relaxed),
+            .errors = stream->errors.load(std::memory_order_relaxed),
+            .queueDepth = stream->queueDepth.load(std::memory_order_relaxed),
+            .maxQueueDepth = stream->maxQueueDepth.load(std::memory_order_relaxed),
+            .latencyP50 = std::chrono::microseconds{percentile(latencies, 0.5)},
+            .latencyP99 = std::chrono::microseconds{percentile(latencies, 0.99)},
+            .latencyMax = std::chrono::microseconds{latencyMax},
+        });
+    }
+    return output;
+}
+
+std::string
+FileSink::report() const
+{
+    const auto ms = [](const std::chrono::microseconds value) { return value.count() / 1000.0; };
+
+    std::string out;
+    auto it = std::back_inserter(out);
+    fmt::format_to(it,
+                   "sink: writer<{}>, inflight<{}>\n",
+                   usingIoUring() ? (_fixedBuffers ? "io_uring (fixed buffers)" : "io_uring")
+                                  : "threads",
+                   _inflight.load(std::memory_order_relaxed));
+    for (const auto& stats : stats()) {
+        fmt::format_to(it,
+                       "{}: bytes<{}>, writes<{}>, dropped<{}>, errors<{}>, queue<{}/{}>, "
+                       "latency (ms) p50<{:.2f}>, p99<{:.2f}>, max<{:.2f}>\n",
+                       stats.path,
+                       stats.bytes,
+                       stats.writes,
+                       stats.dropped,
+                       stats.errors,
+                       stats.queueDepth,
+                       stats.maxQueueDepth,
+                       ms(stats.latencyP50),
+                       ms(stats.latencyP99),
+                       ms(stats.latencyMax));
+    }
+    return out;
+}
+
+std::shared_ptr<FileSink::Stream>
+FileSink::findStream(const StreamId id) const
+{
+    std::scoped_lock lock{_streamsGuard};
+    const auto it = _streams.find(id);
+    return (it != _streams.end()) ? it->second : nullptr;
+}
+
+bool
+FileSink::acquireBuffers(const std::size_t count, std::vector<unsigned>& buffers)
+{
+    std::scoped_lock lock{_poolGuard};
+    if (_free.size() < count) {
+        return false;
+    }
+    buffers.assign(_free.end() - static_cast<std::ptrdiff_t>(count), _free.end());
+    _free.resize(_free.size() - count);
+    return true;
+}
+
+void
+FileSink::releaseBuffer(const unsigned buffer)
+{
+    std::scoped_lock lock{_poolGuard};
+    _free.push_back(buffer);
+}
+
+void
+FileSink::enqueue(const std::shared_ptr<Stream>& stream)
+{
+    Request request{
+        .stream = stream,
+        .buffer = *stream->buffer,
+        .size = static_cast<uint32_t>(stream->filled),
+        .offset = stream->offset,
+        .queued = Clock::now(),
+    };
+    stream->offset += stream->filled;
+    stream->buffer.reset();
+    stream->filled = 0;
+
+    /* The depth is increased under stream guard only, so the maximum is not racy */
+    const unsigned depth = stream->queueDepth.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (depth > stream->maxQueueDepth.load(std::memory_order_relaxed)) {
+        stream->maxQueueDepth.store(depth, std::memory_order_relaxed);
+    }
+
+    {
+        std::scoped_lock lock{_queueGuard};
+        _queue.push_back(std::move(request));
+    }
+    wakeUp();
+}
+
+void
+FileSink::wakeUp()
+{
+    const uint64_t value{1};
+    if (::write(_event, &value, sizeof(value)) == -1) {
+        LOGE_LIMITED("Unable to wake up sink: {}", strerror(errno));
+    }
+}
+
+void
+FileSink::handleSubmission(const std::stop_token& token)
+{
+    while (true) {
+        const auto now = Clock::now();
+        flushIdle(now);
+
+        /* Queue as many writes as allowed, they are submitted to kernel by single call */
+        Request request;
+        while (_inflight.load() < _config.queueDepth and dequeue(request)) {
+            prepare(request, now);
+            if (_ring.ready()) {
+                if (not submitUring(request)) {
+                    std::scoped_lock lock{_queueGuard};
+                    _queue.push_front(std::move(request));
+                    break;
+                }
+            } else {
+                submitPool(std::move(request));
+            }
+        }
+
+        finalizeClosed();
+        if (token.stop_requested() and idle()) {
+            break;
+        }
+
+        if (_ring.ready()) {
+            armEvent();
+            armTick();
+            if (const int rv = _ring.submit(1); rv < 0) {
+                LOGE_LIMITED("Unable to submit sink writes: {}", strerror(-rv));
+            }
+            _ring.reap([this](const io_uring_cqe& cqe) { handleCompletion(cqe); });
+        } else {
+            pollfd fd{.fd = _event, .events = POLLIN, .revents = 0};
+            if (poll(&fd, 1, static_cast<int>(_config.flushInterval.count())) > 0) {
+                std::ignore = read(_event, &_eventValue, sizeof(_eventValue));
+            }
+        }
+    }
+}
+
+void
+FileSink::flushIdle(const Clock::time_point now)
+{
+    std::scoped_lock lock{_streamsGuard};
+    for (const auto& [id, stream] : _streams) {
+        std::scoped_lock streamLock{stream->guard};
+        if (stream->buffer and stream->filled > 0
+            and now - stream->filledSince >= _config.flushInterval) {
+            enqueue(stream);
+        }
+    }
+}
+
+bool
+FileSink::dequeue(Request& request)
+{
+    std::scoped_lock lock{_queueGuard};
+    if (_queue.empty()) {
+        return false;
+    }
+    request = std::move(_queue.front());
+    _queue.pop_front();
+    return true;
+}
+
+bool
+FileSink::idle()
+{
+    std::scoped_lock lock{_queueGuard};
+    return _queue.empty() and _closed.empty() and _closing.empty() and _inflight.load() == 0;
+}
+
+void
+FileSink::prepare(Request& request, const Clock::time_point now)
+{
+    Stream& stream = *request.stream;
+
+    const uint64_t end = request.offset + request.size;
+    if (_config.preallocateSize > 0 and end > stream.allocated) {
+        const uint64_t length = std::max<uint64_t>(_config.preallocateSize, end - stream.allocated);
+        if (fallocate(stream.fd,
+                      FALLOC_FL_KEEP_SIZE,
+                      static_cast<off_t>(stream.allocated),
+                      static_cast<off_t>(length))
+            == 0) {
+            stream.allocated += length;
+        } else {
+            /* Not supported by file system (or out of space), don't try anymore */
+            LOGD("Unable to preallocate <{}> file: {}", stream.path, strerror(errno));
+            stream.allocated = std::numeric_limits<uint64_t>::max();
+        }
+    }
+
+    if (now - stream.lastSync >= _config.syncInterval) {
+        request.sync = true;
+        stream.lastSync = now;
+    }
+}
+
+bool
+FileSink::submitUring(Request& request)
+{
+    io_uring_sqe* sqe = _ring.acquire();
+    if (not sqe) {
+        return false;
+    }
+    io_uring_sqe* syncSqe = request.sync ? _ring.acquire() : nullptr;
+    if (request.sync and not syncSqe) {
+        /* No room for linked sync, the next write of stream makes it up */
+        request.sync = false;
+        request.stream->lastSync = {};
+    }
+
+    const unsigned slot = _freeSlots.back();
+    _freeSlots.pop_back();
+    const Request& queued = _slots[slot] = std::move(request);
+
+    sqe->opcode = _fixedBuffers ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+    sqe->fd = queued.stream->fd;
+    sqe->addr = reinterpret_cast<uint64_t>(_buffers[queued.buffer].get() + queued.written);
+    sqe->len = queued.size - queued.written;
+    sqe->off = queued.offset + queued.written;
+    sqe->buf_index = _fixedBuffers ? static_cast<uint16_t>(queued.buffer) : 0;
+    sqe->user_data = slot;
+    if (syncSqe) {
+        /* The sync starts only after the write completes successfully */
+        sqe->flags |= IOSQE_IO_LINK;
+        syncSqe->opcode = IORING_OP_FSYNC;
+        syncSqe->fd = queued.stream->fd;
+        syncSqe->fsync_flags = IORING_FSYNC_DATASYNC;
+        syncSqe->user_data = kSyncTag;
+    }
+    _inflight.fetch_add(1);
+    return true;
+}
+
+void
+FileSink::submitPool(Request request)
+{
+    _inflight.fetch_add(1);
+    asio::post(*_pool, [this, request = std::move(request)] {
+        const int fd = request.stream->fd;
+        const uint8_t* data = _buffers[request.buffer].get() + request.written;
+        const int64_t result = writeAll(
+            fd, data, request.size - request.written, request.offset + request.written);
+        if (result >= 0 and request.sync and fdatasync(fd) == -1) {
+            LOGW_LIMITED("Unable to sync <{}> file: {}", request.stream->path, strerror(errno));
+        }
+        complete(request, (result >= 0) ? request.written + result : result);
+        _inflight.fetch_sub(1);
+        wakeUp();
+    });
+}
+
+void
+FileSink::complete(const Request& request, const int64_t result)
+{
+    Stream& stream = *request.stream;
+    if (result == request.size) {
+        stream.bytes.fetch_add(request.size, std::memory_order_relaxed);
+        stream.writes.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        stream.errors.fetch_add(1, std::memory_order_relaxed);
+        LOGE_LIMITED("Unable to write <{}> file: {}",
+                     stream.path,
+                     (result < 0) ? strerror(static_cast<int>(-result)) : "short write");
+    }
+
+    const auto latency = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now()
+                                                                               - request.queued);
+    const auto us = static_cast<uint32_t>(latency.count());
+    {
+        std::scoped_lock lock{stream.statsGuard};
+        if (stream.latencies.size() < kLatencySamples) {
+            stream.latencies.push_back(us);
+        } else {
+            stream.latencies[stream.latencyIndex] = us;
+        }
+        stream.latencyIndex = (stream.latencyIndex + 1) % kLatencySamples;
+        stream.latencyMax = std::max(stream.latencyMax, us);
+    }
+
+    releaseBuffer(request.buffer);
+    stream.queueDepth.fetch_sub(1, std::memory_order_release);
+}
+
+void
+FileSink::finalizeClosed()
+{
+    {
+        std::scoped_lock lock{_queueGuard};
+        std::move(_closed.begin(), _closed.end(), std::back_inserter(_closing));
+        _closed.clear();
+    }
+    std::erase_if(_closing, [this](const std::shared_ptr<Stream>& stream) {
+        if (stream->queueDepth.load(std::memory_order_acquire) > 0) {
+            return false;
+        }
+        finalize(*stream);
+        return true;
+    });
+}
+
+void
+FileSink::finalize(Stream& stream)
+{
+    uint64_t size{};
+    {
+        std::scoped_lock lock{stream.guard};
+        size = stream.offset;
+    }
+
+    if (fdatasync(stream.fd) == -1) {
+        LOGW("Unable to sync <{}> file: {}", stream.path, strerror(errno));
+    }
+    /* Release the preallocated space beyond the data */
+    if (stream.allocated > size and stream.allocated != std::numeric_limits<uint64_t>::max()) {
+        if (ftruncate(stream.fd, static_cast<off_t>(size)) == -1) {
+            LOGW("Unable to truncate <{}> file: {}", stream.path, strerror(errno));
+        }
+    }
+    ::close(stream.fd);
+    stream.fd = -1;
+
+    LOGI("File <{}> is closed: bytes<{}>, writes<{}>, dropped<{}>, errors<{}>, max queue<{}>, "
+         "max latency<{}us>",
+         stream.path,
+         stream.bytes.load(),
+         stream.writes.load(),
+         stream.dropped.load(),
+         stream.errors.load(),
+         stream.maxQueueDepth.load(),
+         stream.latencyMax);
+}
+
+void
+FileSink::armEvent()
+{
+    if (_eventArmed) {
+        return;
+    }
+    if (io_uring_sqe* sqe = _ring.acquire(); sqe) {
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = _event;
+        sqe->addr = reinterpret_cast<uint64_t>(&_eventValue);
+        sqe->len = sizeof(_eventValue);
+        sqe->user_data = kEventTag;
+        _eventArmed = true;
+    }
+}
+
+void
+FileSink::armTick()
+{
+    if (_tickArmed) {
+        return;
+    }
+    if (io_uring_sqe* sqe = _ring.acquire(); sqe) {
+        /* Pure timeout (not waiting for completions count) flushing idle buffers */
+        sqe->opcode = IORING_OP_TIMEOUT;
+        sqe->addr = reinterpret_cast<uint64_t>(&_tick);
+        sqe->len = 1;
+        sqe->user_data = kTickTag;
+        _tickArmed = true;
+    }
+}
+
+void
+FileSink::handleCompletion(const io_uring_cqe& cqe)
+{
+    switch (cqe.user_data) {
+    case kEventTag:
+        _eventArmed = false;
+        return;
+    case kTickTag:
+        _tickArmed = false;
+        return;
+    case kSyncTag:
+        /* The sync is cancelled if linked write fails (the write reports the error) */
+        if (cqe.res < 0 and cqe.res != -ECANCELED) {
+            LOGW_LIMITED("Unable to sync sink file: {}", strerror(-cqe.res));
+        }
+        return;
+    default:
+        break;
+    }
+
+    const auto slot = static_cast<unsigned>(cqe.user_data);
+    Request request = std::move(_slots[slot]);
+    _slots[slot] = Request{};
+    _freeSlots.push_back(slot);
+    if (cqe.res > 0 and request.written + cqe.res < request.size) {
+        /* Short write, the rest of buffer is written at the following offset (as by pool) */
+        request.written += static_cast<uint32_t>(cqe.res);
+        {
+            std::scoped_lock lock{_queueGuard};
+            _queue.push_front(std::move(request));
+        }
+        _inflight.fetch_sub(1);
+        return;
+    }
+    complete(request, (cqe.res > 0) ? request.written + cqe.res : cqe.res);
+    _inflight.fetch_sub(1);
+}
+
+} // namespace jar
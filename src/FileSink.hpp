@@ -0,0 +1,236 @@
+#pragma once
+
+#include "IoUring.hpp"
+
+#include <boost/asio/thread_pool.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace jar {
+
+struct FileSinkConfig {
+    /* Write via io_uring (the writer threads are used if it's disabled or not available) */
+    bool ioUring{true};
+    /* The size of each staging buffer (registered with io_uring) */
+    std::size_t bufferSize{std::size_t{256} * 1024};
+    /* The number of staging buffers shared by all streams */
+    unsigned bufferCount{64};
+    /* The maximum number of writes in flight (for all streams) */
+    unsigned queueDepth{32};
+    /* The interval of fdatasync linked after write of each stream */
+    std::chrono::milliseconds syncInterval{1000};
+    /* The maximum time data stays in partially filled staging buffer */
+    std::chrono::milliseconds flushInterval{100};
+    /* The size of chunks preallocated ahead of the write offset */
+    std::size_t preallocateSize{std::size_t{64} * 1024 * 1024};
+    /* The number of fallback writer threads */
+    unsigned threads{2};
+};
+
+struct FileSinkStreamStats {
+    std::filesystem::path path;
+    uint64_t bytes{};
+    uint64_t writes{};
+    uint64_t dropped{};
+    uint64_t errors{};
+    /* The number of writes queued or in flight (current and maximum) */
+    unsigned queueDepth{};
+    unsigned maxQueueDepth{};
+    /* The write latency from queueing to completion (over the recent writes) */
+    std::chrono::microseconds latencyP50{};
+    std::chrono::microseconds latencyP99{};
+    std::chrono::microseconds latencyMax{};
+};
+
+/*
+ * Appends data of many output files (streams) from one submission thread. Producers only copy
+ * data into staging buffers shared by all streams and never wait for I/O (the data is dropped
+ * if no buffer is available). Full buffers (or partially filled ones after flush interval)
+ * are written by io_uring using registered buffers, submitted in batches, with fdatasync linked
+ * after write every sync interval. Files are preallocated in chunks ahead of the write offset.
+ * If io_uring isn't available, the buffers are written by pwrite on pool of writer threads.
+ */
+class FileSink {
+public:
+    using StreamId = uint32_t;
+
+    explicit FileSink(FileSinkConfig config);
+
+    ~FileSink();
+
+    [[nodiscard]] bool
+    start();
+
+    /* Close all streams and wait until all data is written */
+    void
+    stop();
+
+    [[nodiscard]] bool
+    usingIoUring() const;
+
+    /* Create (truncate) file and start new stream into it */
+    [[nodiscard]] std::optional<StreamId>
+    open(const std::filesystem::path& path);
+
+    /* Finish stream, the file is synced and closed after all its data is written */
+    void
+    close(StreamId id);
+
+    /* Append data to stream (any thread, writes of one stream must not be concurrent) */
+    [[nodiscard]] bool
+    write(StreamId id, const uint8_t* data, std::size_t size);
+
+    [[nodiscard]] std::vector<FileSinkStreamStats>
+    stats() const;
+
+    [[nodiscard]] std::string
+    report() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Stream {
+        std::filesystem::path path;
+        int fd{-1};
+        /* The producer side (guarded) */
+        std::mutex guard;
+        std::optional<unsigned> buffer;
+        std::size_t filled{};
+        Clock::time_point filledSince;
+        uint64_t offset{};
+        bool closed{false};
+        /* The submission thread side */
+        uint64_t allocated{};
+        Clock::time_point lastSync;
+        /* The statistics */
+        std::atomic<uint64_t> bytes{};
+        std::atomic<uint64_t> writes{};
+        std::atomic<uint64_t> dropped{};
+        std::atomic<uint64_t> errors{};
+        std::atomic<unsigned> queueDepth{};
+        std::atomic<unsigned> maxQueueDepth{};
+        mutable std::mutex statsGuard;
+        std::vector<uint32_t> latencies;
+        std::size_t latencyIndex{};
+        uint32_t latencyMax{};
+    };
+
+    struct Request {
+        std::shared_ptr<Stream> stream;
+        unsigned buffer{};
+        uint32_t size{};
+        uint64_t offset{};
+        /* The bytes already written by previous (short) writes */
+        uint32_t written{};
+        Clock::time_point queued;
+        /* Sync file data after this write */
+        bool sync{false};
+    };
+
+    struct AlignedDeleter {
+        void
+        operator()(uint8_t* ptr) const;
+    };
+
+    using AlignedBuffer = std::unique_ptr<uint8_t, AlignedDeleter>;
+
+    [[nodiscard]] std::shared_ptr<Stream>
+    findStream(StreamId id) const;
+
+    [[nodiscard]] bool
+    acquireBuffers(std::size_t count, std::vector<unsigned>& buffers);
+
+    void
+    releaseBuffer(unsigned buffer);
+
+    /* Queue filled part of stream current buffer (the stream guard must be locked) */
+    void
+    enqueue(const std::shared_ptr<Stream>& stream);
+
+    void
+    wakeUp();
+
+    void
+    handleSubmission(const std::stop_token& token);
+
+    void
+    flushIdle(Clock::time_point now);
+
+    [[nodiscard]] bool
+    dequeue(Request& request);
+
+    [[nodiscard]] bool
+    idle();
+
+    void
+    prepare(Request& request, Clock::time_point now);
+
+    [[nodiscard]] bool
+    submitUring(Request& request);
+
+    void
+    submitPool(Request request);
+
+    void
+    complete(const Request& request, int64_t result);
+
+    void
+    finalizeClosed();
+
+    void
+    finalize(Stream& stream);
+
+    void
+    armEvent();
+
+    void
+    armTick();
+
+    void
+    handleCompletion(const io_uring_cqe& cqe);
+
+private:
+    FileSinkConfig _config;
+    std::vector<AlignedBuffer> _buffers;
+    bool _fixedBuffers{false};
+    IoUring _ring;
+    std::unique_ptr<boost::asio::thread_pool> _pool;
+    int _event{-1};
+
+    /* Guards free staging buffers */
+    std::mutex _poolGuard;
+    std::vector<unsigned> _free;
+
+    /* Guards queued writes and closed streams */
+    std::mutex _queueGuard;
+    std::deque<Request> _queue;
+    std::vector<std::shared_ptr<Stream>> _closed;
+
+    mutable std::mutex _streamsGuard;
+    std::unordered_map<StreamId, std::shared_ptr<Stream>> _streams;
+    StreamId _nextId{1};
+
+    /* The submission thread state */
+    std::vector<std::shared_ptr<Stream>> _closing;
+    std::vector<Request> _slots;
+    std::vector<unsigned> _freeSlots;
+    uint64_t _eventValue{};
+    __kernel_timespec _tick{};
+    bool _eventArmed{false};
+    bool _tickArmed{false};
+    std::atomic<unsigned> _inflight{};
+    std::jthread _submitter;
+};
+
+} // namespace jar
@@ -0,0 +1,371 @@
+#include "FrameBus.hpp"
+
+#include "Logger.hpp"
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <memory>
+
+namespace jar {
+
+namespace {
+
+/* The reference count flag set while publisher writes into the slot */
+constexpr uint32_t kWriting = 0x80000000u;
+constexpr uint32_t kSlotBits = 8;
+constexpr uint64_t kSlotMask = (1u << kSlotBits) - 1;
+
+[[nodiscard]] std::size_t
+alignUp(const std::size_t size, const std::size_t alignment)
+{
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+[[nodiscard]] std::size_t
+pageSize()
+{
+    return static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+}
+
+[[nodiscard]] std::string
+objectName(const std::string& name)
+{
+    return (not name.empty() and name.front() == '/') ? name : "/" + name;
+}
+
+[[nodiscard]] uint32_t*
+futexWord(std::atomic<uint32_t>& value)
+{
+    return reinterpret_cast<uint32_t*>(&value);
+}
+
+} // namespace
+
+FrameBusPublisher::~FrameBusPublisher()
+{
+    close();
+}
+
+bool
+FrameBusPublisher::open(const std::string& name,
+                        const unsigned width,
+                        const unsigned height,
+                        const unsigned slotCount)
+{
+    close();
+
+    const uint32_t slots = std::clamp(slotCount, 2u, kFrameBusMaxSlots);
+    const std::size_t frameSize = std::size_t{width} * height * 3 / 2;
+    const std::size_t controlSize
+        = alignUp(sizeof(FrameBusHeader) + slots * sizeof(FrameBusSlot), pageSize());
+    const std::size_t slotStride = alignUp(frameSize, pageSize());
+
+    _name = objectName(name);
+    /* The object left by crashed process is replaced (attached readers keep the old one) */
+    shm_unlink(_name.c_str());
+    _fd = shm_open(_name.c_str(), O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0660);
+    if (_fd == -1) {
+        LOGE("Unable to create <{}> shared memory: {}", _name, strerror(errno));
+        return false;
+    }
+
+    _size = controlSize + slots * slotStride;
+    if (ftruncate(_fd, static_cast<off_t>(_size)) == -1) {
+        LOGE("Unable to resize <{}> shared memory: {}", _name, strerror(errno));
+        close();
+        return false;
+    }
+    _memory = mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+    if (_memory == MAP_FAILED) {
+        _memory = nullptr;
+        LOGE("Unable to map <{}> shared memory: {}", _name, strerror(errno));
+        close();
+        return false;
+    }
+
+    auto* const base = static_cast<uint8_t*>(_memory);
+    _header = std::construct_at(reinterpret_cast<FrameBusHeader*>(base));
+    _slots = reinterpret_cast<FrameBusSlot*>(base + sizeof(FrameBusHeader));
+    for (uint32_t n = 0; n < slots; ++n) {
+        std::construct_at(_slots + n);
+    }
+    _data = base + controlSize;
+
+    _header->version = kFrameBusVersion;
+    _header->slotCount = slots;
+    _header->width = width;
+    _header->height = height;
+    _header->frameSize = frameSize;
+    _header->slotStride = slotStride;
+    _header->dataOffset = controlSize;
+    /* The magic is written last, readers check it before anything else */
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(_header->magic, kFrameBusMagic, sizeof(kFrameBusMagic));
+
+    _frame = 0;
+    _nextSlot = 0;
+    LOGI("Frame bus <{}> is open: slots<{}>, size<{}>", _name, slots, _size);
+    return true;
+}
+
+void
+FrameBusPublisher::close()
+{
+    if (_memory) {
+        LOGI("Frame bus <{}> is closed: frames<{}>, dropped<{}>",
+             _name,
+             _frame,
+             _header->dropped.load(std::memory_order_relaxed));
+        munmap(_memory, _size);
+        _memory = nullptr;
+        _header = nullptr;
+        _slots = nullptr;
+        _data = nullptr;
+    }
+    if (_fd != -1) {
+        ::close(_fd);
+        _fd = -1;
+        shm_unlink(_name.c_str());
+    }
+}
+
+void
+FrameBusPublisher::publish(const unsigned sequence,
+                           const int64_t timestamp,
+                           const void* data,
+                           const std::size_t size)
+{
+    if (not _header) {
+        return;
+    }
+
+    /* The slot of the latest frame is skipped, readers are about to pin it */
+    const uint64_t latest = _header->latest.load(std::memory_order_relaxed);
+    const uint64_t latestSlot = (latest != 0) ? (latest & kSlotMask) : kSlotMask + 1;
+    const uint32_t slotCount = _header->slotCount;
+    std::optional<uint32_t> index;
+    for (uint32_t n = 0; n < slotCount and not index; ++n) {
+        const uint32_t candidate = (_nextSlot + n) % slotCount;
+        uint32_t unpinned{0};
+        if (candidate != latestSlot
+            and _slots[candidate].refs.compare_exchange_strong(
+                unpinned, kWriting, std::memory_order_acquire, std::memory_order_relaxed)) {
+            index = candidate;
+        }
+    }
+    if (not index) {
+        _header->dropped.fetch_add(1, std::memory_order_relaxed);
+        LOGW_LIMITED("All frame bus slots are pinned by readers, drop <{}> frame", sequence);
+        return;
+    }
+
+    FrameBusSlot& slot = _slots[*index];
+    slot.frame.store(0, std::memory_order_relaxed);
+    slot.size = std::min<std::size_t>(size, _header->frameSize);
+    std::memcpy(_data + *index * _header->slotStride, data, slot.size);
+    slot.sequence = sequence;
+    slot.timestamp = timestamp;
+    slot.frame.store(++_frame, std::memory_order_relaxed);
+    slot.refs.store(0, std::memory_order_release);
+
+    _header->latest.store(_frame << kSlotBits | *index, std::memory_order_release);
+    _header->notify.fetch_add(1);
+    if (_header->waiters.load() > 0) {
+        syscall(SYS_futex, futexWord(_header->notify), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+    }
+    _nextSlot = (*index + 1) % slotCount;
+}
+
+FrameBusReader::~FrameBusReader()
+{
+    close();
+}
+
+bool
+FrameBusReader::open(const std::string& name)
+{
+    close();
+
+    const std::string object = objectName(name);
+    _fd = shm_open(object.c_str(), O_RDWR | O_CLOEXEC, 0);
+    if (_fd == -1) {
+        LOGE("Unable to open <{}> shared memory: {}", object, strerror(errno));
+        return false;
+    }
+
+    /* Read the layout before mapping (the atomics of the copy are not used) */
+    alignas(FrameBusHeader) uint8_t storage[sizeof(FrameBusHeader)];
+    struct stat st{};
+    if (pread(_fd, storage, sizeof(storage), 0) != sizeof(storage) or fstat(_fd, &st) == -1) {
+        LOGE("Unable to read <{}> frame bus", object);
+        close();
+        return false;
+    }
+    const auto* header = reinterpret_cast<const FrameBusHeader*>(storage);
+    if (std::memcmp(header->magic, kFrameBusMagic, sizeof(kFrameBusMagic)) != 0
+        or header->version != kFrameBusVersion or header->slotCount > kFrameBusMaxSlots
+        or header->dataOffset + header->slotCount * header->slotStride
+               > static_cast<uint64_t>(st.st_size)) {
+        LOGE("Shared memory <{}> is not a frame bus", object);
+        close();
+        return false;
+    }
+
+    _controlSize = header->dataOffset;
+    _dataSize = header->slotCount * header->slotStride;
+    _control = mmap(nullptr, _controlSize, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+    if (_control == MAP_FAILED) {
+        _control = nullptr;
+        LOGE("Unable to map <{}> frame bus control: {}", object, strerror(errno));
+        close();
+        return false;
+    }
+    /* The frames are never written by readers */
+    void* data = mmap(
+        nullptr, _dataSize, PROT_READ, MAP_SHARED, _fd, static_cast<off_t>(_controlSize));
+    if (data == MAP_FAILED) {
+        LOGE("Unable to map <{}> frame bus data: {}", object, strerror(errno));
+        close();
+        return false;
+    }
+    _data = data;
+
+    _header = static_cast<FrameBusHeader*>(_control);
+    _slots = reinterpret_cast<FrameBusSlot*>(static_cast<uint8_t*>(_control)
+                                             + sizeof(FrameBusHeader));
+    _last.reset();
+    _missed = 0;
+    return true;
+}
+
+void
+FrameBusReader::close()
+{
+    if (_data) {
+        munmap(const_cast<void*>(_data), _dataSize);
+        _data = nullptr;
+    }
+    if (_control) {
+        munmap(_control, _controlSize);
+        _control = nullptr;
+    }
+    _header = nullptr;
+    _slots = nullptr;
+    if (_fd != -1) {
+        ::close(_fd);
+        _fd = -1;
+    }
+}
+
+unsigned
+FrameBusReader::width() const
+{
+    return _header ? _header->width : 0;
+}
+
+unsigned
+FrameBusReader::height() const
+{
+    return _header ? _header->height : 0;
+}
+
+std::optional<FrameBusFrame>
+FrameBusReader::acquire(const std::chrono::milliseconds timeout)
+{
+    if (not _header) {
+        return std::nullopt;
+    }
+
+    using Clock = std::chrono::steady_clock;
+    const auto deadline = Clock::now() + timeout;
+    while (true) {
+        const uint32_t notify = _header->notify.load();
+        const uint64_t latest = _header->latest.load(std::memory_order_acquire);
+        if (latest != 0 and (not _last or (latest >> kSlotBits) > *_last)) {
+            if (auto frame = tryAcquire(latest); frame) {
+                if (_last) {
+                    _missed += frame->frame - *_last - 1;
+                }
+                _last = frame->frame;
+                return frame;
+            }
+            /* The slot was reused meanwhile, there is newer frame */
+            continue;
+        }
+
+        const auto remaining = deadline - Clock::now();
+        if (remaining <= Clock::duration::zero()) {
+            return std::nullopt;
+        }
+        const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(remaining).count();
+        const timespec ts{.tv_sec = ns / 1000000000, .tv_nsec = ns % 1000000000};
+        /* Returns immediately if anything was published since the notify word was read */
+        _header->waiters.fetch_add(1);
+        syscall(SYS_futex, futexWord(_header->notify), FUTEX_WAIT, notify, &ts, nullptr, 0);
+        _header->waiters.fetch_sub(1);
+    }
+}
+
+void
+FrameBusReader::release(const FrameBusFrame& frame)
+{
+    if (_slots and frame.slot < _header->slotCount) {
+        _slots[frame.slot].refs.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+uint64_t
+FrameBusReader::missed() const
+{
+    return _missed;
+}
+
+uint64_t
+FrameBusReader::dropped() const
+{
+    return _header ? _header->dropped.load(std::memory_order_relaxed) : 0;
+}
+
+std::optional<FrameBusFrame>
+FrameBusReader::tryAcquire(const uint64_t latest)
+{
+    const uint64_t number = latest >> kSlotBits;
+    const auto index = static_cast<uint32_t>(latest & kSlotMask);
+    if (index >= _header->slotCount) {
+        return std::nullopt;
+    }
+
+    FrameBusSlot& slot = _slots[index];
+    uint32_t refs = slot.refs.load(std::memory_order_relaxed);
+    do {
+        if (refs & kWriting) {
+            return std::nullopt;
+        }
+    }
+    while (not slot.refs.compare_exchange_weak(
+        refs, refs + 1, std::memory_order_acquire, std::memory_order_relaxed));
+
+    /* The slot may have been rewritten before it was pinned */
+    if (slot.frame.load(std::memory_order_relaxed) != number) {
+        slot.refs.fetch_sub(1, std::memory_order_release);
+        return std::nullopt;
+    }
+    return FrameBusFrame{
+        .frame = number,
+        .sequence = slot.sequence,
+        .timestamp = slot.timestamp,
+        .data = static_cast<const uint8_t*>(_data) + index * _header->slotStride,
+        .size = slot.size,
+        .slot = index,
+    };
+}
+
+} // namespace jar
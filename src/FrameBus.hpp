@@ -0,0 +1,159 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+namespace jar {
+
+/*
+ * Shared memory layout of frame bus (POSIX shared memory object "/<name>"):
+ *   [control: header, slots metadata][padding to page][data: slot 0 frame][slot 1 frame]...
+ * The control part is mapped read-write by everyone (reference counts), the data part is mapped
+ * read-only by readers. Readers pin the latest frame slot by incrementing its reference count,
+ * the publisher writes only into unreferenced slots and drops the frame when there are none.
+ * So slow (or crashed) readers never block capture, they only see fewer frames.
+ */
+
+inline constexpr char kFrameBusMagic[8] = {'R', 'A', 'W', 'F', 'B', 'U', 'S', '1'};
+inline constexpr uint32_t kFrameBusVersion = 1;
+inline constexpr uint32_t kFrameBusMaxSlots = 64;
+
+struct FrameBusHeader {
+    char magic[8]{};
+    uint32_t version{};
+    uint32_t slotCount{};
+    uint32_t width{};
+    uint32_t height{};
+    uint64_t frameSize{};
+    uint64_t slotStride{};
+    uint64_t dataOffset{};
+    /* The latest published frame: frame number << 8 | slot index (zero if none) */
+    std::atomic<uint64_t> latest{};
+    /* The futex word incremented on each publishing */
+    std::atomic<uint32_t> notify{};
+    /* The number of readers waiting on futex (publisher skips wake-up syscall if none) */
+    std::atomic<uint32_t> waiters{};
+    /* The number of frames dropped by publisher because all slots were pinned */
+    std::atomic<uint64_t> dropped{};
+};
+
+struct FrameBusSlot {
+    /* The number of frame stored in slot (zero if none) */
+    std::atomic<uint64_t> frame{};
+    /* The number of readers pinning the slot (or kWriting flag while publisher writes) */
+    std::atomic<uint32_t> refs{};
+    /* The V4L2 sequence number of frame */
+    uint32_t sequence{};
+    /* The V4L2 buffer timestamp (microseconds) */
+    int64_t timestamp{};
+    uint64_t size{};
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free);
+static_assert(std::atomic<uint32_t>::is_always_lock_free);
+
+/* Publishes captured frames into shared memory (single publisher) */
+class FrameBusPublisher {
+public:
+    FrameBusPublisher() = default;
+
+    ~FrameBusPublisher();
+
+    FrameBusPublisher(const FrameBusPublisher&) = delete;
+    FrameBusPublisher&
+    operator=(const FrameBusPublisher&)
+        = delete;
+
+    [[nodiscard]] bool
+    open(const std::string& name, unsigned width, unsigned height, unsigned slotCount);
+
+    void
+    close();
+
+    /* Copy frame into free slot and wake up readers (never blocks) */
+    void
+    publish(unsigned sequence, int64_t timestamp, const void* data, std::size_t size);
+
+private:
+    std::string _name;
+    int _fd{-1};
+    void* _memory{};
+    std::size_t _size{};
+    FrameBusHeader* _header{};
+    FrameBusSlot* _slots{};
+    uint8_t* _data{};
+    uint64_t _frame{};
+    uint32_t _nextSlot{};
+};
+
+/* The frame pinned by reader (valid until released) */
+struct FrameBusFrame {
+    /* The number of frame assigned by publisher */
+    uint64_t frame{};
+    uint32_t sequence{};
+    int64_t timestamp{};
+    const uint8_t* data{};
+    std::size_t size{};
+    uint32_t slot{};
+};
+
+/* Reads the latest frames from shared memory published by another process */
+class FrameBusReader {
+public:
+    FrameBusReader() = default;
+
+    ~FrameBusReader();
+
+    FrameBusReader(const FrameBusReader&) = delete;
+    FrameBusReader&
+    operator=(const FrameBusReader&)
+        = delete;
+
+    [[nodiscard]] bool
+    open(const std::string& name);
+
+    void
+    close();
+
+    [[nodiscard]] unsigned
+    width() const;
+
+    [[nodiscard]] unsigned
+    height() const;
+
+    /* Pin the latest frame newer than the previous one, waits up to given timeout for it */
+    [[nodiscard]] std::optional<FrameBusFrame>
+    acquire(std::chrono::milliseconds timeout);
+
+    /* Unpin the frame (must be called for each acquired frame) */
+    void
+    release(const FrameBusFrame& frame);
+
+    /* Get the number of frames published since the first acquired one but never acquired */
+    [[nodiscard]] uint64_t
+    missed() const;
+
+    /* Get the number of frames dropped by publisher due to pinned slots */
+    [[nodiscard]] uint64_t
+    dropped() const;
+
+private:
+    [[nodiscard]] std::optional<FrameBusFrame>
+    tryAcquire(uint64_t latest);
+
+private:
+    int _fd{-1};
+    void* _control{};
+    std::size_t _controlSize{};
+    const void* _data{};
+    std::size_t _dataSize{};
+    FrameBusHeader* _header{};
+    FrameBusSlot* _slots{};
+    std::optional<uint64_t> _last;
+    uint64_t _missed{};
+};
+
+} // namespace jar
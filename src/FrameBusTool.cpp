@@ -0,0 +1,130 @@
+#include <boost/program_options.hpp>
+
+#include "FrameBus.hpp"
+
+#include <chrono>
+#include <csignal>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <thread>
+
+namespace po = boost::program_options;
+
+/* General defaults */
+static const char* kDefaultName{"rawenc"};
+static unsigned kDefaultInterval = 1;
+
+/* The timeout of waiting for the next frame */
+static constexpr std::chrono::milliseconds kAcquireTimeout{100};
+
+static std::atomic_bool gTerminated{false};
+
+namespace jar {
+
+/*
+ * Reads frames published by rawenc into shared memory frame bus, reports the frame rate and
+ * the frames missed by this reader, optionally stores frames into raw YUV420 file.
+ */
+class FrameBusTool {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    [[nodiscard]] bool
+    parseArgs(const int argc, char* argv[])
+    {
+        po::options_description d{"RawEnc frame bus reader CLI"};
+        // clang-format off
+        d.add_options()
+            ("help,h", "Display help")
+            ("name", po::value<std::string>()->notifier([this](const std::string& v) {
+                _name = v;
+            })->default_value(kDefaultName), "Set frame bus name")
+            ("output", po::value<std::string>()->notifier([this](const std::string& v) {
+                _output.open(v, std::ios::binary);
+            }), "Write frames to raw YUV420 file")
+            ("duration", po::value<unsigned>()->notifier([this](const unsigned v) {
+                _duration = std::chrono::seconds{v};
+            }), "Stop after given duration (sec)")
+            ("interval", po::value<unsigned>()->notifier([this](const unsigned v) {
+                _interval = std::chrono::seconds{std::max(1u, v)};
+            })->default_value(kDefaultInterval), "Set report interval (sec)")
+            ("hold", po::value<unsigned>()->notifier([this](const unsigned v) {
+                _hold = std::chrono::milliseconds{v};
+            }), "Hold each frame for given time (ms) to simulate slow processing")
+        ;
+        // clang-format on
+
+        po::variables_map vm;
+        po::store(po::parse_command_line(argc, argv, d), vm);
+        if (vm.contains("help")) {
+            std::cout << d << std::endl;
+            return false;
+        }
+        po::notify(vm);
+        return true;
+    }
+
+    [[nodiscard]] bool
+    run()
+    {
+        FrameBusReader reader;
+        if (not reader.open(_name)) {
+            return false;
+        }
+        std::cout << "Attached to <" << _name << "> frame bus: " << reader.width() << "x"
+                  << reader.height() << '\n';
+
+        uint64_t frames{}, total{};
+        const auto start = Clock::now();
+        auto reportTime = start + _interval;
+        while (not gTerminated and (not _duration or Clock::now() - start < *_duration)) {
+            if (const auto frame = reader.acquire(kAcquireTimeout); frame) {
+                if (_output.is_open()) {
+                    _output.write(reinterpret_cast<const char*>(frame->data),
+                                  static_cast<std::streamsize>(frame->size));
+                }
+                if (_hold.count() > 0) {
+                    std::this_thread::sleep_for(_hold);
+                }
+                reader.release(*frame);
+                ++frames, ++total;
+            }
+
+            if (const auto now = Clock::now(); now >= reportTime) {
+                const std::chrono::duration<double> elapsed = now - reportTime + _interval;
+                std::cout << "fps<" << frames / elapsed.count() << ">, missed<" << reader.missed()
+                          << ">, dropped<" << reader.dropped() << ">\n";
+                frames = 0;
+                reportTime = now + _interval;
+            }
+        }
+
+        std::cout << "Total: frames<" << total << ">, missed<" << reader.missed()
+                  << ">, dropped<" << reader.dropped() << ">\n";
+        return total > 0;
+    }
+
+private:
+    std::string _name{kDefaultName};
+    std::ofstream _output;
+    std::optional<std::chrono::seconds> _duration;
+    std::chrono::seconds _interval{kDefaultInterval};
+    std::chrono::milliseconds _hold{};
+};
+
+} // namespace jar
+
+int
+main(int argc, char* argv[])
+{
+    jar::FrameBusTool app;
+    if (not app.parseArgs(argc, argv)) {
+        /* Show help menu and exit */
+        return EXIT_SUCCESS;
+    }
+
+    std::signal(SIGINT, [](int) { gTerminated = true; });
+    std::signal(SIGTERM, [](int) { gTerminated = true; });
+    return app.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
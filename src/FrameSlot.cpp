@@ -0,0 +1,66 @@
+#include "FrameSlot.hpp"
+
+#include "Logger.hpp"
+
+#include <cstring>
+
+namespace jar {
+
+FrameSlot::FrameSlot(const std::size_t capacity)
+{
+    for (auto& frame : _frames) {
+        frame.data.resize(capacity);
+    }
+}
+
+void
+FrameSlot::publish(const CapturedFrame& frame)
+{
+    if (not _requested.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    Frame& back = _frames[_back];
+    if (frame.size > back.data.size()) {
+        LOGW_LIMITED("Frame <{}> exceeds slot capacity: {} > {}",
+                     frame.sequence,
+                     frame.size,
+                     back.data.size());
+        return;
+    }
+
+    std::memcpy(back.data.data(), frame.data, frame.size);
+    back.size = frame.size;
+    back.sequence = frame.sequence;
+
+    const uint8_t prev = _middle.exchange(_back | kFreshBit, std::memory_order_acq_rel);
+    _back = prev & kIndexMask;
+
+    _requested.store(false, std::memory_order_release);
+    {
+        /* The reader is either before waiting or already waiting, so the wakeup isn't lost */
+        std::scoped_lock lock{_guard};
+    }
+    _whenPublished.notify_one();
+}
+
+const FrameSlot::Frame*
+FrameSlot::acquire(const std::chrono::milliseconds timeout)
+{
+    _requested.store(true, std::memory_order_relaxed);
+    {
+        std::unique_lock lock{_guard};
+        if (not _whenPublished.wait_for(lock, timeout, [this] {
+                return not _requested.load(std::memory_order_acquire);
+            })) {
+            _requested.store(false, std::memory_order_relaxed);
+            return nullptr;
+        }
+    }
+
+    const uint8_t prev = _middle.exchange(_front, std::memory_order_acq_rel);
+    _front = prev & kIndexMask;
+    return &_frames[_front];
+}
+
+} // namespace jar
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Camera.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace jar {
+
+/*
+ * On-demand "latest frame" slot (triple buffer) for single writer and single reader. The writer
+ * copies frame only when the reader has requested one (otherwise publishing is a single atomic
+ * load), fills the back buffer and swaps it with the middle one. The reader requests the next
+ * frame and waits until it's published. The writer never waits.
+ */
+class FrameSlot {
+public:
+    struct Frame {
+        unsigned sequence{};
+        std::vector<uint8_t> data;
+        unsigned size{};
+    };
+
+    explicit FrameSlot(std::size_t capacity);
+
+    /* Publish given frame if the reader requested one (writer side, e.g. capture thread) */
+    void
+    publish(const CapturedFrame& frame);
+
+    /* Request the next frame and wait until it's published, returns nullptr on timeout
+     * (reader side) */
+    [[nodiscard]] const Frame*
+    acquire(std::chrono::milliseconds timeout);
+
+private:
+    static constexpr uint8_t kIndexMask = 0x03;
+    static constexpr uint8_t kFreshBit = 0x04;
+
+    Frame _frames[3];
+    std::atomic<uint8_t> _middle{1};
+    uint8_t _back{0};
+    uint8_t _front{2};
+    std::atomic<bool> _requested{false};
+    std::mutex _guard;
+    std::condition_variable _whenPublished;
+};
+
+} // namespace jar
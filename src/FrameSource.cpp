@@ -0,0 +1,139 @@
+#include "FrameSource.hpp"
+
+#include "Logger.hpp"
+#include "SpoolReader.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+
+namespace jar {
+
+FrameSource::FrameSource(const unsigned width, const unsigned height)
+    : _width{width}
+    , _height{height}
+{
+}
+
+bool
+FrameSource::load(const std::filesystem::path& path, const std::size_t maxFrames)
+{
+    if (SpoolReader reader; reader.open(path)) {
+        return load(reader, maxFrames);
+    }
+
+    FILE* file = fopen(path.c_str(), "rb");
+    if (not file) {
+        LOGE("Unable to open <{}> file: {}", path, strerror(errno));
+        return false;
+    }
+
+    _frames.clear();
+    while (_frames.size() < maxFrames) {
+        std::vector<uint8_t> frame(frameSize());
+        if (fread(frame.data(), 1, frame.size(), file) != frame.size()) {
+            break;
+        }
+        _frames.push_back(std::move(frame));
+    }
+    fclose(file);
+
+    LOGD("Load <{}> frames from <{}> file", _frames.size(), path);
+    return not _frames.empty();
+}
+
+bool
+FrameSource::load(SpoolReader& reader, const std::size_t maxFrames)
+{
+    if (reader.width() != _width or reader.height() != _height) {
+        LOGE("Spool frame size <{}x{}> doesn't match <{}x{}>",
+             reader.width(),
+             reader.height(),
+             _width,
+             _height);
+        return false;
+    }
+
+    _frames.clear();
+    SpoolFrame frame;
+    for (uint64_t n = 0; n < reader.frameCount() and _frames.size() < maxFrames; ++n) {
+        if (not reader.read(n, frame) or frame.size != frameSize()) {
+            break;
+        }
+        _frames.emplace_back(frame.data, frame.data + frame.size);
+    }
+
+    LOGD("Load <{}> frames from spool file", _frames.size());
+    return not _frames.empty();
+}
+
+void
+FrameSource::generate(const std::size_t count)
+{
+    const unsigned w = _width, h = _height;
+    const unsigned box = std::max(16u, h / 4);
+
+    _frames.clear();
+    _frames.reserve(count);
+    uint32_t seed{0x12345678};
+    for (std::size_t n = 0; n < count; ++n) {
+        std::vector<uint8_t> frame(frameSize());
+        uint8_t* const luma = frame.data();
+        uint8_t* const cb = luma + w * h;
+        uint8_t* const cr = cb + w * h / 4;
+
+        /* Moving gradient background with a bouncing box and some sensor-like noise */
+        const unsigned boxX = (n * 7) % std::max(1u, w - box);
+        const unsigned boxY = (n * 5) % std::max(1u, h - box);
+        for (unsigned y = 0; y < h; ++y) {
+            for (unsigned x = 0; x < w; ++x) {
+                seed = seed * 1664525u + 1013904223u;
+                const bool inBox = (x >= boxX and x < boxX + box and y >= boxY and y < boxY + box);
+                const unsigned base = inBox ? 235 - (x - boxX) : (x + y + n * 3) & 0xFF;
+                luma[y * w + x] = static_cast<uint8_t>(std::min(255u, base + (seed >> 29)));
+            }
+        }
+        for (unsigned y = 0; y < h / 2; ++y) {
+            for (unsigned x = 0; x < w / 2; ++x) {
+                cb[y * w / 2 + x] = static_cast<uint8_t>(128 + ((x + n) & 0x3F) - 32);
+                cr[y * w / 2 + x] = static_cast<uint8_t>(128 + ((y + n) & 0x3F) - 32);
+            }
+        }
+        _frames.push_back(std::move(frame));
+    }
+
+    LOGD("Generate <{}> synthetic frames", _frames.size());
+}
+
+unsigned
+FrameSource::width() const
+{
+    return _width;
+}
+
+unsigned
+FrameSource::height() const
+{
+    return _height;
+}
+
+std::size_t
+FrameSource::frameSize() const
+{
+    return std::size_t{_width} * _height * 3 / 2;
+}
+
+std::size_t
+FrameSource::size() const
+{
+    return _frames.size();
+}
+
+const uint8_t*
+FrameSource::frame(const std::size_t index) const
+{
+    assert(not _frames.empty());
+    return _frames[index % _frames.size()].data();
+}
+
+} // namespace jar
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+namespace jar {
+
+class SpoolReader;
+
+/*
+ * In-memory set of raw YUV420 frames loaded from file (recorded) or generated (synthetic).
+ * Frames are served cyclically, so a short clip can feed arbitrary long run.
+ */
+class FrameSource {
+public:
+    FrameSource(unsigned width, unsigned height);
+
+    /* Load up to given number of frames from raw YUV420 or spool file */
+    [[nodiscard]] bool
+    load(const std::filesystem::path& path, std::size_t maxFrames);
+
+    /* Load up to given number of frames from opened spool file */
+    [[nodiscard]] bool
+    load(SpoolReader& reader, std::size_t maxFrames);
+
+    /* Generate given number of synthetic frames with moving content */
+    void
+    generate(std::size_t count);
+
+    [[nodiscard]] unsigned
+    width() const;
+
+    [[nodiscard]] unsigned
+    height() const;
+
+    [[nodiscard]] std::size_t
+    frameSize() const;
+
+    [[nodiscard]] std::size_t
+    size() const;
+
+    /* Get frame by index (wraps around) */
+    [[nodiscard]] const uint8_t*
+    frame(std::size_t index) const;
+
+private:
+    unsigned _width{};
+    unsigned _height{};
+    std::vector<std::vector<uint8_t>> _frames;
+};
+
+} // namespace jar
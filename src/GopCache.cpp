@@ -0,0 +1,130 @@
+#include "GopCache.hpp"
+
+#include "AnnexB.hpp"
+#include "Logger.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+namespace jar {
+
+namespace {
+
+constexpr uint8_t kStartCode[] = {0, 0, 0, 1};
+
+/* The index of parameter set in cache (VPS, SPS, PPS) or -1 if the NAL unit is not one */
+[[nodiscard]] int
+parameterSetIndex(const RtpCodec codec, const uint8_t* nal, const std::size_t size)
+{
+    if (codec == RtpCodec::H264) {
+        const uint8_t type = nal[0] & 0x1F;
+        return (type == kH264Sps) ? 1 : (type == kH264Pps) ? 2 : -1;
+    }
+    if (size < 2) {
+        return -1;
+    }
+    const uint8_t type = (nal[0] >> 1) & 0x3F;
+    return (type == kH265Vps) ? 0 : (type == kH265Sps) ? 1 : (type == kH265Pps) ? 2 : -1;
+}
+
+/* Whether the NAL unit is coded slice (parameter sets of access unit precede slices) */
+[[nodiscard]] bool
+isSlice(const RtpCodec codec, const uint8_t* nal)
+{
+    if (codec == RtpCodec::H264) {
+        const uint8_t type = nal[0] & 0x1F;
+        return (type >= 1 and type <= 5);
+    }
+    return ((nal[0] >> 1) & 0x3F) < 32;
+}
+
+} // namespace
+
+GopCache::GopCache(const RtpCodec codec, const std::size_t budget)
+    : _codec{codec}
+    , _budget{budget}
+{
+}
+
+void
+GopCache::add(const Packet& packet, const bool key)
+{
+    const bool hasParameters = parse(*packet);
+    if (_changed) {
+        std::vector<uint8_t> parameters;
+        for (const auto& parameterSet : _parameterSets) {
+            parameters.insert(parameters.end(), parameterSet.begin(), parameterSet.end());
+        }
+        _parameters = std::make_shared<const std::vector<uint8_t>>(std::move(parameters));
+        _changed = false;
+    }
+
+    if (key) {
+        _gop.clear();
+        _gop.push_back(packet);
+        _gopBytes = packet->size();
+        _gopComplete = true;
+        _keyHasParameters = hasParameters;
+    } else if (_gopComplete) {
+        _gop.push_back(packet);
+        _gopBytes += packet->size();
+    }
+
+    if (_gopComplete and _gopBytes > _budget) {
+        LOGW_LIMITED("GOP exceeds cache budget <{}>, late consumers wait for keyframe", _budget);
+        _gop.clear();
+        _gopBytes = 0;
+        _gopComplete = false;
+    }
+}
+
+GopCache::Packet
+GopCache::keyPrefix() const
+{
+    return _keyHasParameters ? nullptr : _parameters;
+}
+
+std::vector<GopCache::Packet>
+GopCache::prime() const
+{
+    std::vector<Packet> packets;
+    if (not _gopComplete) {
+        return packets;
+    }
+    if (auto prefix = keyPrefix(); prefix) {
+        packets.push_back(std::move(prefix));
+    }
+    packets.insert(packets.end(), _gop.begin(), _gop.end());
+    return packets;
+}
+
+std::size_t
+GopCache::bytes() const
+{
+    return _gopBytes + (_parameters ? _parameters->size() : 0);
+}
+
+bool
+GopCache::parse(const std::vector<uint8_t>& packet)
+{
+    bool found{false};
+    forEachNal(packet.data(), packet.size(), [&](const uint8_t* nal, const std::size_t size) {
+        if (isSlice(_codec, nal)) {
+            return false;
+        }
+        if (const int index = parameterSetIndex(_codec, nal, size); index >= 0) {
+            auto& parameterSet = _parameterSets[index];
+            if (parameterSet.size() != size + sizeof(kStartCode)
+                or not std::equal(nal, nal + size, parameterSet.begin() + sizeof(kStartCode))) {
+                parameterSet.assign(std::begin(kStartCode), std::end(kStartCode));
+                parameterSet.insert(parameterSet.end(), nal, nal + size);
+                _changed = true;
+            }
+            found = true;
+        }
+        return true;
+    });
+    return found;
+}
+
+} // namespace jar
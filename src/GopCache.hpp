@@ -0,0 +1,58 @@
+#pragma once
+
+#include "RtpFormat.hpp"
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace jar {
+
+/*
+ * Keeps the latest parameter sets (VPS/SPS/PPS) and the packets of current GOP (from the last
+ * keyframe) of Annex-B encoded stream, so late consumers may be primed with them and decode
+ * immediately instead of waiting for the next keyframe. The GOP exceeding the budget is
+ * dropped (consumers wait for the next keyframe then). Not thread-safe.
+ */
+class GopCache {
+public:
+    using Packet = std::shared_ptr<const std::vector<uint8_t>>;
+
+    GopCache(RtpCodec codec, std::size_t budget);
+
+    /* Add packet of encoded stream (keyframe starts new GOP) */
+    void
+    add(const Packet& packet, bool key);
+
+    /* Get parameter sets to send before the last keyframe (none if it carries them itself) */
+    [[nodiscard]] Packet
+    keyPrefix() const;
+
+    /* Get packets priming new consumer (empty if there is no complete GOP cached) */
+    [[nodiscard]] std::vector<Packet>
+    prime() const;
+
+    /* Get the size of cached packets */
+    [[nodiscard]] std::size_t
+    bytes() const;
+
+private:
+    /* Store parameter sets of packet, returns true if there were any */
+    bool
+    parse(const std::vector<uint8_t>& packet);
+
+private:
+    RtpCodec _codec;
+    std::size_t _budget;
+    /* The latest VPS, SPS and PPS with start codes */
+    std::array<std::vector<uint8_t>, 3> _parameterSets;
+    Packet _parameters;
+    bool _changed{false};
+    bool _keyHasParameters{false};
+    std::vector<Packet> _gop;
+    std::size_t _gopBytes{};
+    bool _gopComplete{false};
+};
+
+} // namespace jar
@@ -0,0 +1,290 @@
+#include "HugePageAllocator.hpp"
+
+#include "Logger.hpp"
+
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace jar {
+
+namespace {
+
+[[nodiscard]] std::size_t
+alignUp(const std::size_t size, const std::size_t alignment)
+{
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+/* Check whether the system has more than one NUMA node (binding is pointless otherwise) */
+[[nodiscard]] bool
+hasMultipleNumaNodes()
+{
+    std::ifstream file{"/sys/devices/system/node/online"};
+    std::string nodes;
+    return std::getline(file, nodes) and nodes.find_first_of("-,") != std::string::npos;
+}
+
+/*
+ * Get the bytes of given address ranges backed by transparent huge pages. The kernel may merge
+ * adjacent mappings into one area, its AnonHugePages are attributed in proportion to overlap.
+ */
+[[nodiscard]] uint64_t
+transparentBytes(const std::vector<std::pair<uintptr_t, uintptr_t>>& ranges)
+{
+    static constexpr std::string_view kAnonHugePages{"AnonHugePages:"};
+
+    std::ifstream file{"/proc/self/smaps"};
+    uint64_t bytes{};
+    uintptr_t begin{}, end{};
+    uint64_t overlap{};
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty()) {
+            continue;
+        }
+        if (line.starts_with(kAnonHugePages)) {
+            if (overlap > 0) {
+                const auto huge = std::strtoull(line.c_str() + kAnonHugePages.size(), nullptr, 10);
+                bytes += static_cast<uint64_t>(static_cast<double>(huge) * 1024.0
+                                               * static_cast<double>(overlap)
+                                               / static_cast<double>(end - begin));
+            }
+            continue;
+        }
+        /* The area header starts with lowercase hex address range (the fields are capitalized) */
+        if (not std::isxdigit(line[0]) or std::isupper(line[0])) {
+            continue;
+        }
+        overlap = 0;
+        const char* const last = line.data() + line.size();
+        const auto [dash, error] = std::from_chars(line.data(), last, begin, 16);
+        if (error != std::errc{} or dash == last or *dash != '-'
+            or std::from_chars(dash + 1, last, end, 16).ec != std::errc{} or end <= begin) {
+            continue;
+        }
+        for (const auto& [rangeBegin, rangeEnd] : ranges) {
+            if (const auto from = std::max(begin, rangeBegin), to = std::min(end, rangeEnd);
+                from < to) {
+                overlap += to - from;
+            }
+        }
+    }
+    return bytes;
+}
+
+} // namespace
+
+double
+HugePageStats::coverage() const
+{
+    const uint64_t total = hugetlb + advised + regular;
+    return total > 0 ? static_cast<double>(hugetlb + transparent) / static_cast<double>(total)
+                     : 0.0;
+}
+
+HugePageAllocator::HugePageAllocator(const bool hugePages, const std::optional<int> numaNode)
+    : _hugePages{hugePages}
+    , _numaNode{hasMultipleNumaNodes() ? numaNode : std::nullopt}
+{
+}
+
+HugePageAllocator::~HugePageAllocator()
+{
+    std::scoped_lock lock{_guard};
+    for (const auto& [data, mapping] : _mappings) {
+        munmap(data, mapping.size);
+    }
+}
+
+void*
+HugePageAllocator::allocate(const std::size_t size)
+{
+    if (size == 0) {
+        return nullptr;
+    }
+
+    Mapping mapping;
+    void* data{};
+    if (_hugePages and size >= kHugePageSize / 2) {
+        mapping.size = alignUp(size, kHugePageSize);
+        if (data = mapHugeTlb(mapping.size); data) {
+            mapping.backing = Backing::HugeTlb;
+        } else if (data = mapTransparent(mapping.size); data) {
+            mapping.backing = Backing::Transparent;
+        }
+    }
+    if (not data) {
+        mapping.size = alignUp(size, static_cast<std::size_t>(sysconf(_SC_PAGESIZE)));
+        mapping.backing = Backing::Regular;
+        if (data = mapRegular(mapping.size); not data) {
+            LOGE("Unable to allocate <{}> bytes: {}", size, strerror(errno));
+            return nullptr;
+        }
+    }
+    bind(data, mapping.size);
+
+    std::scoped_lock lock{_guard};
+    _mappings.emplace(data, mapping);
+    ++_stats.allocations;
+    switch (mapping.backing) {
+    case Backing::HugeTlb:
+        _stats.hugetlb += mapping.size;
+        break;
+    case Backing::Transparent:
+        _stats.advised += mapping.size;
+        break;
+    case Backing::Regular:
+        _stats.regular += mapping.size;
+        break;
+    }
+    return data;
+}
+
+void
+HugePageAllocator::deallocate(void* data)
+{
+    Mapping mapping;
+    {
+        std::scoped_lock lock{_guard};
+        const auto it = _mappings.find(data);
+        if (it == _mappings.end()) {
+            return;
+        }
+        mapping = it->second;
+        _mappings.erase(it);
+        switch (mapping.backing) {
+        case Backing::HugeTlb:
+            _stats.hugetlb -= mapping.size;
+            break;
+        case Backing::Transparent:
+            _stats.advised -= mapping.size;
+            break;
+        case Backing::Regular:
+            _stats.regular -= mapping.size;
+            break;
+        }
+    }
+    munmap(data, mapping.size);
+}
+
+uint64_t
+HugePageAllocator::allocatedBytes() const
+{
+    std::scoped_lock lock{_guard};
+    return _stats.hugetlb + _stats.advised + _stats.regular;
+}
+
+HugePageStats
+HugePageAllocator::stats() const
+{
+    HugePageStats stats;
+    std::vector<std::pair<uintptr_t, uintptr_t>> ranges;
+    {
+        std::scoped_lock lock{_guard};
+        stats = _stats;
+        for (const auto& [data, mapping] : _mappings) {
+            if (mapping.backing == Backing::Transparent) {
+                const auto begin = reinterpret_cast<uintptr_t>(data);
+                ranges.emplace_back(begin, begin + mapping.size);
+            }
+        }
+    }
+    if (not ranges.empty()) {
+        stats.transparent = std::min(stats.advised, transparentBytes(ranges));
+    }
+    return stats;
+}
+
+std::optional<int>
+HugePageAllocator::currentNumaNode()
+{
+    unsigned cpu{}, node{};
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) == -1) {
+        return std::nullopt;
+    }
+    return static_cast<int>(node);
+}
+
+void*
+HugePageAllocator::mapHugeTlb(const std::size_t size)
+{
+    if (not _hugeTlbAvailable.load(std::memory_order_relaxed)) {
+        return nullptr;
+    }
+    void* data = mmap(nullptr,
+                      size,
+                      PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+                      -1,
+                      0);
+    if (data == MAP_FAILED) {
+        /* No huge pages are reserved (or left), don't retry for the following blocks */
+        LOGD("Unable to map reserved huge pages: {}", strerror(errno));
+        _hugeTlbAvailable.store(false, std::memory_order_relaxed);
+        return nullptr;
+    }
+    return data;
+}
+
+void*
+HugePageAllocator::mapTransparent(const std::size_t size)
+{
+    /* Over-allocate to align the mapping to huge page boundary, then trim the excess */
+    const std::size_t reserved = size + kHugePageSize;
+    void* data = mapRegular(reserved);
+    if (not data) {
+        return nullptr;
+    }
+    auto* const base = static_cast<uint8_t*>(data);
+    auto* const aligned = reinterpret_cast<uint8_t*>(
+        alignUp(reinterpret_cast<uintptr_t>(base), kHugePageSize));
+    if (aligned != base) {
+        munmap(base, aligned - base);
+    }
+    if (const std::size_t tail = base + reserved - (aligned + size); tail > 0) {
+        munmap(aligned + size, tail);
+    }
+
+    if (madvise(aligned, size, MADV_HUGEPAGE) == -1) {
+        /* The transparent huge pages are disabled, fall back to regular pages */
+        LOGD("Unable to advise huge pages: {}", strerror(errno));
+        munmap(aligned, size);
+        return nullptr;
+    }
+    return aligned;
+}
+
+void*
+HugePageAllocator::mapRegular(const std::size_t size)
+{
+    void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return (data == MAP_FAILED) ? nullptr : data;
+}
+
+void
+HugePageAllocator::bind(void* data, const std::size_t size)
+{
+    if (not _numaNode or *_numaNode < 0 or *_numaNode >= 64) {
+        return;
+    }
+    /* Prefer the node (falls back to other nodes when it's out of memory) */
+    const unsigned long mask = 1UL << *_numaNode;
+    if (syscall(SYS_mbind, data, size, MPOL_PREFERRED, &mask, sizeof(mask) * 8, 0) == -1) {
+        LOGD("Unable to bind memory to <{}> NUMA node: {}", *_numaNode, strerror(errno));
+    }
+}
+
+} // namespace jar
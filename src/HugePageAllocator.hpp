@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+
+namespace jar {
+
+struct HugePageStats {
+    /* The number of allocated blocks */
+    uint64_t allocations{};
+    /* The bytes backed by reserved huge pages (MAP_HUGETLB) */
+    uint64_t hugetlb{};
+    /* The bytes advised to be backed by transparent huge pages (MADV_HUGEPAGE) */
+    uint64_t advised{};
+    /* The part of advised bytes the kernel actually backed by transparent huge pages */
+    uint64_t transparent{};
+    /* The bytes backed by regular pages */
+    uint64_t regular{};
+
+    /* Get the share of bytes actually backed by huge pages */
+    [[nodiscard]] double
+    coverage() const;
+};
+
+/*
+ * Allocates large blocks (frames) from 2 MiB huge pages bound to NUMA node. The reserved huge
+ * pages (MAP_HUGETLB) are tried first, then regular mapping aligned to huge page and advised
+ * for transparent huge pages, then plain regular pages. Blocks smaller than half of huge page
+ * are always allocated from regular pages.
+ */
+class HugePageAllocator {
+public:
+    static constexpr std::size_t kHugePageSize = 2 * 1024 * 1024;
+
+    /* Create allocator binding memory to given NUMA node (no binding if not set) */
+    explicit HugePageAllocator(bool hugePages = true, std::optional<int> numaNode = std::nullopt);
+
+    ~HugePageAllocator();
+
+    HugePageAllocator(const HugePageAllocator&) = delete;
+    HugePageAllocator&
+    operator=(const HugePageAllocator&)
+        = delete;
+
+    /* Allocate block (page aligned), returns nullptr on failure */
+    [[nodiscard]] void*
+    allocate(std::size_t size);
+
+    void
+    deallocate(void* data);
+
+    /* Get the bytes of all allocated blocks */
+    [[nodiscard]] uint64_t
+    allocatedBytes() const;
+
+    /* Get statistics, the transparent huge page backing is read from /proc/self/smaps (slow) */
+    [[nodiscard]] HugePageStats
+    stats() const;
+
+    /* Get NUMA node of the CPU the calling thread runs on */
+    [[nodiscard]] static std::optional<int>
+    currentNumaNode();
+
+private:
+    enum class Backing { HugeTlb, Transparent, Regular };
+
+    struct Mapping {
+        std::size_t size{};
+        Backing backing{Backing::Regular};
+    };
+
+    [[nodiscard]] void*
+    mapHugeTlb(std::size_t size);
+
+    [[nodiscard]] void*
+    mapTransparent(std::size_t size);
+
+    [[nodiscard]] static void*
+    mapRegular(std::size_t size);
+
+    void
+    bind(void* data, std::size_t size);
+
+private:
+    bool _hugePages{true};
+    std::optional<int> _numaNode;
+    std::atomic<bool> _hugeTlbAvailable{true};
+    mutable std::mutex _guard;
+    std::unordered_map<void*, Mapping> _mappings;
+    HugePageStats _stats;
+};
+
+} // namespace jar
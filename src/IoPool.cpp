@@ -0,0 +1,42 @@
+#include "IoPool.hpp"
+
+#include "Logger.hpp"
+
+#include <algorithm>
+
+namespace jar {
+
+IoPool::IoPool(boost::asio::io_context& context)
+    : _context{context}
+{
+}
+
+IoPool::~IoPool()
+{
+    stop();
+}
+
+void
+IoPool::start(const unsigned threadCount)
+{
+    LOGI("Start <{}> I/O threads", std::max(1u, threadCount));
+
+    _work.emplace(_context.get_executor());
+    for (unsigned n = 0; n < std::max(1u, threadCount); ++n) {
+        _threads.emplace_back([this] { _context.run(); });
+    }
+}
+
+void
+IoPool::stop()
+{
+    if (_threads.empty()) {
+        return;
+    }
+
+    _work.reset();
+    _context.stop();
+    _threads.clear();
+}
+
+} // namespace jar
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
+
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace jar {
+
+/*
+ * Runs io_context on fixed number of threads. The pipeline coroutines (capture, encoding and
+ * control) share these threads, each component is serialized by its own strand.
+ */
+class IoPool {
+public:
+    explicit IoPool(boost::asio::io_context& context);
+
+    ~IoPool();
+
+    void
+    start(unsigned threadCount);
+
+    /* Stop the context (pending handlers are abandoned) and join threads */
+    void
+    stop();
+
+private:
+    using WorkGuard = boost::asio::executor_work_guard<boost::asio::io_context::executor_type>;
+
+    boost::asio::io_context& _context;
+    std::optional<WorkGuard> _work;
+    std::vector<std::jthread> _threads;
+};
+
+} // namespace jar
@@ -0,0 +1,175 @@
+#include "IoUring.hpp"
+
+#include "Logger.hpp"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+namespace jar {
+
+namespace {
+
+[[nodiscard]] void*
+mapRing(const int fd, const std::size_t size, const off_t offset)
+{
+    void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+    return (ptr == MAP_FAILED) ? nullptr : ptr;
+}
+
+template<typename T>
+[[nodiscard]] T*
+at(void* base, const std::size_t offset)
+{
+    return reinterpret_cast<T*>(static_cast<uint8_t*>(base) + offset);
+}
+
+} // namespace
+
+IoUring::~IoUring()
+{
+    close();
+}
+
+bool
+IoUring::setup(const unsigned entries)
+{
+    close();
+
+    io_uring_params params{};
+    _fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if (_fd == -1) {
+        LOGD("Unable to setup io_uring: {}", strerror(errno));
+        return false;
+    }
+
+    _features = params.features;
+    _sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    _cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMap) {
+        _sqRingSize = _cqRingSize = std::max(_sqRingSize, _cqRingSize);
+    }
+    _sqRing = mapRing(_fd, _sqRingSize, IORING_OFF_SQ_RING);
+    _cqRing = singleMap ? _sqRing : mapRing(_fd, _cqRingSize, IORING_OFF_CQ_RING);
+    _sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    _sqes = static_cast<io_uring_sqe*>(mapRing(_fd, _sqesSize, IORING_OFF_SQES));
+    if (not _sqRing or not _cqRing or not _sqes) {
+        LOGE("Unable to map io_uring: {}", strerror(errno));
+        close();
+        return false;
+    }
+
+    _sqHead = at<unsigned>(_sqRing, params.sq_off.head);
+    _sqTail = at<unsigned>(_sqRing, params.sq_off.tail);
+    _sqArray = at<unsigned>(_sqRing, params.sq_off.array);
+    _sqMask = *at<unsigned>(_sqRing, params.sq_off.ring_mask);
+    _sqEntries = *at<unsigned>(_sqRing, params.sq_off.ring_entries);
+    _sqLocalTail = *_sqTail;
+    _pending = 0;
+
+    _cqHead = at<unsigned>(_cqRing, params.cq_off.head);
+    _cqTail = at<unsigned>(_cqRing, params.cq_off.tail);
+    _cqMask = *at<unsigned>(_cqRing, params.cq_off.ring_mask);
+    _cqes = at<io_uring_cqe>(_cqRing, params.cq_off.cqes);
+    return true;
+}
+
+void
+IoUring::close()
+{
+    if (_sqes) {
+        munmap(_sqes, _sqesSize);
+        _sqes = nullptr;
+    }
+    if (_cqRing and _cqRing != _sqRing) {
+        munmap(_cqRing, _cqRingSize);
+    }
+    _cqRing = nullptr;
+    if (_sqRing) {
+        munmap(_sqRing, _sqRingSize);
+        _sqRing = nullptr;
+    }
+    if (_fd != -1) {
+        ::close(_fd);
+        _fd = -1;
+    }
+}
+
+bool
+IoUring::ready() const
+{
+    return _fd != -1;
+}
+
+uint32_t
+IoUring::features() const
+{
+    return _features;
+}
+
+bool
+IoUring::registerBuffers(const std::span<const iovec> buffers)
+{
+    const auto rv = syscall(__NR_io_uring_register,
+                            _fd,
+                            IORING_REGISTER_BUFFERS,
+                            buffers.data(),
+                            static_cast<unsigned>(buffers.size()));
+    if (rv == -1) {
+        LOGD("Unable to register io_uring buffers: {}", strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+io_uring_sqe*
+IoUring::acquire()
+{
+    const unsigned head = std::atomic_ref{*_sqHead}.load(std::memory_order_acquire);
+    if (_sqLocalTail - head >= _sqEntries) {
+        return nullptr;
+    }
+    const unsigned index = _sqLocalTail & _sqMask;
+    io_uring_sqe* sqe = &_sqes[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    _sqArray[index] = index;
+    ++_sqLocalTail, ++_pending;
+    return sqe;
+}
+
+int
+IoUring::submit(const unsigned waitCount)
+{
+    std::atomic_ref{*_sqTail}.store(_sqLocalTail, std::memory_order_release);
+    const unsigned flags = (waitCount > 0) ? IORING_ENTER_GETEVENTS : 0;
+    const auto rv = syscall(__NR_io_uring_enter, _fd, _pending, waitCount, flags, nullptr, 0);
+    if (rv == -1) {
+        /* The interrupted wait is not an error, the entries are submitted anyway */
+        return (errno == EINTR) ? 0 : -errno;
+    }
+    _pending -= std::min(_pending, static_cast<unsigned>(rv));
+    return static_cast<int>(rv);
+}
+
+const io_uring_cqe*
+IoUring::peek() const
+{
+    const unsigned head = *_cqHead;
+    if (head == std::atomic_ref{*_cqTail}.load(std::memory_order_acquire)) {
+        return nullptr;
+    }
+    return &_cqes[head & _cqMask];
+}
+
+void
+IoUring::advance()
+{
+    std::atomic_ref{*_cqHead}.store(*_cqHead + 1, std::memory_order_release);
+}
+
+} // namespace jar
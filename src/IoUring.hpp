@@ -0,0 +1,99 @@
+#pragma once
+
+#include <linux/io_uring.h>
+#include <sys/uio.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace jar {
+
+/*
+ * Minimal io_uring wrapper on raw system calls (no liburing dependency): ring setup and
+ * mapping, submission queue entries acquisition, submission and completion reaping.
+ * Not thread-safe, the ring is driven by single thread.
+ */
+class IoUring {
+public:
+    IoUring() = default;
+
+    ~IoUring();
+
+    IoUring(const IoUring&) = delete;
+    IoUring&
+    operator=(const IoUring&)
+        = delete;
+
+    /* Create ring with given number of submission entries, returns false if not supported */
+    [[nodiscard]] bool
+    setup(unsigned entries);
+
+    void
+    close();
+
+    [[nodiscard]] bool
+    ready() const;
+
+    /* Get IORING_FEAT_* flags reported by kernel */
+    [[nodiscard]] uint32_t
+    features() const;
+
+    /* Register fixed buffers (used by IORING_OP_WRITE_FIXED with buffer index) */
+    [[nodiscard]] bool
+    registerBuffers(std::span<const iovec> buffers);
+
+    /* Get cleared submission entry or nullptr if submission queue is full */
+    [[nodiscard]] io_uring_sqe*
+    acquire();
+
+    /* Submit acquired entries and wait for given number of completions */
+    int
+    submit(unsigned waitCount);
+
+    /* Call handler for each available completion, returns the number of them */
+    template<typename Handler>
+    unsigned
+    reap(Handler&& handler)
+    {
+        unsigned count{};
+        for (const io_uring_cqe* cqe = peek(); cqe; cqe = peek()) {
+            handler(*cqe);
+            advance();
+            ++count;
+        }
+        return count;
+    }
+
+private:
+    [[nodiscard]] const io_uring_cqe*
+    peek() const;
+
+    void
+    advance();
+
+private:
+    int _fd{-1};
+    uint32_t _features{};
+    void* _sqRing{};
+    std::size_t _sqRingSize{};
+    void* _cqRing{};
+    std::size_t _cqRingSize{};
+    io_uring_sqe* _sqes{};
+    std::size_t _sqesSize{};
+
+    unsigned* _sqHead{};
+    unsigned* _sqTail{};
+    unsigned* _sqArray{};
+    unsigned _sqMask{};
+    unsigned _sqEntries{};
+    unsigned _sqLocalTail{};
+    unsigned _pending{};
+
+    unsigned* _cqHead{};
+    unsigned* _cqTail{};
+    unsigned _cqMask{};
+    io_uring_cqe* _cqes{};
+};
+
+} // namespace jar
@@ -0,0 +1,183 @@
+#include "KeyframeIndex.hpp"
+
+#include "Logger.hpp"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+
+namespace jar {
+
+std::filesystem::path
+keyframeIndexPath(const std::filesystem::path& path)
+{
+    std::filesystem::path output{path};
+    output += kIndexExtension;
+    return output;
+}
+
+KeyframeIndexWriter::~KeyframeIndexWriter()
+{
+    close();
+}
+
+bool
+KeyframeIndexWriter::open(const std::filesystem::path& path,
+                          const int32_t timeBaseNum,
+                          const int32_t timeBaseDen)
+{
+    close();
+
+    _file = fopen(path.c_str(), "wb");
+    if (not _file) {
+        LOGE("Unable to open <{}> index file: {}", path, strerror(errno));
+        return false;
+    }
+
+    KeyframeIndexHeader header{
+        .version = kIndexVersion,
+        .entrySize = sizeof(KeyframeIndexEntry),
+        .timeBaseNum = timeBaseNum,
+        .timeBaseDen = timeBaseDen,
+    };
+    std::memcpy(header.magic, kIndexMagic, sizeof(kIndexMagic));
+    if (fwrite(&header, sizeof(header), 1, _file) != 1 or fflush(_file) != 0) {
+        LOGE("Unable to write <{}> index file: {}", path, strerror(errno));
+        close();
+        return false;
+    }
+    return true;
+}
+
+void
+KeyframeIndexWriter::close()
+{
+    if (_file) {
+        fclose(_file);
+        _file = nullptr;
+    }
+}
+
+void
+KeyframeIndexWriter::add(const KeyframeIndexEntry& entry)
+{
+    if (not _file) {
+        return;
+    }
+    if (fwrite(&entry, sizeof(entry), 1, _file) != 1 or fflush(_file) != 0) {
+        LOGE_LIMITED("Unable to write index entry: {}", strerror(errno));
+    }
+}
+
+KeyframeIndexReader::~KeyframeIndexReader()
+{
+    close();
+}
+
+bool
+KeyframeIndexReader::open(const std::filesystem::path& path)
+{
+    close();
+
+    _fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (_fd == -1) {
+        LOGE("Unable to open <{}> index file: {}", path, strerror(errno));
+        return false;
+    }
+
+    struct stat st{};
+    if (pread(_fd, &_header, sizeof(_header), 0) != sizeof(_header)
+        or std::memcmp(_header.magic, kIndexMagic, sizeof(kIndexMagic)) != 0
+        or _header.version != kIndexVersion or _header.entrySize != sizeof(KeyframeIndexEntry)
+        or fstat(_fd, &st) == -1) {
+        LOGE("File <{}> is not a keyframe index", path);
+        close();
+        return false;
+    }
+
+    /* The partially written last entry (e.g. after crash) is ignored */
+    _size = (static_cast<std::size_t>(st.st_size) - sizeof(_header)) / sizeof(KeyframeIndexEntry);
+    return true;
+}
+
+void
+KeyframeIndexReader::close()
+{
+    if (_fd != -1) {
+        ::close(_fd);
+        _fd = -1;
+    }
+    _size = 0;
+}
+
+const KeyframeIndexHeader&
+KeyframeIndexReader::header() const
+{
+    return _header;
+}
+
+std::size_t
+KeyframeIndexReader::size() const
+{
+    return _size;
+}
+
+std::optional<KeyframeIndexEntry>
+KeyframeIndexReader::entry(const std::size_t index) const
+{
+    if (index >= _size) {
+        return std::nullopt;
+    }
+
+    KeyframeIndexEntry entry;
+    const auto offset = static_cast<off_t>(sizeof(_header) + index * sizeof(entry));
+    if (pread(_fd, &entry, sizeof(entry), offset) != sizeof(entry)) {
+        LOGE("Unable to read <{}> index entry: {}", index, strerror(errno));
+        return std::nullopt;
+    }
+    return entry;
+}
+
+std::optional<KeyframeIndexEntry>
+KeyframeIndexReader::findByPts(const int64_t pts) const
+{
+    const std::size_t count = upperBound(pts, &KeyframeIndexEntry::pts);
+    return entry((count > 0) ? count - 1 : 0);
+}
+
+std::optional<KeyframeIndexEntry>
+KeyframeIndexReader::findByTime(const int64_t time) const
+{
+    const std::size_t count = upperBound(time, &KeyframeIndexEntry::time);
+    return entry((count > 0) ? count - 1 : 0);
+}
+
+std::optional<KeyframeIndexEntry>
+KeyframeIndexReader::findAfterTime(const int64_t time) const
+{
+    return entry(upperBound(time, &KeyframeIndexEntry::time));
+}
+
+template<typename Key>
+std::size_t
+KeyframeIndexReader::upperBound(const int64_t value, Key key) const
+{
+    std::size_t lo{0}, hi{_size};
+    while (lo < hi) {
+        const std::size_t mid = lo + (hi - lo) / 2;
+        const auto entry = this->entry(mid);
+        if (not entry) {
+            /* Treat unreadable entry as the end of index */
+            hi = mid;
+        } else if ((*entry).*key <= value) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+} // namespace jar
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <optional>
+
+namespace jar {
+
+/*
+ * Keyframe index file layout (little-endian, written next to recording as "<file>.idx"):
+ *   [header, 32 bytes][entry 0, 32 bytes][entry 1]...
+ * The entries are appended in stream order, so both pts and wall-clock time are ascending and
+ * any lookup is a binary search over fixed-size entries (O(log n) reads).
+ */
+
+inline constexpr char kIndexMagic[8] = {'R', 'A', 'W', 'K', 'I', 'D', 'X', '1'};
+inline constexpr uint32_t kIndexVersion = 1;
+inline constexpr const char* kIndexExtension = ".idx";
+
+struct KeyframeIndexHeader {
+    char magic[8]{};
+    uint32_t version{};
+    uint32_t entrySize{};
+    /* The time base of pts (num/den seconds) */
+    int32_t timeBaseNum{};
+    int32_t timeBaseDen{};
+    uint64_t reserved{};
+};
+
+struct KeyframeIndexEntry {
+    /* The presentation timestamp (in index time base) */
+    int64_t pts{};
+    /* The wall-clock time of the packet (microseconds since epoch) */
+    int64_t time{};
+    /* The byte offset of keyframe packet in recording file */
+    uint64_t offset{};
+    /* The size of keyframe packet */
+    uint32_t size{};
+    uint32_t reserved{};
+};
+
+static_assert(sizeof(KeyframeIndexHeader) == 32);
+static_assert(sizeof(KeyframeIndexEntry) == 32);
+
+/* Get index file path for given recording file */
+[[nodiscard]] std::filesystem::path
+keyframeIndexPath(const std::filesystem::path& path);
+
+/* Appends keyframe entries to index file (each entry is flushed, so index survives crash) */
+class KeyframeIndexWriter {
+public:
+    KeyframeIndexWriter() = default;
+
+    ~KeyframeIndexWriter();
+
+    KeyframeIndexWriter(const KeyframeIndexWriter&) = delete;
+    KeyframeIndexWriter&
+    operator=(const KeyframeIndexWriter&)
+        = delete;
+
+    [[nodiscard]] bool
+    open(const std::filesystem::path& path, int32_t timeBaseNum, int32_t timeBaseDen);
+
+    void
+    close();
+
+    void
+    add(const KeyframeIndexEntry& entry);
+
+private:
+    FILE* _file{};
+};
+
+/* Looks up keyframes in index file reading only O(log n) entries */
+class KeyframeIndexReader {
+public:
+    KeyframeIndexReader() = default;
+
+    ~KeyframeIndexReader();
+
+    KeyframeIndexReader(const KeyframeIndexReader&) = delete;
+    KeyframeIndexReader&
+    operator=(const KeyframeIndexReader&)
+        = delete;
+
+    [[nodiscard]] bool
+    open(const std::filesystem::path& path);
+
+    void
+    close();
+
+    [[nodiscard]] const KeyframeIndexHeader&
+    header() const;
+
+    [[nodiscard]] std::size_t
+    size() const;
+
+    [[nodiscard]] std::optional<KeyframeIndexEntry>
+    entry(std::size_t index) const;
+
+    /* Find the last keyframe with pts not greater than given (or the first one) */
+    [[nodiscard]] std::optional<KeyframeIndexEntry>
+    findByPts(int64_t pts) const;
+
+    /* Find the last keyframe with wall-clock time not greater than given (or the first one) */
+    [[nodiscard]] std::optional<KeyframeIndexEntry>
+    findByTime(int64_t time) const;
+
+    /* Find the first keyframe with wall-clock time greater than given */
+    [[nodiscard]] std::optional<KeyframeIndexEntry>
+    findAfterTime(int64_t time) const;
+
+private:
+    /* Get the number of leading entries with key not greater than given */
+    template<typename Key>
+    [[nodiscard]] std::size_t
+    upperBound(int64_t value, Key key) const;
+
+private:
+    int _fd{-1};
+    KeyframeIndexHeader _header;
+    std::size_t _size{};
+};
+
+} // namespace jar
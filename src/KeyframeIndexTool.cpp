@@ -0,0 +1,192 @@
+#include <boost/program_options.hpp>
+
+#include "KeyframeIndex.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <optional>
+#include <vector>
+
+namespace po = boost::program_options;
+
+/* The size of chunk copied at once on extraction */
+static constexpr std::size_t kCopyChunkSize = 1024 * 1024;
+
+namespace jar {
+
+/*
+ * Looks up keyframes of recording by its keyframe index: lists entries, finds the keyframe
+ * to start playback from at given pts or wall-clock time, extracts time range starting at
+ * keyframe into separate file without scanning the recording.
+ */
+class KeyframeIndexTool {
+public:
+    [[nodiscard]] bool
+    parseArgs(const int argc, char* argv[])
+    {
+        po::options_description d{"RawEnc keyframe index CLI"};
+        // clang-format off
+        d.add_options()
+            ("help,h", "Display help")
+            ("recording", po::value<std::string>()->notifier([this](const std::string& v) {
+                _recording = v;
+            })->required(), "Set recording file (the index is read from <recording>.idx)")
+            ("list", po::bool_switch()->notifier([this](const bool v) {
+                _list = v;
+            }), "List all keyframes")
+            ("pts", po::value<int64_t>()->notifier([this](const int64_t v) {
+                _pts = v;
+            }), "Find keyframe to start from at given pts")
+            ("time", po::value<int64_t>()->notifier([this](const int64_t v) {
+                _time = v * 1000;
+            }), "Find keyframe to start from at given wall-clock time (ms since epoch)")
+            ("extract", po::value<std::string>()->notifier([this](const std::string& v) {
+                _extract = v;
+            }), "Extract range between --from and --to into given file")
+            ("from", po::value<int64_t>()->notifier([this](const int64_t v) {
+                _from = v * 1000;
+            }), "Set start of extracted range (ms since epoch, default - the beginning)")
+            ("to", po::value<int64_t>()->notifier([this](const int64_t v) {
+                _to = v * 1000;
+            }), "Set end of extracted range (ms since epoch, default - the end)")
+        ;
+        // clang-format on
+
+        po::positional_options_description p;
+        p.add("recording", 1);
+
+        po::variables_map vm;
+        po::store(po::command_line_parser(argc, argv).options(d).positional(p).run(), vm);
+        if (vm.contains("help")) {
+            std::cout << d << std::endl;
+            return false;
+        }
+        po::notify(vm);
+        return true;
+    }
+
+    [[nodiscard]] bool
+    run()
+    {
+        if (not _index.open(keyframeIndexPath(_recording))) {
+            std::cerr << "Unable to open index of <" << _recording << "> recording\n";
+            return false;
+        }
+        if (_index.size() == 0) {
+            std::cerr << "No keyframes in index\n";
+            return false;
+        }
+
+        if (_list) {
+            for (std::size_t n = 0; n < _index.size(); ++n) {
+                if (const auto entry = _index.entry(n); entry) {
+                    print(*entry);
+                }
+            }
+        }
+        if (_pts) {
+            print(*_index.findByPts(*_pts));
+        }
+        if (_time) {
+            print(*_index.findByTime(*_time));
+        }
+        if (_extract) {
+            return extract();
+        }
+        return true;
+    }
+
+private:
+    void
+    print(const KeyframeIndexEntry& entry) const
+    {
+        const auto& header = _index.header();
+        const double seconds
+            = static_cast<double>(entry.pts) * header.timeBaseNum / header.timeBaseDen;
+        std::cout << "pts=" << entry.pts << " seconds=" << seconds << " time=" << entry.time / 1000
+                  << " offset=" << entry.offset << " size=" << entry.size << '\n';
+    }
+
+    [[nodiscard]] bool
+    extract()
+    {
+        const uint64_t begin = _from ? _index.findByTime(*_from)->offset : 0;
+        /* The range ends before the first keyframe after the end time (or at the end of file) */
+        std::optional<uint64_t> end;
+        if (_to) {
+            if (const auto entry = _index.findAfterTime(*_to); entry) {
+                end = entry->offset;
+            }
+        }
+
+        const int input = ::open(_recording.c_str(), O_RDONLY | O_CLOEXEC);
+        if (input == -1) {
+            std::cerr << "Unable to open <" << _recording << "> file: " << strerror(errno) << '\n';
+            return false;
+        }
+        const int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+        const int output = ::open(_extract->c_str(), flags, 0644);
+        if (output == -1) {
+            std::cerr << "Unable to open <" << *_extract << "> file: " << strerror(errno) << '\n';
+            ::close(input);
+            return false;
+        }
+
+        std::vector<uint8_t> chunk(kCopyChunkSize);
+        uint64_t offset{begin};
+        bool ok{true};
+        while (not end or offset < *end) {
+            std::size_t size = chunk.size();
+            if (end) {
+                size = std::min<uint64_t>(size, *end - offset);
+            }
+            const ssize_t n = pread(input, chunk.data(), size, static_cast<off_t>(offset));
+            if (n <= 0) {
+                ok = (n == 0);
+                break;
+            }
+            if (write(output, chunk.data(), n) != n) {
+                ok = false;
+                break;
+            }
+            offset += n;
+        }
+        if (not ok) {
+            std::cerr << "Unable to extract range: " << strerror(errno) << '\n';
+        } else {
+            std::cout << "Extracted <" << offset - begin << "> bytes from <" << begin
+                      << "> offset\n";
+        }
+
+        ::close(output);
+        ::close(input);
+        return ok;
+    }
+
+private:
+    std::string _recording;
+    bool _list{false};
+    std::optional<int64_t> _pts;
+    std::optional<int64_t> _time;
+    std::optional<std::string> _extract;
+    std::optional<int64_t> _from;
+    std::optional<int64_t> _to;
+    KeyframeIndexReader _index;
+};
+
+} // namespace jar
+
+int
+main(int argc, char* argv[])
+{
+    jar::KeyframeIndexTool app;
+    if (not app.parseArgs(argc, argv)) {
+        /* Show help menu and exit */
+        return EXIT_SUCCESS;
+    }
+    return app.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
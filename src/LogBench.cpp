@@ -0,0 +1,138 @@
+#include <boost/program_options.hpp>
+
+#include "Logger.hpp"
+#include "LoggerInitializer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+namespace po = boost::program_options;
+
+static constexpr unsigned kDefaultCalls = 200'000;
+static constexpr const char* kDefaultLogFile = "logbench.log";
+
+namespace jar {
+
+/*
+ * Measures per-call cost of logging on the calling thread (the thread which captures or encodes
+ * frames in the application): synchronous logger, asynchronous logger and rate-limited call
+ * which is suppressed. The cost of the background thread is not included.
+ */
+class LogBench {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    [[nodiscard]] bool
+    parseArgs(const int argc, char* argv[])
+    {
+        po::options_description d{"RawEnc logging benchmark CLI"};
+        // clang-format off
+        d.add_options()
+            ("help,h", "Display help")
+            ("calls", po::value<unsigned>()->notifier([this](const unsigned v) {
+                _calls = v;
+            })->default_value(kDefaultCalls), "Set the number of logging calls per mode")
+            ("log-file", po::value<std::string>()->notifier([this](const std::string& v) {
+                _logFile = v;
+            })->default_value(kDefaultLogFile), "Set log file (truncated for each mode)")
+            ("log-queue-size", po::value<std::size_t>()->notifier([this](const std::size_t v) {
+                _config.queueSize = v;
+            }), "Set the number of slots in async queue")
+            ("log-overflow", po::value<std::string>()->notifier([this](const std::string& v) {
+                if (const auto policy = LoggerInitializer::parseOverflowPolicy(v); policy) {
+                    _config.overflow = *policy;
+                } else {
+                    throw po::validation_error{
+                        po::validation_error::invalid_option_value, "log-overflow"};
+                }
+            }), "Set async queue overflow policy (block, drop)")
+        ;
+        // clang-format on
+
+        po::variables_map vm;
+        po::store(po::parse_command_line(argc, argv, d), vm);
+        if (vm.contains("help")) {
+            std::cout << d << std::endl;
+            return false;
+        }
+        po::notify(vm);
+        return true;
+    }
+
+    [[nodiscard]] bool
+    run()
+    {
+        if (_calls == 0) {
+            std::cerr << "No calls to measure\n";
+            return false;
+        }
+
+        LoggerConfig config{_config};
+        config.async = false;
+        measure("sync", config, [](const unsigned n) {
+            LOGI("Frame <{}> was captured: size<{}>, bytes<{}>", n, "1280x720", 1382400);
+        });
+        config.async = true;
+        measure("async", config, [](const unsigned n) {
+            LOGI("Frame <{}> was captured: size<{}>, bytes<{}>", n, "1280x720", 1382400);
+        });
+        config.async = false;
+        measure("suppressed", config, [](const unsigned n) {
+            LOGW_LIMITED("Unable to capture frame <{}>: error<{}>", n, "EAGAIN");
+        });
+        return true;
+    }
+
+private:
+    template<typename Log>
+    void
+    measure(const char* mode, const LoggerConfig& config, Log&& log)
+    {
+        std::vector<Clock::duration> samples(_calls);
+
+        LoggerInitializer::instance().initialize(_logFile, config);
+        const auto begin = Clock::now();
+        for (unsigned n = 0; n < _calls; ++n) {
+            const auto callBegin = Clock::now();
+            log(n);
+            samples[n] = Clock::now() - callBegin;
+        }
+        const auto total = Clock::now() - begin;
+        /* Draining of async queue is excluded from the measurement */
+        LoggerInitializer::instance().finalize();
+
+        std::ranges::sort(samples);
+        const auto p99 = samples[std::min<std::size_t>(_calls - 1, _calls * 99 / 100)];
+        std::cout << std::left << std::setw(12) << mode << std::fixed << std::setprecision(1)
+                  << "mean<" << nanoseconds(total) / _calls << "ns>, p50<"
+                  << nanoseconds(samples[_calls / 2]) << "ns>, p99<" << nanoseconds(p99)
+                  << "ns>\n";
+    }
+
+    [[nodiscard]] static double
+    nanoseconds(const Clock::duration value)
+    {
+        return std::chrono::duration<double, std::nano>{value}.count();
+    }
+
+private:
+    unsigned _calls{kDefaultCalls};
+    std::string _logFile{kDefaultLogFile};
+    LoggerConfig _config;
+};
+
+} // namespace jar
+
+int
+main(int argc, char* argv[])
+{
+    jar::LogBench app;
+    if (not app.parseArgs(argc, argv)) {
+        /* Show help menu and exit */
+        return EXIT_SUCCESS;
+    }
+    return app.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -5,6 +5,44 @@
 #include <spdlog/fmt/ostr.h>
 #include <spdlog/fmt/std.h>
 
+#include <atomic>
+#include <chrono>
+#include <limits>
+
+namespace jar {
+
+/* Allows one message per interval, counts the suppressed ones (used by LOG*_LIMITED macros) */
+class LogRateLimiter {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit LogRateLimiter(const Clock::duration interval = std::chrono::seconds{1})
+        : _interval{interval.count()}
+    {
+    }
+
+    [[nodiscard]] bool
+    allow(std::size_t& suppressed)
+    {
+        const auto now = Clock::now().time_since_epoch().count();
+        auto last = _last.load(std::memory_order_relaxed);
+        if (now - last < _interval
+            or not _last.compare_exchange_strong(last, now, std::memory_order_relaxed)) {
+            _suppressed.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        suppressed = _suppressed.exchange(0, std::memory_order_relaxed);
+        return true;
+    }
+
+private:
+    const Clock::rep _interval;
+    std::atomic<Clock::rep> _last{std::numeric_limits<Clock::rep>::min() / 2};
+    std::atomic<std::size_t> _suppressed{0};
+};
+
+} // namespace jar
+
 // clang-format off
 #define LOGT(...) \
     SPDLOG_TRACE(__VA_ARGS__)
@@ -16,4 +54,20 @@
     SPDLOG_WARN(__VA_ARGS__)
 #define LOGE(...) \
     SPDLOG_ERROR(__VA_ARGS__)
+
+/* Rate-limited logging for repeated (e.g. per-frame) failures, at most one message per second */
+#define LOG_LIMITED(log, ...) \
+    do { \
+        static jar::LogRateLimiter limiter_; \
+        if (std::size_t suppressed_{}; limiter_.allow(suppressed_)) { \
+            if (suppressed_ > 0) { \
+                log("<{}> similar messages were suppressed", suppressed_); \
+            } \
+            log(__VA_ARGS__); \
+        } \
+    } while (false)
+#define LOGW_LIMITED(...) \
+    LOG_LIMITED(LOGW, __VA_ARGS__)
+#define LOGE_LIMITED(...) \
+    LOG_LIMITED(LOGE, __VA_ARGS__)
 // clang-format on
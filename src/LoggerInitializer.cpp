@@ -1,5 +1,6 @@
 #include "LoggerInitializer.hpp"
 
+#include <spdlog/async.h>
 #include <spdlog/pattern_formatter.h>
 #include <spdlog/sinks/basic_file_sink.h>
 #include <spdlog/spdlog.h>
@@ -57,19 +58,10 @@ getLogLevel()
 #endif
 }
 
-void
-setupDefaultLogger()
-{
-    auto logger = std::make_shared<spdlog::logger>("rawenc");
-    logger->set_level(getLogLevel());
-    set_default_logger(std::move(logger));
-}
-
-void
-addFileSink(const spdlog::filename_t& fileName)
+template<typename Sink>
+spdlog::sink_ptr
+createFileSink(const spdlog::filename_t& fileName)
 {
-    using Sink = spdlog::sinks::basic_file_sink_mt;
-
     static constexpr const char* kFormat{"[%L] [%P:%t] [%*] %v"};
     auto formatter = std::make_unique<spdlog::pattern_formatter>();
     formatter->add_flag<ShortFilenameAndLine>('*').set_pattern(kFormat);
@@ -79,10 +71,39 @@ addFileSink(const spdlog::filename_t& fileName)
         create_directories(filePath.parent_path(), ec);
     }
 
-    const auto sink = std::make_shared<Sink>(fileName, true);
+    auto sink = std::make_shared<Sink>(fileName, true);
     sink->set_level(getLogLevel());
     sink->set_formatter(std::move(formatter));
-    spdlog::default_logger()->sinks().push_back(sink);
+    return sink;
+}
+
+void
+setupDefaultLogger(const spdlog::filename_t& fileName)
+{
+    /* Sink is used by many threads, so the thread-safe version is required */
+    auto logger = std::make_shared<spdlog::logger>(
+        "rawenc", createFileSink<spdlog::sinks::basic_file_sink_mt>(fileName));
+    logger->set_level(getLogLevel());
+    set_default_logger(std::move(logger));
+}
+
+void
+setupAsyncLogger(const spdlog::filename_t& fileName, const LoggerConfig& config)
+{
+    /* The single background thread is the only user of the sink, so no locking is required */
+    spdlog::init_thread_pool(config.queueSize, 1);
+    const auto policy = (config.overflow == LogOverflowPolicy::Block)
+                            ? spdlog::async_overflow_policy::block
+                            : spdlog::async_overflow_policy::overrun_oldest;
+    auto logger = std::make_shared<spdlog::async_logger>(
+        "rawenc",
+        createFileSink<spdlog::sinks::basic_file_sink_st>(fileName),
+        spdlog::thread_pool(),
+        policy);
+    logger->set_level(getLogLevel());
+    logger->flush_on(spdlog::level::err);
+    set_default_logger(std::move(logger));
+    spdlog::flush_every(config.flushInterval);
 }
 
 } // namespace
@@ -95,13 +116,38 @@ LoggerInitializer::instance()
 }
 
 void
-LoggerInitializer::initialize(const spdlog::filename_t& fileName)
+LoggerInitializer::initialize(const spdlog::filename_t& fileName, const LoggerConfig& config)
 {
     if (not _initialized) {
-        setupDefaultLogger();
-        addFileSink(fileName);
+        if (config.async) {
+            setupAsyncLogger(fileName, config);
+        } else {
+            setupDefaultLogger(fileName);
+        }
         _initialized = true;
     }
 }
 
+void
+LoggerInitializer::finalize()
+{
+    if (_initialized) {
+        /* Drain async queue and stop background threads */
+        spdlog::shutdown();
+        _initialized = false;
+    }
+}
+
+std::optional<LogOverflowPolicy>
+LoggerInitializer::parseOverflowPolicy(const std::string_view name)
+{
+    if (name == "block") {
+        return LogOverflowPolicy::Block;
+    }
+    if (name == "drop") {
+        return LogOverflowPolicy::DropOldest;
+    }
+    return std::nullopt;
+}
+
 } // namespace jar
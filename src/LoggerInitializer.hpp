@@ -2,15 +2,43 @@
 
 #include <spdlog/common.h>
 
+#include <chrono>
+#include <optional>
+#include <string_view>
+
 namespace jar {
 
+enum class LogOverflowPolicy {
+    /* Block the caller until there is room in the queue */
+    Block,
+    /* Overwrite the oldest message in the queue (never blocks the caller) */
+    DropOldest
+};
+
+struct LoggerConfig {
+    /* Whether to format and write log messages on background thread */
+    bool async{false};
+    /* The number of preallocated slots in the async queue */
+    std::size_t queueSize{8192};
+    /* The policy to apply when async queue is full */
+    LogOverflowPolicy overflow{LogOverflowPolicy::DropOldest};
+    /* The interval of flushing file sink in async mode */
+    std::chrono::seconds flushInterval{1};
+};
+
 class LoggerInitializer {
 public:
     static LoggerInitializer&
     instance();
 
     void
-    initialize(const spdlog::filename_t& fileName);
+    initialize(const spdlog::filename_t& fileName, const LoggerConfig& config = {});
+
+    void
+    finalize();
+
+    [[nodiscard]] static std::optional<LogOverflowPolicy>
+    parseOverflowPolicy(std::string_view name);
 
 private:
     LoggerInitializer() = default;
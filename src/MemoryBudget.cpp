@@ -0,0 +1,162 @@
+#include "MemoryBudget.hpp"
+
+#include "Logger.hpp"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iterator>
+
+namespace jar {
+
+namespace {
+
+[[nodiscard]] double
+mib(const std::size_t bytes)
+{
+    return static_cast<double>(bytes) / (1024.0 * 1024.0);
+}
+
+} // namespace
+
+MemoryBudget::MemoryBudget(const std::size_t budget)
+    : _budget{budget}
+{
+}
+
+void
+MemoryBudget::demand(MemoryDemand demand)
+{
+    demand.minUnits = std::min(demand.minUnits, demand.units);
+    std::scoped_lock lock{_guard};
+    const std::size_t units = demand.units;
+    _components.push_back(Component{.demand = std::move(demand), .granted = units, .usage = {}});
+}
+
+bool
+MemoryBudget::plan()
+{
+    std::scoped_lock lock{_guard};
+    const std::size_t total = plannedLocked();
+    if (_budget == 0 or total <= _budget) {
+        LOGI("Memory plan: budget<{:.1f}MiB>, planned<{:.1f}MiB>", mib(_budget), mib(total));
+        return true;
+    }
+
+    std::size_t minimal{};
+    for (const auto& component : _components) {
+        minimal += component.demand.fixed + component.demand.unitSize * component.demand.minUnits;
+    }
+    if (minimal > _budget) {
+        LOGE("Memory budget <{:.1f}MiB> is too small, the minimal configuration needs <{:.1f}MiB>",
+             mib(_budget),
+             mib(minimal));
+        return false;
+    }
+
+    /* Each component gives up the same share of its reducible units (rounded up) */
+    const double share
+        = static_cast<double>(total - _budget) / static_cast<double>(total - minimal);
+    for (auto& component : _components) {
+        const std::size_t reducible = component.granted - component.demand.minUnits;
+        const auto cut
+            = static_cast<std::size_t>(std::ceil(static_cast<double>(reducible) * share));
+        if (cut > 0) {
+            component.granted -= std::min(cut, reducible);
+            LOGW("Reduce <{}> from <{}> to <{}> units to fit memory budget",
+                 component.demand.name,
+                 component.demand.units,
+                 component.granted);
+        }
+    }
+    LOGI("Memory plan: budget<{:.1f}MiB>, requested<{:.1f}MiB>, planned<{:.1f}MiB>",
+         mib(_budget),
+         mib(total),
+         mib(plannedLocked()));
+    return true;
+}
+
+std::size_t
+MemoryBudget::granted(const std::string_view name) const
+{
+    std::scoped_lock lock{_guard};
+    const auto it = std::ranges::find(_components, name, [](const Component& component) {
+        return std::string_view{component.demand.name};
+    });
+    return (it != _components.end()) ? it->granted : 0;
+}
+
+void
+MemoryBudget::track(const std::string_view name, Usage usage)
+{
+    std::scoped_lock lock{_guard};
+    const auto it = std::ranges::find(_components, name, [](const Component& component) {
+        return std::string_view{component.demand.name};
+    });
+    if (it != _components.end()) {
+        it->usage = std::move(usage);
+    }
+}
+
+std::size_t
+MemoryBudget::planned() const
+{
+    std::scoped_lock lock{_guard};
+    return plannedLocked();
+}
+
+std::string
+MemoryBudget::report() const
+{
+    std::scoped_lock lock{_guard};
+    const std::size_t resident = residentBytes();
+
+    std::string out;
+    auto it = std::back_inserter(out);
+    fmt::format_to(it,
+                   "memory (MiB): budget<{:.1f}>, planned<{:.1f}>, resident<{:.1f}>\n",
+                   mib(_budget),
+                   mib(plannedLocked()),
+                   mib(resident));
+    std::size_t tracked{};
+    for (const auto& component : _components) {
+        /* The components without live usage are accounted by their plan */
+        const std::size_t used = component.usage ? component.usage() : component.bytes();
+        tracked += used;
+        fmt::format_to(it,
+                       "{}: units<{}/{}>, planned<{:.1f}>, used<{:.1f}{}>\n",
+                       component.demand.name,
+                       component.granted,
+                       component.demand.units,
+                       mib(component.bytes()),
+                       mib(used),
+                       component.usage ? "" : " (planned)");
+    }
+    fmt::format_to(it, "other: <{:.1f}>\n", mib(resident > tracked ? resident - tracked : 0));
+    return out;
+}
+
+std::size_t
+MemoryBudget::residentBytes()
+{
+    std::ifstream statm{"/proc/self/statm"};
+    std::size_t size{}, resident{};
+    if (not(statm >> size >> resident)) {
+        return 0;
+    }
+    return resident * static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+}
+
+std::size_t
+MemoryBudget::plannedLocked() const
+{
+    std::size_t total{};
+    for (const auto& component : _components) {
+        total += component.bytes();
+    }
+    return total;
+}
+
+} // namespace jar
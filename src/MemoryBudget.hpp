@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace jar {
+
+/* The memory requested by single component in units of equal size (frames, buffers, slots) */
+struct MemoryDemand {
+    std::string name;
+    /* The bytes of single unit */
+    std::size_t unitSize{};
+    /* The number of requested units */
+    std::size_t units{};
+    /* The minimal number of units (the component isn't adapted if it equals to requested) */
+    std::size_t minUnits{};
+    /* The bytes not depending on the number of units */
+    std::size_t fixed{};
+};
+
+/*
+ * Divides memory budget among components: the demands exceeding the budget are reduced
+ * proportionally down to their minimal number of units, the configuration which doesn't fit
+ * even then is refused. Keeps per-component accounting of planned and live used bytes (live
+ * usage is reported for components which provide it) along with resident size of process.
+ */
+class MemoryBudget {
+public:
+    using Usage = std::function<std::size_t()>;
+
+    /* The budget of zero means unlimited (only accounting) */
+    explicit MemoryBudget(std::size_t budget = 0);
+
+    void
+    demand(MemoryDemand demand);
+
+    /* Fit demands into the budget, returns false if minimal configuration doesn't fit */
+    [[nodiscard]] bool
+    plan();
+
+    /* Get the number of units granted to component (the requested number until planned) */
+    [[nodiscard]] std::size_t
+    granted(std::string_view name) const;
+
+    /* Set live usage of component */
+    void
+    track(std::string_view name, Usage usage);
+
+    /* Get the bytes planned for all components */
+    [[nodiscard]] std::size_t
+    planned() const;
+
+    [[nodiscard]] std::string
+    report() const;
+
+    /* Get the resident set size of process (bytes) */
+    [[nodiscard]] static std::size_t
+    residentBytes();
+
+private:
+    struct Component {
+        MemoryDemand demand;
+        std::size_t granted{};
+        Usage usage;
+
+        [[nodiscard]] std::size_t
+        bytes() const
+        {
+            return demand.fixed + demand.unitSize * granted;
+        }
+    };
+
+    [[nodiscard]] std::size_t
+    plannedLocked() const;
+
+private:
+    std::size_t _budget;
+    mutable std::mutex _guard;
+    std::vector<Component> _components;
+};
+
+} // namespace jar
@@ -0,0 +1,361 @@
+#pragma once
+
+#include <algorithm>
+#include <concepts>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/*
+ * Header-only framework of statically wired pipeline stages. The stages are composed at compile
+ * time into Pipeline, each hop is a direct (inlinable) call without virtual or signal dispatch:
+ *
+ *     Pipeline pipeline{Converter{}, Threaded<Frame, Analyzer>{Analyzer{}, 4}, Writer{}};
+ *     pipeline.push(frame);
+ *
+ * A stage receives input and emits zero or more outputs to the next stage, the last stage is
+ * a sink. The stages run inline on the caller thread by default, the stage wrapped into Threaded
+ * runs on its own thread behind bounded queue.
+ */
+
+namespace jar::pipeline {
+
+namespace detail {
+
+/* The probe of emit callable passed to stages */
+struct Emitter {
+    template<typename T>
+    void
+    operator()(T&&) const;
+};
+
+} // namespace detail
+
+/* Produces items by calling emit, returns false when exhausted */
+template<typename S>
+concept Source = requires(S source, detail::Emitter emit) {
+    { source.poll(emit) } -> std::same_as<bool>;
+};
+
+/* Transforms input into zero or more outputs passed to emit */
+template<typename S, typename In>
+concept Stage = requires(S stage, In input, detail::Emitter emit) {
+    stage.process(std::move(input), emit);
+};
+
+/* Consumes input at the end of pipeline */
+template<typename S, typename In>
+concept Sink = requires(S sink, In input) { sink.consume(std::move(input)); };
+
+/* The behaviour of threaded stage when its queue is full */
+enum class Overflow {
+    /* Block the upstream stage until there is free space (backpressure) */
+    Block,
+    /* Drop the incoming item (the upstream is never blocked) */
+    Drop,
+};
+
+/* Bounded FIFO queue between stages */
+template<typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(const std::size_t capacity)
+        : _items(std::max<std::size_t>(1, capacity))
+    {
+    }
+
+    /* Push item, blocks while queue is full (returns false on stop) */
+    bool
+    push(T item, const std::stop_token& token)
+    {
+        {
+            std::unique_lock lock{_guard};
+            if (not _whenNotFull.wait(lock, token, [this] { return _size < _items.size(); })) {
+                return false;
+            }
+            emplace(std::move(item));
+        }
+        _whenNotEmpty.notify_one();
+        return true;
+    }
+
+    /* Push item if there is free space */
+    bool
+    tryPush(T item)
+    {
+        {
+            std::scoped_lock lock{_guard};
+            if (_size == _items.size()) {
+                ++_dropped;
+                return false;
+            }
+            emplace(std::move(item));
+        }
+        _whenNotEmpty.notify_one();
+        return true;
+    }
+
+    /* Pop item, blocks while queue is empty (returns nothing on stop when queue is drained) */
+    std::optional<T>
+    pop(const std::stop_token& token)
+    {
+        std::optional<T> item;
+        {
+            std::unique_lock lock{_guard};
+            if (not _whenNotEmpty.wait(lock, token, [this] { return _size > 0; })) {
+                return std::nullopt;
+            }
+            item = std::move(_items[_head]);
+            _items[_head].reset();
+            _head = (_head + 1) % _items.size();
+            --_size;
+        }
+        _whenNotFull.notify_one();
+        return item;
+    }
+
+    [[nodiscard]] std::size_t
+    size() const
+    {
+        std::scoped_lock lock{_guard};
+        return _size;
+    }
+
+    [[nodiscard]] uint64_t
+    dropped() const
+    {
+        std::scoped_lock lock{_guard};
+        return _dropped;
+    }
+
+private:
+    void
+    emplace(T&& item)
+    {
+        _items[(_head + _size) % _items.size()].emplace(std::move(item));
+        ++_size;
+    }
+
+private:
+    std::vector<std::optional<T>> _items;
+    std::size_t _head{};
+    std::size_t _size{};
+    uint64_t _dropped{};
+    mutable std::mutex _guard;
+    std::condition_variable_any _whenNotEmpty;
+    std::condition_variable_any _whenNotFull;
+};
+
+/* Runs stage inline on the thread of upstream stage (same as bare stage) */
+template<typename S>
+struct Inline {
+    S stage;
+
+    template<typename In, typename Emit>
+    void
+    process(In&& input, Emit&& emit)
+    {
+        stage.process(std::forward<In>(input), std::forward<Emit>(emit));
+    }
+
+    template<typename In>
+    void
+    consume(In&& input)
+    {
+        stage.consume(std::forward<In>(input));
+    }
+};
+
+/* Runs stage on its own thread, the input items are passed through bounded queue */
+template<typename In, typename S>
+class Threaded {
+public:
+    using Input = In;
+
+    explicit Threaded(S stage,
+                      const std::size_t capacity = 8,
+                      const Overflow overflow = Overflow::Block)
+        : _stage{std::move(stage)}
+        , _queue{std::make_unique<BoundedQueue<In>>(capacity)}
+        , _overflow{overflow}
+    {
+    }
+
+    [[nodiscard]] S&
+    stage()
+    {
+        return _stage;
+    }
+
+    [[nodiscard]] BoundedQueue<In>&
+    queue()
+    {
+        return *_queue;
+    }
+
+    [[nodiscard]] Overflow
+    overflow() const
+    {
+        return _overflow;
+    }
+
+private:
+    S _stage;
+    std::unique_ptr<BoundedQueue<In>> _queue;
+    Overflow _overflow;
+};
+
+template<typename T>
+inline constexpr bool kIsThreaded = false;
+
+template<typename In, typename S>
+inline constexpr bool kIsThreaded<Threaded<In, S>> = true;
+
+/*
+ * Statically wired chain of stages. The pipeline owns threads of threaded stages, stopping
+ * (or destruction) drains queues from upstream to downstream.
+ */
+template<typename... Nodes>
+class Pipeline {
+public:
+    static_assert(sizeof...(Nodes) > 0, "Pipeline must have at least one stage");
+
+    explicit Pipeline(Nodes... nodes)
+        : _nodes{std::move(nodes)...}
+    {
+        startThreads(std::index_sequence_for<Nodes...>{});
+    }
+
+    Pipeline(const Pipeline&) = delete;
+    Pipeline&
+    operator=(const Pipeline&)
+        = delete;
+
+    ~Pipeline()
+    {
+        stop();
+    }
+
+    /* Push item into the first stage */
+    template<typename In>
+    void
+    push(In&& input)
+    {
+        pushTo<0>(std::forward<In>(input));
+    }
+
+    /* Pull all items from source into pipeline until source is exhausted or stop requested */
+    template<Source S>
+    void
+    drain(S& source, const std::stop_token& token = {})
+    {
+        const auto emit = [this](auto&& item) { push(std::forward<decltype(item)>(item)); };
+        while (not token.stop_requested() and source.poll(emit)) {
+        }
+    }
+
+    /* Stop threaded stages after processing of queued items */
+    void
+    stop()
+    {
+        /* The threads are ordered upstream first, so downstream still drains when joined */
+        for (auto& thread : _threads) {
+            thread.request_stop();
+            if (thread.joinable()) {
+                thread.join();
+            }
+        }
+        _threads.clear();
+    }
+
+    template<std::size_t I>
+    [[nodiscard]] auto&
+    node()
+    {
+        return std::get<I>(_nodes);
+    }
+
+private:
+    template<std::size_t... Is>
+    void
+    startThreads(std::index_sequence<Is...>)
+    {
+        (startThread<Is>(), ...);
+    }
+
+    template<std::size_t I>
+    void
+    startThread()
+    {
+        if constexpr (kIsThreaded<std::tuple_element_t<I, std::tuple<Nodes...>>>) {
+            _threads.emplace_back([this](const std::stop_token& token) {
+                auto& node = std::get<I>(_nodes);
+                /* Keep popping after stop is requested until the queue is drained */
+                while (true) {
+                    auto item = node.queue().pop(token);
+                    if (not item) {
+                        item = node.queue().pop(kStopped);
+                        if (not item) {
+                            break;
+                        }
+                    }
+                    run<I>(node.stage(), std::move(*item));
+                }
+            });
+        }
+    }
+
+    template<std::size_t I, typename In>
+    void
+    pushTo(In&& input)
+    {
+        auto& node = std::get<I>(_nodes);
+        using Node = std::remove_reference_t<decltype(node)>;
+        if constexpr (kIsThreaded<Node>) {
+            typename Node::Input item{std::forward<In>(input)};
+            if (node.overflow() == Overflow::Drop) {
+                node.queue().tryPush(std::move(item));
+            } else {
+                node.queue().push(std::move(item), {});
+            }
+        } else {
+            run<I>(node, std::forward<In>(input));
+        }
+    }
+
+    template<std::size_t I, typename S, typename In>
+    void
+    run(S& stage, In&& input)
+    {
+        if constexpr (I + 1 == sizeof...(Nodes)) {
+            static_assert(Sink<S, std::remove_cvref_t<In>>, "The last stage must be a sink");
+            stage.consume(std::forward<In>(input));
+        } else {
+            static_assert(Stage<S, std::remove_cvref_t<In>>, "The stage must process input");
+            stage.process(std::forward<In>(input), [this](auto&& output) {
+                pushTo<I + 1>(std::forward<decltype(output)>(output));
+            });
+        }
+    }
+
+private:
+    /* The stop token in stopped state used to drain queues without waiting */
+    inline static const std::stop_token kStopped = [] {
+        std::stop_source source;
+        source.request_stop();
+        return source.get_token();
+    }();
+
+    std::tuple<Nodes...> _nodes;
+    std::vector<std::jthread> _threads;
+};
+
+} // namespace jar::pipeline
@@ -0,0 +1,179 @@
+#include <boost/program_options.hpp>
+
+#include "Pipeline.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+
+namespace po = boost::program_options;
+
+static constexpr uint64_t kDefaultItems = 10'000'000;
+static constexpr std::size_t kDefaultQueueSize = 1024;
+
+namespace jar {
+
+namespace {
+
+/* Keeps value opaque to optimizer, so the chain of hops isn't folded */
+inline void
+opaque(uint64_t& value)
+{
+    asm volatile("" : "+r"(value));
+}
+
+struct Increment {
+    template<typename Emit>
+    void
+    process(uint64_t value, Emit&& emit)
+    {
+        opaque(value);
+        emit(value + 1);
+    }
+};
+
+struct Accumulate {
+    uint64_t* sum{};
+
+    void
+    consume(uint64_t value)
+    {
+        *sum += value;
+    }
+};
+
+} // namespace
+
+/*
+ * Measures per-item cost of pipeline hops: four inline hops (static wiring), four hops through
+ * std::function (the cost of type-erased wiring like signals) and single threaded hop through
+ * bounded queue (including the drain on stop).
+ */
+class PipelineBench {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    [[nodiscard]] bool
+    parseArgs(const int argc, char* argv[])
+    {
+        po::options_description d{"RawEnc pipeline benchmark CLI"};
+        // clang-format off
+        d.add_options()
+            ("help,h", "Display help")
+            ("items", po::value<uint64_t>()->notifier([this](const uint64_t v) {
+                _items = v;
+            })->default_value(kDefaultItems), "Set the number of items pushed per mode")
+            ("queue-size", po::value<std::size_t>()->notifier([this](const std::size_t v) {
+                _queueSize = v;
+            })->default_value(kDefaultQueueSize), "Set the queue size of threaded hop")
+        ;
+        // clang-format on
+
+        po::variables_map vm;
+        po::store(po::parse_command_line(argc, argv, d), vm);
+        if (vm.contains("help")) {
+            std::cout << d << std::endl;
+            return false;
+        }
+        po::notify(vm);
+        return true;
+    }
+
+    [[nodiscard]] bool
+    run()
+    {
+        if (_items == 0) {
+            std::cerr << "No items to push\n";
+            return false;
+        }
+        return measureInline() and measureFunction() and measureThreaded();
+    }
+
+private:
+    [[nodiscard]] bool
+    measureInline()
+    {
+        uint64_t sum{};
+        const auto begin = Clock::now();
+        {
+            pipeline::Pipeline pipeline{
+                Increment{}, Increment{}, Increment{}, Increment{}, Accumulate{&sum}};
+            for (uint64_t n = 0; n < _items; ++n) {
+                pipeline.push(n);
+            }
+        }
+        return report("inline", 4, Clock::now() - begin, sum);
+    }
+
+    [[nodiscard]] bool
+    measureFunction()
+    {
+        uint64_t sum{};
+        const auto begin = Clock::now();
+        {
+            std::function<void(uint64_t)> hops{[&sum](const uint64_t value) { sum += value; }};
+            for (int hop = 0; hop < 4; ++hop) {
+                hops = [next = std::move(hops)](uint64_t value) {
+                    opaque(value);
+                    next(value + 1);
+                };
+            }
+            for (uint64_t n = 0; n < _items; ++n) {
+                hops(n);
+            }
+        }
+        return report("function", 4, Clock::now() - begin, sum);
+    }
+
+    [[nodiscard]] bool
+    measureThreaded()
+    {
+        uint64_t sum{};
+        const auto begin = Clock::now();
+        {
+            pipeline::Pipeline pipeline{
+                pipeline::Threaded<uint64_t, Accumulate>{Accumulate{&sum}, _queueSize}};
+            for (uint64_t n = 0; n < _items; ++n) {
+                pipeline.push(n);
+            }
+        }
+        return report("threaded", 0, Clock::now() - begin, sum);
+    }
+
+    [[nodiscard]] bool
+    report(const char* mode,
+           const unsigned increments,
+           const Clock::duration elapsed,
+           const uint64_t sum) const
+    {
+        const uint64_t expected = _items * (_items - 1) / 2 + _items * increments;
+        const double ns = std::chrono::duration<double, std::nano>{elapsed}.count();
+        std::cout << std::left << std::setw(10) << mode << std::fixed << std::setprecision(2)
+                  << "per-item<" << ns / static_cast<double>(_items) << "ns>\n";
+        if (sum != expected) {
+            std::cerr << "Invalid sum of <" << mode << "> mode: " << sum << " != " << expected
+                      << "\n";
+            return false;
+        }
+        return true;
+    }
+
+private:
+    uint64_t _items{kDefaultItems};
+    std::size_t _queueSize{kDefaultQueueSize};
+};
+
+} // namespace jar
+
+int
+main(int argc, char* argv[])
+{
+    jar::PipelineBench app;
+    if (not app.parseArgs(argc, argv)) {
+        /* Show help menu and exit */
+        return EXIT_SUCCESS;
+    }
+    return app.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,216 @@
+#include "PreRollBuffer.hpp"
+
+#include "Logger.hpp"
+
+#include <cstring>
+
+namespace jar {
+
+namespace {
+
+/* The maximum number of GOPs kept in the ring */
+constexpr std::size_t kMaxKeyframes = 1024;
+/* The alignment of records in the arena */
+constexpr std::size_t kAlignment = 8;
+
+constexpr uint32_t kKeyFlag = 0x01;
+constexpr uint32_t kWrapFlag = 0x02;
+
+constexpr std::size_t
+alignUp(const std::size_t value)
+{
+    return (value + kAlignment - 1) & ~(kAlignment - 1);
+}
+
+} // namespace
+
+struct PreRollBuffer::Record {
+    uint32_t size{};
+    uint32_t flags{};
+    int64_t pts{};
+    int64_t dts{};
+    int64_t timestamp{};
+};
+
+PreRollBuffer::PreRollBuffer(const PreRollConfig& config)
+    : _config{config}
+    , _capacity{config.budget & ~(kAlignment - 1)}
+    , _keyframes(kMaxKeyframes)
+{
+    _arena = std::make_unique<uint8_t[]>(_capacity);
+}
+
+void
+PreRollBuffer::push(const EncodedPacket& packet)
+{
+    const std::size_t size = recordSize(packet.size);
+    if (size > _capacity) {
+        LOGW_LIMITED("Packet doesn't fit pre-roll budget: {} > {}", size, _capacity);
+        return;
+    }
+
+    const auto now = Clock::now();
+    {
+        std::scoped_lock lock{_guard};
+
+        evictExpired(now);
+        if (packet.key and _keyframesSize == _keyframes.size()) {
+            evictGop();
+        }
+
+        uint64_t position{};
+        while (true) {
+            if (_keyframesSize == 0 and not packet.key) {
+                /* The ring must always start with keyframe */
+                return;
+            }
+            position = alignPosition(_head, size);
+            if (position + size - _tail <= _capacity) {
+                break;
+            }
+            if (_keyframesSize == 0) {
+                /* The ring is empty and starts at arena boundary, nothing is left to evict */
+                LOGW_LIMITED("Packet doesn't fit pre-roll ring: {} > {}", size, _capacity);
+                return;
+            }
+            evictGop();
+        }
+
+        if (position != _head) {
+            if (const std::size_t rest = position - _head; rest >= sizeof(Record)) {
+                const Record marker{.flags = kWrapFlag};
+                std::memcpy(&_arena[_head % _capacity], &marker, sizeof(Record));
+            }
+        }
+
+        const Record record{
+            .size = static_cast<uint32_t>(packet.size),
+            .flags = packet.key ? kKeyFlag : 0u,
+            .pts = packet.pts,
+            .dts = packet.dts,
+            .timestamp = now.time_since_epoch().count(),
+        };
+        uint8_t* const ptr = &_arena[position % _capacity];
+        std::memcpy(ptr, &record, sizeof(Record));
+        std::memcpy(ptr + sizeof(Record), packet.data, packet.size);
+
+        if (packet.key) {
+            _keyframes[(_keyframesHead + _keyframesSize) % _keyframes.size()] = {
+                .position = position,
+                .timestamp = now,
+            };
+            ++_keyframesSize;
+        }
+        _head = position + size;
+    }
+    _whenPushed.notify_all();
+}
+
+uint64_t
+PreRollBuffer::tail() const
+{
+    std::scoped_lock lock{_guard};
+    return _tail;
+}
+
+PreRollBuffer::ReadResult
+PreRollBuffer::read(uint64_t& cursor,
+                    std::vector<uint8_t>& payload,
+                    PacketInfo& info,
+                    const std::chrono::milliseconds timeout,
+                    const std::stop_token& token)
+{
+    std::unique_lock lock{_guard};
+    while (true) {
+        if (cursor < _tail) {
+            cursor = _tail;
+            return ReadResult::Overrun;
+        }
+        if (cursor >= _head) {
+            _whenPushed.wait_for(lock, token, timeout, [&] { return cursor < _head; });
+            if (token.stop_requested()) {
+                return ReadResult::Stopped;
+            }
+            if (cursor >= _head) {
+                return ReadResult::Timeout;
+            }
+            continue;
+        }
+
+        const std::size_t offset = cursor % _capacity;
+        const std::size_t rest = _capacity - offset;
+        if (rest < sizeof(Record)) {
+            cursor += rest;
+            continue;
+        }
+
+        Record record;
+        std::memcpy(&record, &_arena[offset], sizeof(Record));
+        if (record.flags & kWrapFlag) {
+            cursor += rest;
+            continue;
+        }
+
+        const uint8_t* const data = &_arena[offset + sizeof(Record)];
+        payload.assign(data, data + record.size);
+        info = {
+            .pts = record.pts,
+            .dts = record.dts,
+            .key = (record.flags & kKeyFlag) != 0,
+            .timestamp = Clock::time_point{Clock::duration{record.timestamp}},
+        };
+        cursor += recordSize(record.size);
+        return ReadResult::Ok;
+    }
+}
+
+std::size_t
+PreRollBuffer::recordSize(const std::size_t payloadSize) const
+{
+    return alignUp(sizeof(Record) + payloadSize);
+}
+
+uint64_t
+PreRollBuffer::alignPosition(const uint64_t position, const std::size_t size) const
+{
+    const std::size_t rest = _capacity - position % _capacity;
+    return (size <= rest) ? position : position + rest;
+}
+
+void
+PreRollBuffer::evictGop()
+{
+    if (_keyframesSize > 1) {
+        _keyframesHead = (_keyframesHead + 1) % _keyframes.size();
+        --_keyframesSize;
+        _tail = _keyframes[_keyframesHead].position;
+    } else {
+        reset();
+    }
+}
+
+void
+PreRollBuffer::evictExpired(const Clock::time_point now)
+{
+    while (_keyframesSize > 1) {
+        const auto& next = _keyframes[(_keyframesHead + 1) % _keyframes.size()];
+        if (next.timestamp > now - _config.duration) {
+            break;
+        }
+        evictGop();
+    }
+}
+
+void
+PreRollBuffer::reset()
+{
+    /* The empty ring starts at arena boundary, so any packet within capacity fits */
+    if (const std::size_t offset = _head % _capacity; offset != 0) {
+        _head += _capacity - offset;
+    }
+    _tail = _head;
+    _keyframesHead = 0;
+    _keyframesSize = 0;
+}
+
+} // namespace jar
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "Encoder.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <vector>
+
+namespace jar {
+
+struct PreRollConfig {
+    /* The minimal duration of encoded stream to keep before trigger */
+    std::chrono::milliseconds duration{std::chrono::seconds{5}};
+    /* The memory budget (bytes) of the ring, allocated once */
+    std::size_t budget{32u * 1024u * 1024u};
+};
+
+/*
+ * Ring of encoded packets stored in single preallocated arena. The oldest packet in the ring
+ * is always a keyframe: packets are evicted by whole GOPs either when the budget is exhausted
+ * or when the ring holds more than configured duration. Readers walk the ring by logical
+ * byte position (cursor) which survives wrapping of the arena.
+ */
+class PreRollBuffer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct PacketInfo {
+        int64_t pts{};
+        int64_t dts{};
+        bool key{};
+        Clock::time_point timestamp;
+    };
+
+    enum class ReadResult { Ok, Timeout, Overrun, Stopped };
+
+    explicit PreRollBuffer(const PreRollConfig& config);
+
+    /* Append packet to the ring (writer side, e.g. encoder thread) */
+    void
+    push(const EncodedPacket& packet);
+
+    /* Get position of the oldest packet (always keyframe) */
+    [[nodiscard]] uint64_t
+    tail() const;
+
+    /*
+     * Copy packet at given cursor into payload and advance the cursor. Waits up to timeout
+     * for new packet. On overrun (the reader was too slow) cursor is moved to the oldest
+     * keyframe in the ring.
+     */
+    [[nodiscard]] ReadResult
+    read(uint64_t& cursor,
+         std::vector<uint8_t>& payload,
+         PacketInfo& info,
+         std::chrono::milliseconds timeout,
+         const std::stop_token& token);
+
+private:
+    struct Record;
+
+    struct Keyframe {
+        uint64_t position{};
+        Clock::time_point timestamp;
+    };
+
+    [[nodiscard]] std::size_t
+    recordSize(std::size_t payloadSize) const;
+
+    [[nodiscard]] uint64_t
+    alignPosition(uint64_t position, std::size_t size) const;
+
+    void
+    evictGop();
+
+    void
+    evictExpired(Clock::time_point now);
+
+    void
+    reset();
+
+private:
+    PreRollConfig _config;
+    std::unique_ptr<uint8_t[]> _arena;
+    std::size_t _capacity{};
+    std::vector<Keyframe> _keyframes;
+    std::size_t _keyframesHead{};
+    std::size_t _keyframesSize{};
+    uint64_t _head{};
+    uint64_t _tail{};
+    mutable std::mutex _guard;
+    std::condition_variable_any _whenPushed;
+};
+
+} // namespace jar
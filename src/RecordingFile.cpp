@@ -0,0 +1,108 @@
+#include "RecordingFile.hpp"
+
+#include "Logger.hpp"
+
+#include <cstring>
+
+namespace jar {
+
+RecordingFile::~RecordingFile()
+{
+    close();
+}
+
+bool
+RecordingFile::open(const std::filesystem::path& path,
+                    const int32_t timeBaseNum,
+                    const int32_t timeBaseDen,
+                    FileSink* sink)
+{
+    close();
+
+    if (sink) {
+        if (_stream = sink->open(path); not _stream) {
+            return false;
+        }
+        _sink = sink;
+    } else {
+        _file = fopen(path.c_str(), "wb");
+        if (not _file) {
+            LOGE("Unable to open <{}> file: {}", path, strerror(errno));
+            return false;
+        }
+    }
+    if (not _index.open(keyframeIndexPath(path), timeBaseNum, timeBaseDen)) {
+        /* The recording itself is still usable without index */
+        LOGW("Unable to create index for <{}> file", path);
+    }
+
+    _path = path;
+    _bytes = _keyframes = 0;
+    return true;
+}
+
+void
+RecordingFile::close()
+{
+    if (_file) {
+        fclose(_file);
+        _file = nullptr;
+    }
+    if (_sink) {
+        _sink->close(*_stream);
+        _sink = nullptr;
+        _stream.reset();
+    }
+    _index.close();
+}
+
+bool
+RecordingFile::write(const uint8_t* data,
+                     const std::size_t size,
+                     const int64_t pts,
+                     const bool key,
+                     const WallClock::time_point time)
+{
+    if (_sink) {
+        /* The packet is dropped entirely if sink has no room, so offsets stay consistent */
+        if (not _sink->write(*_stream, data, size)) {
+            return false;
+        }
+    } else if (not _file) {
+        return false;
+    } else if (fwrite(data, 1, size, _file) != size or fflush(_file) != 0) {
+        LOGE_LIMITED("Unable to write <{}> file: {}", _path, strerror(errno));
+        return false;
+    }
+    if (key) {
+        /*
+         * The index entry is added after the packet is flushed (or queued into sink, then it may
+         * point beyond EOF until the sink writes the packet)
+         */
+        const auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+            time.time_since_epoch());
+        _index.add(KeyframeIndexEntry{
+            .pts = pts,
+            .time = us.count(),
+            .offset = _bytes,
+            .size = static_cast<uint32_t>(size),
+        });
+        ++_keyframes;
+    }
+    _bytes += size;
+    return true;
+}
+
+uint64_t
+RecordingFile::bytes() const
+{
+    return _bytes;
+}
+
+uint64_t
+RecordingFile::keyframes() const
+{
+    return _keyframes;
+}
+
+} // namespace jar
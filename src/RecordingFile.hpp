@@ -0,0 +1,64 @@
+#pragma once
+
+#include "FileSink.hpp"
+#include "KeyframeIndex.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <optional>
+
+namespace jar {
+
+/*
+ * Writes encoded packets into file and maintains keyframe index next to it ("<file>.idx").
+ * Every keyframe gets index entry with its pts, wall-clock time and byte offset in the file.
+ * The packets are written either directly or through shared file sink (see FileSink).
+ */
+class RecordingFile {
+public:
+    using WallClock = std::chrono::system_clock;
+
+    RecordingFile() = default;
+
+    ~RecordingFile();
+
+    RecordingFile(const RecordingFile&) = delete;
+    RecordingFile&
+    operator=(const RecordingFile&)
+        = delete;
+
+    /* Open recording file, pts of packets are in given (num/den seconds) time base */
+    [[nodiscard]] bool
+    open(const std::filesystem::path& path,
+         int32_t timeBaseNum,
+         int32_t timeBaseDen,
+         FileSink* sink = nullptr);
+
+    void
+    close();
+
+    [[nodiscard]] bool
+    write(const uint8_t* data,
+          std::size_t size,
+          int64_t pts,
+          bool key,
+          WallClock::time_point time = WallClock::now());
+
+    [[nodiscard]] uint64_t
+    bytes() const;
+
+    [[nodiscard]] uint64_t
+    keyframes() const;
+
+private:
+    std::filesystem::path _path;
+    FILE* _file{};
+    FileSink* _sink{};
+    std::optional<FileSink::StreamId> _stream;
+    KeyframeIndexWriter _index;
+    uint64_t _bytes{};
+    uint64_t _keyframes{};
+};
+
+} // namespace jar
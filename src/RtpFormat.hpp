@@ -0,0 +1,82 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace jar {
+
+/* The size of fixed RTP header (RFC 3550, no CSRC and extensions) */
+inline constexpr std::size_t kRtpHeaderSize = 12;
+/* The RTP clock rate of video payloads (RFC 6184, RFC 7798) */
+inline constexpr uint32_t kRtpClockRate = 90000;
+
+/* H.264 NAL unit and payload types (RFC 6184) */
+inline constexpr uint8_t kH264Sps = 7;
+inline constexpr uint8_t kH264Pps = 8;
+inline constexpr uint8_t kH264StapA = 24;
+inline constexpr uint8_t kH264FuA = 28;
+
+/* H.265 NAL unit and payload types (RFC 7798) */
+inline constexpr uint8_t kH265Vps = 32;
+inline constexpr uint8_t kH265Sps = 33;
+inline constexpr uint8_t kH265Pps = 34;
+inline constexpr uint8_t kH265Ap = 48;
+inline constexpr uint8_t kH265Fu = 49;
+
+enum class RtpCodec { H264, H265 };
+
+struct RtpHeader {
+    bool marker{};
+    uint8_t payloadType{};
+    uint16_t sequence{};
+    uint32_t timestamp{};
+    uint32_t ssrc{};
+};
+
+inline void
+writeRtpHeader(uint8_t* output, const RtpHeader& header)
+{
+    output[0] = 0x80; /* Version 2, no padding, extensions and CSRC */
+    output[1] = static_cast<uint8_t>((header.marker ? 0x80 : 0x00) | (header.payloadType & 0x7F));
+    output[2] = static_cast<uint8_t>(header.sequence >> 8);
+    output[3] = static_cast<uint8_t>(header.sequence);
+    output[4] = static_cast<uint8_t>(header.timestamp >> 24);
+    output[5] = static_cast<uint8_t>(header.timestamp >> 16);
+    output[6] = static_cast<uint8_t>(header.timestamp >> 8);
+    output[7] = static_cast<uint8_t>(header.timestamp);
+    output[8] = static_cast<uint8_t>(header.ssrc >> 24);
+    output[9] = static_cast<uint8_t>(header.ssrc >> 16);
+    output[10] = static_cast<uint8_t>(header.ssrc >> 8);
+    output[11] = static_cast<uint8_t>(header.ssrc);
+}
+
+[[nodiscard]] inline bool
+readRtpHeader(const uint8_t* input, const std::size_t size, RtpHeader& header)
+{
+    if (size < kRtpHeaderSize or (input[0] & 0xC0) != 0x80) {
+        return false;
+    }
+    header.marker = (input[1] & 0x80) != 0;
+    header.payloadType = input[1] & 0x7F;
+    header.sequence = static_cast<uint16_t>(input[2] << 8 | input[3]);
+    header.timestamp = uint32_t{input[4]} << 24 | uint32_t{input[5]} << 16
+                       | uint32_t{input[6]} << 8 | uint32_t{input[7]};
+    header.ssrc = uint32_t{input[8]} << 24 | uint32_t{input[9]} << 16 | uint32_t{input[10]} << 8
+                  | uint32_t{input[11]};
+    return true;
+}
+
+/*
+ * The RTP timestamp derived from wall clock (instead of random offset), so the receiver on
+ * the same host (or with synchronized clock) can measure one-way latency.
+ */
+[[nodiscard]] inline uint32_t
+rtpWallClock(const std::chrono::system_clock::time_point time = std::chrono::system_clock::now())
+{
+    const auto us
+        = std::chrono::duration_cast<std::chrono::microseconds>(time.time_since_epoch()).count();
+    return static_cast<uint32_t>(static_cast<uint64_t>(us) * 9 / 100);
+}
+
+} // namespace jar
@@ -0,0 +1,188 @@
+#include "RtpPacketizer.hpp"
+
+#include "AnnexB.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+namespace jar {
+
+RtpPacketizer::RtpPacketizer(const RtpCodec codec,
+                             const std::size_t maxPacketSize,
+                             const uint8_t payloadType,
+                             const uint32_t ssrc)
+    : _codec{codec}
+    , _maxPayloadSize{maxPacketSize - kRtpHeaderSize}
+    , _payloadType{payloadType}
+    , _ssrc{ssrc}
+    , _sequence{static_cast<uint16_t>(ssrc >> 16)}
+{
+    assert(maxPacketSize > kRtpHeaderSize + 3);
+}
+
+std::span<const RtpPacket>
+RtpPacketizer::packetize(const uint8_t* data, const std::size_t size, const uint32_t timestamp)
+{
+    _timestamp = timestamp;
+    _headers.clear();
+    _pending.clear();
+    _packets.clear();
+
+    splitNals(data, size);
+    for (std::size_t n = 0; n < _nals.size();) {
+        if (const std::size_t count = aggregate(n); count > 0) {
+            n += count;
+            continue;
+        }
+        if (const Nal& nal = _nals[n]; nal.size <= _maxPayloadSize) {
+            addPacket(nullptr, 0, nal.data, nal.size);
+        } else {
+            fragment(nal);
+        }
+        ++n;
+    }
+
+    /* The header storage is stable now, so resolve pointers and set marker */
+    _packets.reserve(_pending.size());
+    for (const Pending& pending : _pending) {
+        _packets.push_back({
+            .header = _headers.data() + pending.headerOffset,
+            .headerSize = pending.headerSize,
+            .payload = pending.payload,
+            .payloadSize = pending.payloadSize,
+        });
+    }
+    if (not _pending.empty()) {
+        _headers[_pending.back().headerOffset + 1] |= 0x80;
+    }
+    return _packets;
+}
+
+void
+RtpPacketizer::splitNals(const uint8_t* data, const std::size_t size)
+{
+    _nals.clear();
+    forEachNal(data, size, [this](const uint8_t* nal, const std::size_t nalSize) {
+        _nals.push_back({nal, nalSize});
+        return true;
+    });
+}
+
+bool
+RtpPacketizer::isParameterSet(const Nal& nal) const
+{
+    if (_codec == RtpCodec::H264) {
+        const uint8_t type = nal.data[0] & 0x1F;
+        return (type == kH264Sps or type == kH264Pps);
+    }
+    const uint8_t type = (nal.data[0] >> 1) & 0x3F;
+    return (nal.size >= 2 and (type == kH265Vps or type == kH265Sps or type == kH265Pps));
+}
+
+std::size_t
+RtpPacketizer::aggregate(const std::size_t index)
+{
+    /* Aggregate at least two consecutive parameter sets fitting into single packet */
+    const std::size_t aggregateHeader = nalHeaderSize();
+    std::size_t count{}, payloadSize{aggregateHeader};
+    for (std::size_t n = index; n < _nals.size() and isParameterSet(_nals[n]); ++n) {
+        if (payloadSize + 2 + _nals[n].size > _maxPayloadSize) {
+            break;
+        }
+        payloadSize += 2 + _nals[n].size;
+        ++count;
+    }
+    if (count < 2) {
+        return 0;
+    }
+
+    _aggregate.resize(payloadSize);
+    uint8_t* output = _aggregate.data();
+    if (_codec == RtpCodec::H264) {
+        /* F bit and the highest NRI of aggregated units */
+        uint8_t nri{};
+        for (std::size_t n = index; n < index + count; ++n) {
+            nri = std::max<uint8_t>(nri, _nals[n].data[0] & 0x60);
+        }
+        *output++ = nri | kH264StapA;
+    } else {
+        /* The layer id and temporal id of the first unit (parameter sets share them) */
+        *output++ = static_cast<uint8_t>((_nals[index].data[0] & 0x81) | (kH265Ap << 1));
+        *output++ = _nals[index].data[1];
+    }
+    for (std::size_t n = index; n < index + count; ++n) {
+        const Nal& nal = _nals[n];
+        *output++ = static_cast<uint8_t>(nal.size >> 8);
+        *output++ = static_cast<uint8_t>(nal.size);
+        output = std::copy_n(nal.data, nal.size, output);
+    }
+
+    addPacket(_aggregate.data(), _aggregate.size(), nullptr, 0);
+    return count;
+}
+
+void
+RtpPacketizer::fragment(const Nal& nal)
+{
+    const std::size_t headerSize = nalHeaderSize();
+    const std::size_t fuHeaderSize = headerSize + 1;
+    const uint8_t* payload = nal.data + headerSize;
+    std::size_t remaining = nal.size - headerSize;
+
+    /* Equally sized fragments (except the last) allow sending them as single GSO message */
+    const std::size_t fragmentSize = _maxPayloadSize - fuHeaderSize;
+    uint8_t fu[3];
+    uint8_t type{};
+    if (_codec == RtpCodec::H264) {
+        fu[0] = static_cast<uint8_t>((nal.data[0] & 0xE0) | kH264FuA);
+        type = nal.data[0] & 0x1F;
+    } else {
+        fu[0] = static_cast<uint8_t>((nal.data[0] & 0x81) | (kH265Fu << 1));
+        fu[1] = nal.data[1];
+        type = (nal.data[0] >> 1) & 0x3F;
+    }
+
+    bool first{true};
+    while (remaining > 0) {
+        const std::size_t size = std::min(fragmentSize, remaining);
+        const bool last = (size == remaining);
+        fu[headerSize] = static_cast<uint8_t>((first ? 0x80 : 0x00) | (last ? 0x40 : 0x00) | type);
+        addPacket(fu, fuHeaderSize, payload, size);
+        payload += size, remaining -= size;
+        first = false;
+    }
+}
+
+void
+RtpPacketizer::addPacket(const uint8_t* header,
+                         const std::size_t headerSize,
+                         const uint8_t* payload,
+                         const std::size_t payloadSize)
+{
+    const std::size_t offset = _headers.size();
+    _headers.resize(offset + kRtpHeaderSize + headerSize);
+    std::copy_n(header, headerSize, _headers.data() + offset + kRtpHeaderSize);
+
+    writeRtpHeader(_headers.data() + offset,
+                   {
+                       .marker = false,
+                       .payloadType = _payloadType,
+                       .sequence = _sequence++,
+                       .timestamp = _timestamp,
+                       .ssrc = _ssrc,
+                   });
+    _pending.push_back({
+        .headerOffset = offset,
+        .headerSize = kRtpHeaderSize + headerSize,
+        .payload = payload,
+        .payloadSize = payloadSize,
+    });
+}
+
+std::size_t
+RtpPacketizer::nalHeaderSize() const
+{
+    return (_codec == RtpCodec::H264) ? 1 : 2;
+}
+
+} // namespace jar
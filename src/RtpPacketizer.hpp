@@ -0,0 +1,90 @@
+#pragma once
+
+#include "RtpFormat.hpp"
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace jar {
+
+/*
+ * The RTP packet made of header part (RTP header with payload header, or whole aggregation
+ * packet) and optional payload part pointing into the bitstream (not copied).
+ */
+struct RtpPacket {
+    const uint8_t* header{};
+    std::size_t headerSize{};
+    const uint8_t* payload{};
+    std::size_t payloadSize{};
+
+    [[nodiscard]] std::size_t
+    size() const
+    {
+        return headerSize + payloadSize;
+    }
+};
+
+/*
+ * Packetizes H.264 (RFC 6184) and H.265 (RFC 7798) Annex-B access units. The NAL units which
+ * fit into packet are sent as is, larger ones are fragmented into equally sized FU-A (FU)
+ * packets (except the last one), consecutive parameter sets are aggregated into single STAP-A
+ * (AP) packet. The marker bit is set on the last packet of access unit.
+ */
+class RtpPacketizer {
+public:
+    RtpPacketizer(RtpCodec codec, std::size_t maxPacketSize, uint8_t payloadType, uint32_t ssrc);
+
+    /* Packetize access unit (the packets are valid until the next call) */
+    [[nodiscard]] std::span<const RtpPacket>
+    packetize(const uint8_t* data, std::size_t size, uint32_t timestamp);
+
+private:
+    struct Nal {
+        const uint8_t* data{};
+        std::size_t size{};
+    };
+
+    struct Pending {
+        std::size_t headerOffset{};
+        std::size_t headerSize{};
+        const uint8_t* payload{};
+        std::size_t payloadSize{};
+    };
+
+    void
+    splitNals(const uint8_t* data, std::size_t size);
+
+    [[nodiscard]] bool
+    isParameterSet(const Nal& nal) const;
+
+    [[nodiscard]] std::size_t
+    aggregate(std::size_t index);
+
+    void
+    fragment(const Nal& nal);
+
+    void
+    addPacket(const uint8_t* header,
+              std::size_t headerSize,
+              const uint8_t* payload,
+              std::size_t payloadSize);
+
+    [[nodiscard]] std::size_t
+    nalHeaderSize() const;
+
+private:
+    RtpCodec _codec;
+    std::size_t _maxPayloadSize;
+    uint8_t _payloadType;
+    uint32_t _ssrc;
+    uint16_t _sequence{};
+    uint32_t _timestamp{};
+    std::vector<Nal> _nals;
+    std::vector<uint8_t> _headers;
+    std::vector<uint8_t> _aggregate;
+    std::vector<Pending> _pending;
+    std::vector<RtpPacket> _packets;
+};
+
+} // namespace jar
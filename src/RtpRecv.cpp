@@ -0,0 +1,375 @@
+#include <boost/program_options.hpp>
+
+#include "RtpFormat.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <vector>
+
+namespace po = boost::program_options;
+
+/* General defaults */
+static const char* kDefaultAddress{"0.0.0.0"};
+static uint16_t kDefaultPort = 5004;
+static const char* kDefaultCodec{"h264"};
+static unsigned kDefaultInterval = 1;
+
+/* The number of datagrams received by single call and the maximum datagram size */
+static constexpr std::size_t kBatchSize = 64;
+static constexpr std::size_t kMaxDatagramSize = 2048;
+/* The socket receive buffer size to absorb bursts of keyframes */
+static constexpr int kReceiveBufferSize = 4 * 1024 * 1024;
+
+static std::atomic_bool gTerminated{false};
+
+namespace jar {
+
+/*
+ * Receives RTP stream sent by rawenc on loopback (or any other host with synchronized clock),
+ * reports packet loss and latency from capture to receive (the RTP timestamp is capture time),
+ * optionally depacketizes stream into Annex-B file.
+ */
+class RtpRecv {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    [[nodiscard]] bool
+    parseArgs(const int argc, char* argv[])
+    {
+        po::options_description d{"RawEnc RTP receiver CLI"};
+        // clang-format off
+        d.add_options()
+            ("help,h", "Display help")
+            ("address", po::value<std::string>()->notifier([this](const std::string& v) {
+                _address = v;
+            })->default_value(kDefaultAddress), "Set local address to bind")
+            ("port", po::value<uint16_t>()->notifier([this](const uint16_t v) {
+                _port = v;
+            })->default_value(kDefaultPort), "Set local port to bind")
+            ("codec", po::value<std::string>()->notifier([this](const std::string& v) {
+                if (v != "h264" and v != "h265") {
+                    throw po::validation_error{po::validation_error::invalid_option_value,
+                                               "codec", v};
+                }
+                _codec = (v == "h265") ? RtpCodec::H265 : RtpCodec::H264;
+            })->default_value(kDefaultCodec), "Set stream codec (h264, h265)")
+            ("output", po::value<std::string>()->notifier([this](const std::string& v) {
+                _output.open(v, std::ios::binary);
+            }), "Write depacketized Annex-B stream to file")
+            ("duration", po::value<unsigned>()->notifier([this](const unsigned v) {
+                _duration = std::chrono::seconds{v};
+            }), "Stop after given duration (sec)")
+            ("interval", po::value<unsigned>()->notifier([this](const unsigned v) {
+                _interval = std::chrono::seconds{std::max(1u, v)};
+            })->default_value(kDefaultInterval), "Set report interval (sec)")
+            ("max-loss", po::value<double>()->notifier([this](const double v) {
+                _maxLoss = v;
+            }), "Fail if packet loss exceeds given value (%)")
+            ("max-latency", po::value<double>()->notifier([this](const double v) {
+                _maxLatency = v;
+            }), "Fail if 99th percentile of capture to receive latency exceeds given value (ms)")
+        ;
+        // clang-format on
+
+        po::variables_map vm;
+        po::store(po::parse_command_line(argc, argv, d), vm);
+        if (vm.contains("help")) {
+            std::cout << d << std::endl;
+            return false;
+        }
+        po::notify(vm);
+        return true;
+    }
+
+    [[nodiscard]] bool
+    run()
+    {
+        if (not open()) {
+            return false;
+        }
+
+        std::vector<uint8_t> storage(kBatchSize * kMaxDatagramSize);
+        std::vector<iovec> iovs(kBatchSize);
+        std::vector<mmsghdr> messages(kBatchSize);
+
+        const auto start = Clock::now();
+        auto reportTime = start + _interval;
+        while (not gTerminated and (not _duration or Clock::now() - start < *_duration)) {
+            for (std::size_t n = 0; n < kBatchSize; ++n) {
+                iovs[n] = {storage.data() + n * kMaxDatagramSize, kMaxDatagramSize};
+                messages[n] = {};
+                messages[n].msg_hdr.msg_iov = &iovs[n];
+                messages[n].msg_hdr.msg_iovlen = 1;
+            }
+
+            const int rv = recvmmsg(_fd, messages.data(), kBatchSize, MSG_WAITFORONE, nullptr);
+            if (rv == -1 and errno != EAGAIN and errno != EINTR) {
+                std::cerr << "Unable to receive: " << strerror(errno) << '\n';
+                break;
+            }
+            for (int n = 0; n < rv; ++n) {
+                handlePacket(storage.data() + n * kMaxDatagramSize, messages[n].msg_len);
+            }
+
+            if (Clock::now() >= reportTime) {
+                report(_interval);
+                reportTime += _interval;
+            }
+        }
+
+        report(std::chrono::duration_cast<std::chrono::seconds>(Clock::now() - start), true);
+        ::close(_fd);
+        return check();
+    }
+
+private:
+    struct Stats {
+        uint64_t packets{};
+        uint64_t bytes{};
+        uint64_t lost{};
+        uint64_t reordered{};
+        uint64_t frames{};
+        uint64_t broken{};
+        std::vector<double> latencies;
+    };
+
+    [[nodiscard]] bool
+    open()
+    {
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(_port);
+        if (inet_pton(AF_INET, _address.data(), &address.sin_addr) != 1) {
+            std::cerr << "Invalid address: " << _address << '\n';
+            return false;
+        }
+
+        _fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        if (_fd == -1) {
+            std::cerr << "Unable to create socket: " << strerror(errno) << '\n';
+            return false;
+        }
+        std::ignore = setsockopt(
+            _fd, SOL_SOCKET, SO_RCVBUF, &kReceiveBufferSize, sizeof(kReceiveBufferSize));
+        /* Wake up periodically to report and check termination */
+        const timeval timeout{.tv_sec = 0, .tv_usec = 100000};
+        std::ignore = setsockopt(_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        if (bind(_fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == -1) {
+            std::cerr << "Unable to bind socket: " << strerror(errno) << '\n';
+            ::close(_fd);
+            return false;
+        }
+        return true;
+    }
+
+    void
+    handlePacket(const uint8_t* data, const std::size_t size)
+    {
+        RtpHeader header;
+        if (not readRtpHeader(data, size, header)) {
+            return;
+        }
+
+        for (Stats* stats : {&_interim, &_total}) {
+            ++stats->packets, stats->bytes += size;
+        }
+
+        bool gap{false};
+        if (_expected) {
+            if (const auto diff = static_cast<int16_t>(header.sequence - *_expected); diff < 0) {
+                /* Late packet was counted as lost before */
+                for (Stats* stats : {&_interim, &_total}) {
+                    ++stats->reordered;
+                    stats->lost -= std::min<uint64_t>(stats->lost, 1);
+                }
+                return;
+            } else if (diff > 0) {
+                for (Stats* stats : {&_interim, &_total}) {
+                    stats->lost += diff;
+                }
+                gap = true;
+            }
+        }
+        _expected = static_cast<uint16_t>(header.sequence + 1);
+
+        depacketize(data + kRtpHeaderSize, size - kRtpHeaderSize, gap);
+
+        if (header.marker) {
+            /* The RTP timestamp is wall-clock capture time of frame, so the latency covers
+             * capture, queueing, encoding, packetization and network (the last packet of frame) */
+            const auto ticks = static_cast<int32_t>(rtpWallClock() - header.timestamp);
+            const double latency = ticks * 1000.0 / kRtpClockRate;
+            for (Stats* stats : {&_interim, &_total}) {
+                ++stats->frames;
+                stats->latencies.push_back(latency);
+            }
+        }
+    }
+
+    void
+    depacketize(const uint8_t* data, const std::size_t size, const bool gap)
+    {
+        const std::size_t nalHeaderSize = (_codec == RtpCodec::H264) ? 1 : 2;
+        if (size < nalHeaderSize) {
+            return;
+        }
+        if (gap and _fragmented) {
+            /* The fragmented unit is incomplete */
+            _fragmented = false;
+            ++_interim.broken, ++_total.broken;
+        }
+
+        const bool h264 = (_codec == RtpCodec::H264);
+        const uint8_t type = h264 ? (data[0] & 0x1F) : ((data[0] >> 1) & 0x3F);
+        const bool aggregated = h264 ? (type == kH264StapA) : (type == kH265Ap);
+        const bool fragmented = h264 ? (type == kH264FuA) : (type == kH265Fu);
+
+        if (aggregated) {
+            for (std::size_t offset = nalHeaderSize; offset + 2 <= size;) {
+                const std::size_t nalSize = data[offset] << 8 | data[offset + 1];
+                offset += 2;
+                if (offset + nalSize > size) {
+                    ++_interim.broken, ++_total.broken;
+                    break;
+                }
+                writeNal(data + offset, nalSize);
+                offset += nalSize;
+            }
+        } else if (fragmented) {
+            if (size < nalHeaderSize + 1) {
+                return;
+            }
+            const uint8_t fu = data[nalHeaderSize];
+            const bool first = (fu & 0x80) != 0, last = (fu & 0x40) != 0;
+            if (first) {
+                uint8_t nalHeader[2];
+                if (h264) {
+                    nalHeader[0] = static_cast<uint8_t>((data[0] & 0xE0) | (fu & 0x1F));
+                } else {
+                    nalHeader[0] = static_cast<uint8_t>((data[0] & 0x81) | ((fu & 0x3F) << 1));
+                    nalHeader[1] = data[1];
+                }
+                _nal.assign(nalHeader, nalHeader + nalHeaderSize);
+                _fragmented = true;
+            }
+            if (_fragmented) {
+                _nal.insert(_nal.end(), data + nalHeaderSize + 1, data + size);
+                if (last) {
+                    writeNal(_nal.data(), _nal.size());
+                    _fragmented = false;
+                }
+            }
+        } else {
+            writeNal(data, size);
+        }
+    }
+
+    void
+    writeNal(const uint8_t* data, const std::size_t size)
+    {
+        static constexpr char kStartCode[] = {0, 0, 0, 1};
+        if (_output.is_open()) {
+            _output.write(kStartCode, sizeof(kStartCode));
+            _output.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(size));
+        }
+    }
+
+    void
+    report(const std::chrono::seconds elapsed, const bool total = false)
+    {
+        Stats& stats = total ? _total : _interim;
+        std::ranges::sort(stats.latencies);
+        const auto percentile = [&](const double ratio) {
+            if (stats.latencies.empty()) {
+                return 0.0;
+            }
+            return stats.latencies[static_cast<std::size_t>(ratio * (stats.latencies.size() - 1))];
+        };
+
+        const double seconds = std::max<double>(1, elapsed.count());
+        std::cout << std::fixed << std::setprecision(2) << (total ? "Total: " : "")
+                  << "packets<" << stats.packets << ">, lost<" << stats.lost << "> (" << loss(stats)
+                  << "%), reordered<" << stats.reordered << ">, broken<" << stats.broken
+                  << ">, frames<" << stats.frames << ">, bitrate<"
+                  << stats.bytes * 8 / seconds / 1000 << "kbps>, latency p50<" << percentile(0.5)
+                  << "ms>, p99<" << percentile(0.99) << "ms>, max<" << percentile(1.0) << "ms>"
+                  << std::endl;
+
+        if (total) {
+            _p99 = percentile(0.99);
+        } else {
+            stats = {};
+        }
+    }
+
+    [[nodiscard]] static double
+    loss(const Stats& stats)
+    {
+        const uint64_t expected = stats.packets + stats.lost;
+        return expected ? 100.0 * stats.lost / expected : 0.0;
+    }
+
+    [[nodiscard]] bool
+    check() const
+    {
+        bool ok{_total.packets > 0};
+        if (not ok) {
+            std::cerr << "No packets received\n";
+        }
+        if (_maxLoss and loss(_total) > *_maxLoss) {
+            std::cerr << "Packet loss exceeds " << *_maxLoss << "%\n";
+            ok = false;
+        }
+        if (_maxLatency and _p99 > *_maxLatency) {
+            std::cerr << "Frame latency exceeds " << *_maxLatency << "ms\n";
+            ok = false;
+        }
+        return ok;
+    }
+
+private:
+    std::string _address{kDefaultAddress};
+    uint16_t _port{kDefaultPort};
+    RtpCodec _codec{RtpCodec::H264};
+    std::ofstream _output;
+    std::optional<std::chrono::seconds> _duration;
+    std::chrono::seconds _interval{kDefaultInterval};
+    std::optional<double> _maxLoss;
+    std::optional<double> _maxLatency;
+    int _fd{-1};
+    std::optional<uint16_t> _expected;
+    bool _fragmented{false};
+    std::vector<uint8_t> _nal;
+    Stats _interim;
+    Stats _total;
+    double _p99{};
+};
+
+} // namespace jar
+
+int
+main(int argc, char* argv[])
+{
+    jar::RtpRecv app;
+    if (not app.parseArgs(argc, argv)) {
+        /* Show help menu and exit */
+        return EXIT_SUCCESS;
+    }
+
+    std::signal(SIGINT, [](int) { gTerminated = true; });
+    std::signal(SIGTERM, [](int) { gTerminated = true; });
+    return app.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,222 @@
+#include "RtpSender.hpp"
+
+#include "Logger.hpp"
+#include "Tracer.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/udp.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+
+namespace jar {
+
+namespace {
+
+/* The maximum number of segments per GSO message (UDP_MAX_SEGMENTS) */
+constexpr std::size_t kMaxSegments = 64;
+/* The maximum size of GSO message (must fit into single IP datagram before segmentation) */
+constexpr std::size_t kMaxGsoBytes = 65000;
+/* The socket send buffer size to absorb bursts of keyframes */
+constexpr int kSendBufferSize = 4 * 1024 * 1024;
+
+uint32_t
+randomSsrc()
+{
+    std::random_device device;
+    return device();
+}
+
+} // namespace
+
+RtpSender::RtpSender(RtpSenderConfig config)
+    : _config{std::move(config)}
+    , _packetizer{_config.codec, _config.mtu, _config.payloadType, randomSsrc()}
+{
+}
+
+RtpSender::~RtpSender()
+{
+    close();
+}
+
+bool
+RtpSender::open()
+{
+    LOGI("RTP sender config: host<{}>, port<{}>, mtu<{}>, payloadType<{}>, fps<{}>",
+         _config.host,
+         _config.port,
+         _config.mtu,
+         _config.payloadType,
+         _config.fps);
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(_config.port);
+    if (inet_pton(AF_INET, _config.host.data(), &address.sin_addr) != 1) {
+        LOGE("Invalid <{}> RTP destination address", _config.host);
+        return false;
+    }
+
+    _fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (_fd == -1) {
+        LOGE("Unable to create RTP socket: {}", strerror(errno));
+        return false;
+    }
+    if (connect(_fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == -1) {
+        LOGE("Unable to connect RTP socket: {}", strerror(errno));
+        close();
+        return false;
+    }
+    if (setsockopt(_fd, SOL_SOCKET, SO_SNDBUF, &kSendBufferSize, sizeof(kSendBufferSize)) == -1) {
+        LOGW("Unable to set RTP socket send buffer size: {}", strerror(errno));
+    }
+
+    /* The zero segment size keeps per-socket segmentation disabled, only probes support */
+    const int segment{0};
+    _gso = (setsockopt(_fd, SOL_UDP, UDP_SEGMENT, &segment, sizeof(segment)) == 0);
+    LOGI("RTP sender is open: gso<{}>", _gso);
+    return true;
+}
+
+void
+RtpSender::close()
+{
+    if (_fd == -1) {
+        return;
+    }
+
+    LOGI("RTP sender is closed: packets<{}>, messages<{}>, calls<{}>, errors<{}>",
+         _packetCount,
+         _messageCount,
+         _callCount,
+         _errorCount);
+    ::close(_fd);
+    _fd = -1;
+}
+
+void
+RtpSender::send(const EncodedPacket& packet)
+{
+    TRACE_SCOPE("RtpSender::send");
+    auto packets = _packetizer.packetize(packet.data, packet.size, timestamp(packet));
+    _packetCount += packets.size();
+
+    while (not packets.empty()) {
+        prepareMessages(packets);
+        const std::size_t sent = sendMessages();
+        if (sent == _messages.size()) {
+            break;
+        }
+        if (_gso and (errno == EIO or errno == EINVAL)) {
+            /* The device can't segment (e.g. no checksum offload), resend the rest as is */
+            LOGW("UDP GSO is not supported by device, disable it");
+            _gso = false;
+            packets = packets.subspan(_firstPackets[sent]);
+            continue;
+        }
+        ++_errorCount;
+        LOGE_LIMITED("Unable to send RTP packets: {}", strerror(errno));
+        break;
+    }
+}
+
+uint32_t
+RtpSender::timestamp(const EncodedPacket& packet)
+{
+    /* The packets leave encoder in decoding order, so the timestamps follow pts (not the time
+     * of packetization), anchored once to the capture time of the first frame */
+    const auto fps = std::max(1u, _config.fps);
+    const auto ticks = static_cast<uint32_t>(packet.pts * kRtpClockRate / fps);
+    if (not _timestampBase) {
+        _timestampBase = rtpWallClock(packet.captureTime) - ticks;
+    }
+    return *_timestampBase + ticks;
+}
+
+void
+RtpSender::prepareMessages(const std::span<const RtpPacket> packets)
+{
+    /* Reserve upfront as messages point into these vectors */
+    _iovs.clear();
+    _iovs.reserve(2 * packets.size());
+    _controls.clear();
+    _controls.reserve(packets.size());
+    _messages.clear();
+    _firstPackets.clear();
+
+    std::size_t n{0};
+    while (n < packets.size()) {
+        /* Coalesce run of equally sized packets, the last one may be shorter */
+        const std::size_t segmentSize = packets[n].size();
+        std::size_t count{1}, bytes{segmentSize};
+        while (_gso and n + count < packets.size() and count < kMaxSegments) {
+            const std::size_t size = packets[n + count].size();
+            if (size > segmentSize or bytes + size > kMaxGsoBytes) {
+                break;
+            }
+            ++count, bytes += size;
+            if (size < segmentSize) {
+                break;
+            }
+        }
+
+        iovec* const iov = _iovs.data() + _iovs.size();
+        for (const RtpPacket& packet : packets.subspan(n, count)) {
+            _iovs.push_back({const_cast<uint8_t*>(packet.header), packet.headerSize});
+            if (packet.payloadSize > 0) {
+                _iovs.push_back({const_cast<uint8_t*>(packet.payload), packet.payloadSize});
+            }
+        }
+        addMessage(iov, _iovs.data() + _iovs.size() - iov, (count > 1) ? segmentSize : 0);
+        _firstPackets.push_back(n);
+        n += count;
+    }
+}
+
+void
+RtpSender::addMessage(iovec* iov, const std::size_t iovCount, const std::size_t segmentSize)
+{
+    mmsghdr message{};
+    message.msg_hdr.msg_iov = iov;
+    message.msg_hdr.msg_iovlen = iovCount;
+    if (segmentSize > 0) {
+        Control& control = _controls.emplace_back();
+        message.msg_hdr.msg_control = control.data;
+        message.msg_hdr.msg_controllen = sizeof(control.data);
+        cmsghdr* const cmsg = CMSG_FIRSTHDR(&message.msg_hdr);
+        cmsg->cmsg_level = SOL_UDP;
+        cmsg->cmsg_type = UDP_SEGMENT;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+        const auto size = static_cast<uint16_t>(segmentSize);
+        std::memcpy(CMSG_DATA(cmsg), &size, sizeof(size));
+    }
+    _messages.push_back(message);
+}
+
+std::size_t
+RtpSender::sendMessages()
+{
+    std::size_t sent{0};
+    while (sent < _messages.size()) {
+        ++_callCount;
+        const int rv = sendmmsg(_fd, _messages.data() + sent, _messages.size() - sent, 0);
+        if (rv == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        sent += rv;
+        _messageCount += rv;
+    }
+    return sent;
+}
+
+} // namespace jar
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "Encoder.hpp"
+#include "RtpPacketizer.hpp"
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace jar {
+
+struct RtpSenderConfig {
+    /* The destination address (IPv4) */
+    std::string host{"127.0.0.1"};
+    /* The destination port */
+    uint16_t port{5004};
+    /* The maximum size of UDP payload (RTP header included) */
+    std::size_t mtu{1400};
+    /* The RTP payload type (dynamic range) */
+    uint8_t payloadType{96};
+    RtpCodec codec{RtpCodec::H264};
+    /* The frame rate of encoded output (the time base of packet pts) */
+    unsigned fps{30};
+};
+
+/*
+ * Sends encoded packets over UDP as RTP stream. All RTP packets of access unit are sent by
+ * single sendmmsg call, runs of equally sized packets (fragments of large NAL unit) are
+ * coalesced into one message segmented by kernel (UDP GSO) when supported.
+ */
+class RtpSender {
+public:
+    explicit RtpSender(RtpSenderConfig config);
+
+    ~RtpSender();
+
+    [[nodiscard]] bool
+    open();
+
+    void
+    close();
+
+    void
+    send(const EncodedPacket& packet);
+
+private:
+    /* Get RTP timestamp of packet (sampling time of the frame, in presentation order) */
+    [[nodiscard]] uint32_t
+    timestamp(const EncodedPacket& packet);
+
+    /* The per message control buffer for UDP_SEGMENT option */
+    struct Control {
+        alignas(cmsghdr) uint8_t data[CMSG_SPACE(sizeof(uint16_t))];
+    };
+
+    void
+    prepareMessages(std::span<const RtpPacket> packets);
+
+    void
+    addMessage(iovec* iov, std::size_t iovCount, std::size_t segmentSize);
+
+    /* Send prepared messages, returns the number of sent ones */
+    [[nodiscard]] std::size_t
+    sendMessages();
+
+private:
+    RtpSenderConfig _config;
+    RtpPacketizer _packetizer;
+    std::optional<uint32_t> _timestampBase;
+    int _fd{-1};
+    bool _gso{false};
+    std::vector<iovec> _iovs;
+    std::vector<mmsghdr> _messages;
+    std::vector<Control> _controls;
+    /* The index of the first packet of each message */
+    std::vector<std::size_t> _firstPackets;
+    uint64_t _packetCount{};
+    uint64_t _messageCount{};
+    uint64_t _callCount{};
+    uint64_t _errorCount{};
+};
+
+} // namespace jar
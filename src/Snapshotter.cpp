@@ -0,0 +1,247 @@
+#include "Snapshotter.hpp"
+
+#include "Logger.hpp"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libswscale/swscale.h>
+}
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <memory>
+
+namespace jar {
+
+namespace {
+
+/* The niceness of snapshot worker (the lowest priority) */
+constexpr int kWorkerNiceness = 19;
+/* The quality scale of JPEG encoder (1 - best, 31 - worst) */
+constexpr int kJpegQuality = 4;
+/* The maximum time to wait for the next captured frame */
+constexpr std::chrono::milliseconds kFrameTimeout{2000};
+
+struct CodecContextDeleter {
+    void
+    operator()(AVCodecContext* ctx) const
+    {
+        avcodec_free_context(&ctx);
+    }
+};
+
+struct FrameDeleter {
+    void
+    operator()(AVFrame* frame) const
+    {
+        av_frame_free(&frame);
+    }
+};
+
+struct PacketDeleter {
+    void
+    operator()(AVPacket* packet) const
+    {
+        av_packet_free(&packet);
+    }
+};
+
+struct SwsContextDeleter {
+    void
+    operator()(SwsContext* ctx) const
+    {
+        sws_freeContext(ctx);
+    }
+};
+
+int
+makeEven(const int value)
+{
+    return std::max(2, value & ~1);
+}
+
+} // namespace
+
+Snapshotter::Snapshotter(FrameSlot& slot, const SnapshotConfig& config)
+    : _slot{slot}
+    , _config{config}
+{
+}
+
+Snapshotter::~Snapshotter()
+{
+    stop();
+}
+
+void
+Snapshotter::start()
+{
+    _worker = std::jthread{[this](const std::stop_token& token) { handleWorker(token); }};
+}
+
+void
+Snapshotter::stop()
+{
+    _worker.request_stop();
+    if (_worker.joinable()) {
+        _worker.join();
+    }
+}
+
+void
+Snapshotter::request(const SnapshotFormat format, const unsigned width, OnSnapshotReady callback)
+{
+    {
+        std::scoped_lock lock{_guard};
+        _requests.push({.format = format, .width = width, .callback = std::move(callback)});
+    }
+    _whenNotEmpty.notify_one();
+}
+
+std::optional<SnapshotFormat>
+Snapshotter::parseFormat(const std::string_view name)
+{
+    if (name == "jpeg" or name == "jpg") {
+        return SnapshotFormat::Jpeg;
+    }
+    if (name == "png") {
+        return SnapshotFormat::Png;
+    }
+    return std::nullopt;
+}
+
+void
+Snapshotter::handleWorker(const std::stop_token& token)
+{
+    if (setpriority(PRIO_PROCESS, gettid(), kWorkerNiceness) == -1) {
+        LOGW("Unable to lower snapshot worker priority: {}", strerror(errno));
+    }
+
+    while (not token.stop_requested()) {
+        Request request;
+        {
+            std::unique_lock lock{_guard};
+            if (not _whenNotEmpty.wait(lock, token, [this] { return not _requests.empty(); })) {
+                break;
+            }
+            request = std::move(_requests.front());
+            _requests.pop();
+        }
+
+        std::string image;
+        if (const FrameSlot::Frame* frame = _slot.acquire(kFrameTimeout); frame) {
+            image = makeSnapshot(*frame, request.format, request.width);
+        } else {
+            LOGW("No frame has been captured in <{}ms>", kFrameTimeout.count());
+        }
+        request.callback(std::move(image));
+    }
+}
+
+std::string
+Snapshotter::makeSnapshot(const FrameSlot::Frame& frame,
+                          const SnapshotFormat format,
+                          const unsigned width) const
+{
+    const int srcWidth = static_cast<int>(_config.width);
+    const int srcHeight = static_cast<int>(_config.height);
+    if (frame.size < static_cast<unsigned>(srcWidth * srcHeight * 3 / 2)) {
+        LOGE("Frame <{}> is too small: {}", frame.sequence, frame.size);
+        return {};
+    }
+
+    const int dstWidth = makeEven(
+        std::min(srcWidth, static_cast<int>(width ? width : _config.thumbnailWidth)));
+    const int dstHeight = makeEven(srcHeight * dstWidth / srcWidth);
+
+    const bool jpeg = (format == SnapshotFormat::Jpeg);
+    const AVPixelFormat pixFmt = jpeg ? AV_PIX_FMT_YUVJ420P : AV_PIX_FMT_RGB24;
+    const AVCodec* codec = avcodec_find_encoder(jpeg ? AV_CODEC_ID_MJPEG : AV_CODEC_ID_PNG);
+    if (not codec) {
+        LOGE("Unable to find {} encoder", jpeg ? "JPEG" : "PNG");
+        return {};
+    }
+
+    std::unique_ptr<AVCodecContext, CodecContextDeleter> ctx{avcodec_alloc_context3(codec)};
+    if (not ctx) {
+        LOGE("Unable to allocate codec context");
+        return {};
+    }
+    ctx->width = dstWidth;
+    ctx->height = dstHeight;
+    ctx->time_base = {1, 1};
+    ctx->pix_fmt = pixFmt;
+    if (jpeg) {
+        ctx->flags |= AV_CODEC_FLAG_QSCALE;
+    }
+    if (const int rv = avcodec_open2(ctx.get(), codec, nullptr); rv < 0) {
+        LOGE("Unable to open snapshot encoder: {}", av_err2str(rv));
+        return {};
+    }
+
+    std::unique_ptr<AVFrame, FrameDeleter> picture{av_frame_alloc()};
+    std::unique_ptr<AVPacket, PacketDeleter> packet{av_packet_alloc()};
+    if (not picture or not packet) {
+        LOGE("Unable to allocate frame or packet");
+        return {};
+    }
+    picture->format = pixFmt;
+    picture->width = dstWidth;
+    picture->height = dstHeight;
+    picture->pts = 0;
+    if (jpeg) {
+        picture->quality = FF_QP2LAMBDA * kJpegQuality;
+    }
+    if (const int rv = av_frame_get_buffer(picture.get(), 0); rv < 0) {
+        LOGE("Unable to allocate frame buffer: {}", av_err2str(rv));
+        return {};
+    }
+
+    std::unique_ptr<SwsContext, SwsContextDeleter> sws{sws_getContext(srcWidth,
+                                                                      srcHeight,
+                                                                      AV_PIX_FMT_YUV420P,
+                                                                      dstWidth,
+                                                                      dstHeight,
+                                                                      pixFmt,
+                                                                      SWS_BILINEAR,
+                                                                      nullptr,
+                                                                      nullptr,
+                                                                      nullptr)};
+    if (not sws) {
+        LOGE("Unable to create scale context");
+        return {};
+    }
+
+    const uint8_t* const luma = frame.data.data();
+    const uint8_t* const srcData[] = {
+        luma,
+        luma + srcWidth * srcHeight,
+        luma + srcWidth * srcHeight * 5 / 4,
+    };
+    const int srcStrides[] = {srcWidth, srcWidth / 2, srcWidth / 2};
+    sws_scale(
+        sws.get(), srcData, srcStrides, 0, srcHeight, picture->data, picture->linesize);
+
+    if (const int rv = avcodec_send_frame(ctx.get(), picture.get()); rv < 0) {
+        LOGE("Unable to send frame to snapshot encoder: {}", av_err2str(rv));
+        return {};
+    }
+    std::ignore = avcodec_send_frame(ctx.get(), nullptr);
+
+    std::string image;
+    while (avcodec_receive_packet(ctx.get(), packet.get()) >= 0) {
+        image.append(reinterpret_cast<const char*>(packet->data), packet->size);
+        av_packet_unref(packet.get());
+    }
+
+    LOGD("Snapshot of <{}> frame: size<{}x{}>, bytes<{}>",
+         frame.sequence,
+         dstWidth,
+         dstHeight,
+         image.size());
+    return image;
+}
+
+} // namespace jar
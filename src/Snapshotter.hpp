@@ -0,0 +1,71 @@
+#pragma once
+
+#include "FrameSlot.hpp"
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <string>
+#include <string_view>
+#include <thread>
+
+namespace jar {
+
+enum class SnapshotFormat { Jpeg, Png };
+
+struct SnapshotConfig {
+    /* The width of the captured frame */
+    unsigned width{};
+    /* The height of the captured frame */
+    unsigned height{};
+    /* The width of the thumbnail by default (the height keeps aspect ratio) */
+    unsigned thumbnailWidth{320};
+};
+
+class Snapshotter {
+public:
+    /* The callback receives encoded image or empty string in case of failure */
+    using OnSnapshotReady = std::function<void(std::string image)>;
+
+    Snapshotter(FrameSlot& slot, const SnapshotConfig& config);
+
+    ~Snapshotter();
+
+    void
+    start();
+
+    void
+    stop();
+
+    /* Request snapshot of the latest frame (the zero width means default thumbnail width) */
+    void
+    request(SnapshotFormat format, unsigned width, OnSnapshotReady callback);
+
+    [[nodiscard]] static std::optional<SnapshotFormat>
+    parseFormat(std::string_view name);
+
+private:
+    struct Request {
+        SnapshotFormat format{SnapshotFormat::Jpeg};
+        unsigned width{};
+        OnSnapshotReady callback;
+    };
+
+    void
+    handleWorker(const std::stop_token& token);
+
+    [[nodiscard]] std::string
+    makeSnapshot(const FrameSlot::Frame& frame, SnapshotFormat format, unsigned width) const;
+
+private:
+    FrameSlot& _slot;
+    SnapshotConfig _config;
+    std::queue<Request> _requests;
+    std::mutex _guard;
+    std::condition_variable_any _whenNotEmpty;
+    std::jthread _worker;
+};
+
+} // namespace jar
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace jar {
+
+/*
+ * Raw spool file layout (all offsets and sizes are multiple of block size for O_DIRECT I/O):
+ *   [file header, one block][record 0][record 1]...
+ * Each record has fixed size (frame header followed by frame data and padding), so the frame
+ * with given index is located at kSpoolBlockSize + index * recordSize.
+ */
+
+/* The alignment of O_DIRECT writes */
+inline constexpr std::size_t kSpoolBlockSize = 4096;
+inline constexpr char kSpoolMagic[8] = {'R', 'A', 'W', 'S', 'P', 'O', 'O', 'L'};
+inline constexpr uint32_t kSpoolVersion = 1;
+inline constexpr uint32_t kSpoolFrameMagic = 0x52465053; /* "SPFR" */
+
+struct SpoolFileHeader {
+    char magic[8]{};
+    uint32_t version{};
+    /* The V4L2 fourcc of pixel format */
+    uint32_t pixelFormat{};
+    uint32_t width{};
+    uint32_t height{};
+    /* The maximum size of frame data */
+    uint32_t frameSize{};
+    /* The size of each record (frame header, data and padding) */
+    uint32_t recordSize{};
+    /* The number of records (written on close) */
+    uint64_t frameCount{};
+};
+
+struct SpoolFrameHeader {
+    uint32_t magic{};
+    uint32_t sequence{};
+    /* The V4L2 buffer timestamp (microseconds) */
+    int64_t timestamp{};
+    /* The size of frame data */
+    uint32_t size{};
+    uint32_t reserved{};
+};
+
+static_assert(sizeof(SpoolFileHeader) <= kSpoolBlockSize);
+
+[[nodiscard]] constexpr std::size_t
+spoolRecordSize(const std::size_t frameSize)
+{
+    const std::size_t size = sizeof(SpoolFrameHeader) + frameSize;
+    return (size + kSpoolBlockSize - 1) / kSpoolBlockSize * kSpoolBlockSize;
+}
+
+} // namespace jar
@@ -0,0 +1,162 @@
+#include "SpoolReader.hpp"
+
+#include "Logger.hpp"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace jar {
+
+namespace {
+
+[[nodiscard]] bool
+readAll(const int fd, void* data, const std::size_t size, const off_t offset)
+{
+    std::size_t done{};
+    while (done < size) {
+        auto* const ptr = static_cast<uint8_t*>(data) + done;
+        const ssize_t rv = pread(fd, ptr, size - done, static_cast<off_t>(offset + done));
+        if (rv == -1 and errno == EINTR) {
+            continue;
+        }
+        if (rv <= 0) {
+            return false;
+        }
+        done += rv;
+    }
+    return true;
+}
+
+} // namespace
+
+SpoolReader::~SpoolReader()
+{
+    close();
+}
+
+bool
+SpoolReader::open(const std::filesystem::path& path)
+{
+    close();
+
+    _fd = ::open(path.c_str(), O_RDONLY);
+    if (_fd == -1) {
+        LOGE("Unable to open <{}> spool file: {}", path, strerror(errno));
+        return false;
+    }
+
+    if (not readAll(_fd, &_header, sizeof(_header), 0)
+        or std::memcmp(_header.magic, kSpoolMagic, sizeof(kSpoolMagic)) != 0
+        or _header.version != kSpoolVersion
+        or _header.recordSize != spoolRecordSize(_header.frameSize)) {
+        LOGD("File <{}> is not a spool file", path);
+        close();
+        return false;
+    }
+
+    struct stat st{};
+    if (fstat(_fd, &st) == -1) {
+        close();
+        return false;
+    }
+
+    const uint64_t maxFrames = (static_cast<uint64_t>(st.st_size) > kSpoolBlockSize)
+                                   ? (st.st_size - kSpoolBlockSize) / _header.recordSize
+                                   : 0;
+    /* Zero frame count means the file wasn't closed properly */
+    _frameCount = (_header.frameCount > 0) ? std::min(_header.frameCount, maxFrames)
+                                           : countFrames(maxFrames);
+    _buffer.resize(_header.frameSize);
+
+    LOGI("Open <{}> spool file: width<{}>, height<{}>, frames<{}>",
+         path,
+         _header.width,
+         _header.height,
+         _frameCount);
+    return true;
+}
+
+void
+SpoolReader::close()
+{
+    if (_fd != -1) {
+        ::close(_fd);
+        _fd = -1;
+    }
+}
+
+unsigned
+SpoolReader::width() const
+{
+    return _header.width;
+}
+
+unsigned
+SpoolReader::height() const
+{
+    return _header.height;
+}
+
+uint64_t
+SpoolReader::frameCount() const
+{
+    return _frameCount;
+}
+
+bool
+SpoolReader::read(const uint64_t index, SpoolFrame& frame)
+{
+    if (index >= _frameCount) {
+        return false;
+    }
+
+    SpoolFrameHeader header;
+    if (not readHeader(index, header) or header.size > _header.frameSize) {
+        LOGE("Invalid spool record <{}>", index);
+        return false;
+    }
+
+    const off_t offset = kSpoolBlockSize + index * _header.recordSize + sizeof(SpoolFrameHeader);
+    if (not readAll(_fd, _buffer.data(), header.size, offset)) {
+        LOGE("Unable to read spool record <{}>", index);
+        return false;
+    }
+
+    frame = {
+        .sequence = header.sequence,
+        .timestamp = header.timestamp,
+        .data = _buffer.data(),
+        .size = header.size,
+    };
+    return true;
+}
+
+bool
+SpoolReader::readHeader(const uint64_t index, SpoolFrameHeader& header) const
+{
+    const off_t offset = kSpoolBlockSize + index * _header.recordSize;
+    return readAll(_fd, &header, sizeof(header), offset) and header.magic == kSpoolFrameMagic;
+}
+
+uint64_t
+SpoolReader::countFrames(const uint64_t maxFrames) const
+{
+    /* Records are written sequentially into zeroed (preallocated) file, so the valid
+     * records form a prefix and the end of it can be found by binary search */
+    uint64_t lo{0}, hi{maxFrames};
+    while (lo < hi) {
+        const uint64_t mid = lo + (hi - lo) / 2;
+        if (SpoolFrameHeader header; readHeader(mid, header)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+} // namespace jar
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "SpoolFormat.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+namespace jar {
+
+struct SpoolFrame {
+    unsigned sequence{};
+    /* The V4L2 buffer timestamp (microseconds) */
+    int64_t timestamp{};
+    const uint8_t* data{};
+    unsigned size{};
+};
+
+/* Reads raw frames from spool file written by Spooler */
+class SpoolReader {
+public:
+    SpoolReader() = default;
+
+    ~SpoolReader();
+
+    SpoolReader(const SpoolReader&) = delete;
+    SpoolReader&
+    operator=(const SpoolReader&)
+        = delete;
+
+    [[nodiscard]] bool
+    open(const std::filesystem::path& path);
+
+    void
+    close();
+
+    [[nodiscard]] unsigned
+    width() const;
+
+    [[nodiscard]] unsigned
+    height() const;
+
+    [[nodiscard]] uint64_t
+    frameCount() const;
+
+    /* Read frame by index (the frame data is valid until the next read) */
+    [[nodiscard]] bool
+    read(uint64_t index, SpoolFrame& frame);
+
+private:
+    [[nodiscard]] bool
+    readHeader(uint64_t index, SpoolFrameHeader& header) const;
+
+    [[nodiscard]] uint64_t
+    countFrames(uint64_t maxFrames) const;
+
+private:
+    int _fd{-1};
+    SpoolFileHeader _header;
+    uint64_t _frameCount{};
+    std::vector<uint8_t> _buffer;
+};
+
+} // namespace jar
@@ -0,0 +1,275 @@
+#include "Spooler.hpp"
+
+#include "Logger.hpp"
+#include "SpoolFormat.hpp"
+
+extern "C" {
+#include <linux/videodev2.h>
+}
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+namespace fs = std::filesystem;
+
+namespace jar {
+
+namespace {
+
+[[nodiscard]] bool
+writeAll(const int fd, const uint8_t* data, const std::size_t size, const off_t offset)
+{
+    std::size_t written{};
+    while (written < size) {
+        const ssize_t rv = pwrite(fd, data + written, size - written, offset + written);
+        if (rv == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        written += rv;
+    }
+    return true;
+}
+
+} // namespace
+
+void
+Spooler::AlignedDeleter::operator()(uint8_t* ptr) const
+{
+    std::free(ptr);
+}
+
+Spooler::AlignedBuffer
+Spooler::allocateBuffer(const std::size_t size)
+{
+    auto* ptr = static_cast<uint8_t*>(std::aligned_alloc(kSpoolBlockSize, size));
+    if (ptr) {
+        std::memset(ptr, 0, size);
+    }
+    return AlignedBuffer{ptr};
+}
+
+Spooler::Spooler(SpoolConfig config)
+    : _config{std::move(config)}
+    , _frameSize{std::size_t{_config.width} * _config.height * 3 / 2}
+    , _recordSize{spoolRecordSize(_frameSize)}
+{
+}
+
+Spooler::~Spooler()
+{
+    stop();
+}
+
+bool
+Spooler::start()
+{
+    LOGI("Spool config: directory<{}>, fileSize<{}>, bufferCount<{}>, recordSize<{}>",
+         _config.directory,
+         _config.fileSize,
+         _config.bufferCount,
+         _recordSize);
+
+    if (_config.fileSize < kSpoolBlockSize + _recordSize) {
+        LOGE("Spool file size is too small for single frame");
+        return false;
+    }
+
+    std::error_code ec;
+    fs::create_directories(_config.directory, ec);
+    if (ec) {
+        LOGE("Unable to create <{}> directory: {}", _config.directory, ec.message());
+        return false;
+    }
+
+    _headerBuffer = allocateBuffer(kSpoolBlockSize);
+    _buffers.resize(std::max(2u, _config.bufferCount));
+    for (auto& buffer : _buffers) {
+        if (buffer = allocateBuffer(_recordSize); not buffer) {
+            LOGE("Unable to allocate staging buffer");
+            return false;
+        }
+    }
+    if (not _headerBuffer) {
+        LOGE("Unable to allocate header buffer");
+        return false;
+    }
+
+    _worker = std::jthread{[this](const std::stop_token& token) { handleWorker(token); }};
+    return true;
+}
+
+void
+Spooler::stop()
+{
+    _worker.request_stop();
+    if (_worker.joinable()) {
+        _worker.join();
+    }
+}
+
+void
+Spooler::write(const CapturedFrame& frame)
+{
+    if (frame.size > _frameSize) {
+        LOGW_LIMITED("Frame <{}> exceeds spool frame size: {}", frame.sequence, frame.size);
+        return;
+    }
+
+    uint64_t head{};
+    {
+        std::scoped_lock lock{_guard};
+        if (_head - _tail >= _buffers.size()) {
+            ++_dropped;
+            LOGW_LIMITED("No free spool buffer, drop <{}> frame (dropped<{}>)",
+                         frame.sequence,
+                         _dropped);
+            return;
+        }
+        head = _head;
+    }
+
+    /* The buffer at head is owned by capture thread until head is advanced */
+    uint8_t* const record = _buffers[head % _buffers.size()].get();
+    const SpoolFrameHeader header{
+        .magic = kSpoolFrameMagic,
+        .sequence = frame.sequence,
+        .timestamp = frame.timestamp,
+        .size = frame.size,
+    };
+    std::memcpy(record, &header, sizeof(header));
+    std::memcpy(record + sizeof(header), frame.data, frame.size);
+
+    {
+        std::scoped_lock lock{_guard};
+        ++_head;
+    }
+    _whenReady.notify_one();
+}
+
+void
+Spooler::handleWorker(const std::stop_token& token)
+{
+    bool failed{false};
+    while (true) {
+        uint64_t tail{};
+        {
+            std::unique_lock lock{_guard};
+            _whenReady.wait(lock, token, [this] { return _head != _tail; });
+            if (_head == _tail) {
+                /* Stop is requested and all pending frames are written */
+                break;
+            }
+            tail = _tail;
+        }
+
+        if (not failed) {
+            failed = not writeRecord(_buffers[tail % _buffers.size()].get());
+        }
+
+        std::scoped_lock lock{_guard};
+        ++_tail;
+    }
+
+    closeFile();
+    LOGI("Spool is finished: frames<{}>, dropped<{}>", _totalFrames, _dropped);
+}
+
+bool
+Spooler::writeRecord(const uint8_t* record)
+{
+    if (_fd != -1 and kSpoolBlockSize + (_fileFrames + 1) * _recordSize > _config.fileSize) {
+        closeFile();
+    }
+    if (_fd == -1 and not openFile()) {
+        return false;
+    }
+
+    const auto offset = static_cast<off_t>(kSpoolBlockSize + _fileFrames * _recordSize);
+    if (not writeAll(_fd, record, _recordSize, offset)) {
+        LOGE("Unable to write spool record: {}", strerror(errno));
+        return false;
+    }
+    ++_fileFrames, ++_totalFrames;
+    return true;
+}
+
+bool
+Spooler::openFile()
+{
+    const std::time_t now = std::time(nullptr);
+    std::tm tm{};
+    localtime_r(&now, &tm);
+    char name[64];
+    std::strftime(name, sizeof(name), "%Y%m%d-%H%M%S", &tm);
+    const fs::path path
+        = _config.directory / fmt::format("spool-{}-{:04}.raw", name, _fileIndex++);
+
+    _fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+    if (_fd == -1 and errno == EINVAL) {
+        LOGW("O_DIRECT is not supported by <{}> file system, use buffered I/O", path);
+        _fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    }
+    if (_fd == -1) {
+        LOGE("Unable to open <{}> spool file: {}", path, strerror(errno));
+        return false;
+    }
+
+    if (const int rv = posix_fallocate(_fd, 0, static_cast<off_t>(_config.fileSize)); rv != 0) {
+        LOGW("Unable to preallocate <{}> spool file: {}", path, strerror(rv));
+    }
+
+    /* The frame count stays zero until the file is closed (readers scan records then) */
+    _fileFrames = 0;
+    if (not writeHeader()) {
+        LOGE("Unable to write spool header: {}", strerror(errno));
+        closeFile();
+        return false;
+    }
+
+    LOGI("Open <{}> spool file", path);
+    return true;
+}
+
+void
+Spooler::closeFile()
+{
+    if (_fd == -1) {
+        return;
+    }
+
+    if (not writeHeader()) {
+        LOGE("Unable to write spool header: {}", strerror(errno));
+    }
+
+    /* Release preallocated but unused space */
+    if (ftruncate(_fd, static_cast<off_t>(kSpoolBlockSize + _fileFrames * _recordSize)) == -1) {
+        LOGW("Unable to truncate spool file: {}", strerror(errno));
+    }
+    close(_fd);
+    _fd = -1;
+}
+
+bool
+Spooler::writeHeader()
+{
+    SpoolFileHeader header{
+        .version = kSpoolVersion,
+        .pixelFormat = V4L2_PIX_FMT_YUV420,
+        .width = _config.width,
+        .height = _config.height,
+        .frameSize = static_cast<uint32_t>(_frameSize),
+        .recordSize = static_cast<uint32_t>(_recordSize),
+        .frameCount = _fileFrames,
+    };
+    std::memcpy(header.magic, kSpoolMagic, sizeof(kSpoolMagic));
+    std::memcpy(_headerBuffer.get(), &header, sizeof(header));
+    return writeAll(_fd, _headerBuffer.get(), kSpoolBlockSize, 0);
+}
+
+} // namespace jar
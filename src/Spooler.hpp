@@ -0,0 +1,94 @@
+#pragma once
+
+#include "Camera.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace jar {
+
+struct SpoolConfig {
+    /* The directory to store spool files */
+    std::filesystem::path directory;
+    /* The preallocated size of each spool file (the next file is started when it's full) */
+    std::size_t fileSize{std::size_t{1} << 30};
+    /* The number of aligned staging buffers between capture and I/O threads */
+    unsigned bufferCount{16};
+    /* The width of captured frames */
+    unsigned width{};
+    /* The height of captured frames */
+    unsigned height{};
+};
+
+/*
+ * Writes captured raw frames into preallocated spool files (see SpoolFormat.hpp) using aligned
+ * O_DIRECT writes from dedicated I/O thread. The capture thread only copies frame into free
+ * staging buffer and never waits for I/O (the frame is dropped if no buffer is available).
+ */
+class Spooler {
+public:
+    explicit Spooler(SpoolConfig config);
+
+    ~Spooler();
+
+    [[nodiscard]] bool
+    start();
+
+    void
+    stop();
+
+    /* Copy frame into staging buffer (capture thread) */
+    void
+    write(const CapturedFrame& frame);
+
+private:
+    struct AlignedDeleter {
+        void
+        operator()(uint8_t* ptr) const;
+    };
+
+    using AlignedBuffer = std::unique_ptr<uint8_t, AlignedDeleter>;
+
+    [[nodiscard]] static AlignedBuffer
+    allocateBuffer(std::size_t size);
+
+    void
+    handleWorker(const std::stop_token& token);
+
+    [[nodiscard]] bool
+    writeRecord(const uint8_t* record);
+
+    [[nodiscard]] bool
+    openFile();
+
+    void
+    closeFile();
+
+    [[nodiscard]] bool
+    writeHeader();
+
+private:
+    SpoolConfig _config;
+    std::size_t _frameSize{};
+    std::size_t _recordSize{};
+    std::vector<AlignedBuffer> _buffers;
+    AlignedBuffer _headerBuffer;
+    uint64_t _head{};
+    uint64_t _tail{};
+    uint64_t _dropped{};
+    std::mutex _guard;
+    std::condition_variable_any _whenReady;
+    std::jthread _worker;
+
+    int _fd{-1};
+    unsigned _fileIndex{};
+    uint64_t _fileFrames{};
+    uint64_t _totalFrames{};
+};
+
+} // namespace jar
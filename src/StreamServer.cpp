@@ -0,0 +1,250 @@
+#include "StreamServer.hpp"
+
+#include "Logger.hpp"
+
+#include <boost/asio/post.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/asio/write.hpp>
+
+#include <deque>
+#include <filesystem>
+#include <future>
+
+namespace asio = boost::asio;
+namespace fs = std::filesystem;
+
+using boost::system::error_code;
+using Protocol = asio::local::stream_protocol;
+
+namespace jar {
+
+class StreamServer::Session : public std::enable_shared_from_this<Session> {
+public:
+    Session(Protocol::socket socket, const std::size_t budget)
+        : _socket{std::move(socket)}
+        , _budget{budget}
+    {
+    }
+
+    void
+    start(std::vector<GopCache::Packet> packets)
+    {
+        LOGI("Stream client is connected: primed<{}> packets", packets.size());
+        /* Without cached GOP the client starts from the next keyframe */
+        _waitKey = packets.empty();
+        for (auto& packet : packets) {
+            _bytes += packet->size();
+            _queue.push_back(std::move(packet));
+        }
+        writeNext();
+    }
+
+    void
+    push(const GopCache::Packet& packet, const bool key, const GopCache::Packet& prefix)
+    {
+        if (_waitKey) {
+            if (not key) {
+                return;
+            }
+            _waitKey = false;
+            if (prefix) {
+                enqueue(prefix);
+            }
+        }
+        if (_bytes + packet->size() > _budget) {
+            LOGW_LIMITED("Stream client is too slow, skip to the next keyframe");
+            /* The packet being written stays in queue until its completion */
+            while (_queue.size() > (_writing ? 1 : 0)) {
+                _bytes -= _queue.back()->size();
+                _queue.pop_back();
+            }
+            _waitKey = true;
+            return;
+        }
+        enqueue(packet);
+    }
+
+    void
+    close()
+    {
+        error_code ec;
+        _socket.shutdown(Protocol::socket::shutdown_both, ec);
+        _socket.close(ec);
+        _closed = true;
+    }
+
+    [[nodiscard]] bool
+    closed() const
+    {
+        return _closed;
+    }
+
+private:
+    void
+    enqueue(const GopCache::Packet& packet)
+    {
+        _bytes += packet->size();
+        _queue.push_back(packet);
+        if (not _writing) {
+            writeNext();
+        }
+    }
+
+    void
+    writeNext()
+    {
+        if (_queue.empty() or _closed) {
+            _writing = false;
+            return;
+        }
+        _writing = true;
+        asio::async_write(_socket,
+                          asio::buffer(*_queue.front()),
+                          [self = shared_from_this()](const error_code& error, std::size_t) {
+                              self->onWrite(error);
+                          });
+    }
+
+    void
+    onWrite(const error_code& error)
+    {
+        if (error) {
+            if (error != asio::error::operation_aborted) {
+                LOGI("Stream client is disconnected: {}", error.message());
+            }
+            close();
+            return;
+        }
+        _bytes -= _queue.front()->size();
+        _queue.pop_front();
+        writeNext();
+    }
+
+private:
+    Protocol::socket _socket;
+    std::size_t _budget;
+    std::deque<GopCache::Packet> _queue;
+    std::size_t _bytes{};
+    bool _writing{false};
+    bool _waitKey{false};
+    bool _closed{false};
+};
+
+StreamServer::StreamServer(asio::any_io_executor executor, StreamServerConfig config)
+    : _config{std::move(config)}
+    , _acceptor{asio::make_strand(std::move(executor))}
+    , _cache{_config.codec, _config.cacheBudget}
+{
+}
+
+StreamServer::~StreamServer()
+{
+    stop();
+}
+
+bool
+StreamServer::start()
+{
+    std::error_code ec;
+    fs::remove(_config.socketPath, ec);
+
+    error_code error;
+    const Protocol::endpoint endpoint{_config.socketPath};
+    if (_acceptor.open(endpoint.protocol(), error); error) {
+        LOGE("Unable to open stream socket: {}", error.message());
+        return false;
+    }
+    if (_acceptor.bind(endpoint, error); error) {
+        LOGE("Unable to bind stream socket <{}>: {}", _config.socketPath, error.message());
+        _acceptor.close(error);
+        return false;
+    }
+    if (_acceptor.listen(asio::socket_base::max_listen_connections, error); error) {
+        LOGE("Unable to listen stream socket: {}", error.message());
+        _acceptor.close(error);
+        return false;
+    }
+
+    LOGI("Stream server is listening on <{}>", _config.socketPath);
+    accept();
+    return true;
+}
+
+void
+StreamServer::stop()
+{
+    if (not _acceptor.is_open()) {
+        return;
+    }
+
+    /* The sessions are served on the acceptor strand, so close them there */
+    std::promise<void> closed;
+    asio::post(_acceptor.get_executor(), [this, &closed] {
+        error_code error;
+        _acceptor.close(error);
+        for (const auto& session : _sessions) {
+            session->close();
+        }
+        _sessions.clear();
+        _clients = 0;
+        closed.set_value();
+    });
+    closed.get_future().wait();
+
+    std::error_code ec;
+    fs::remove(_config.socketPath, ec);
+}
+
+void
+StreamServer::publish(const EncodedPacket& packet)
+{
+    auto data = std::make_shared<const std::vector<uint8_t>>(packet.data,
+                                                             packet.data + packet.size);
+    asio::post(_acceptor.get_executor(), [this, data = std::move(data), key = packet.key] {
+        dispatch(data, key);
+    });
+}
+
+std::size_t
+StreamServer::clients() const
+{
+    return _clients.load(std::memory_order_relaxed);
+}
+
+void
+StreamServer::accept()
+{
+    _acceptor.async_accept([this](const error_code& error, Protocol::socket socket) {
+        if (error == asio::error::operation_aborted) {
+            return;
+        }
+        if (error) {
+            LOGW("Unable to accept stream connection: {}", error.message());
+        } else {
+            auto session = std::make_shared<Session>(std::move(socket), _config.clientBudget);
+            session->start(_cache.prime());
+            _sessions.push_back(std::move(session));
+            _clients = _sessions.size();
+        }
+        accept();
+    });
+}
+
+void
+StreamServer::dispatch(const GopCache::Packet& packet, const bool key)
+{
+    if (not _acceptor.is_open()) {
+        return;
+    }
+
+    /* The cache is updated on the strand too, so joining clients never miss a packet */
+    _cache.add(packet, key);
+    std::erase_if(_sessions, [](const auto& session) { return session->closed(); });
+    const GopCache::Packet prefix = key ? _cache.keyPrefix() : nullptr;
+    for (const auto& session : _sessions) {
+        session->push(packet, key, prefix);
+    }
+    _clients = _sessions.size();
+}
+
+} // namespace jar
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "Encoder.hpp"
+#include "GopCache.hpp"
+
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace jar {
+
+struct StreamServerConfig {
+    /* The path of local (UNIX domain) socket */
+    std::string socketPath;
+    /* The codec of encoded stream */
+    RtpCodec codec{RtpCodec::H264};
+    /* The maximum size of cached GOP used to prime new clients */
+    std::size_t cacheBudget{std::size_t{8} * 1024 * 1024};
+    /* The maximum size of packets queued for single client (including primed ones) */
+    std::size_t clientBudget{std::size_t{16} * 1024 * 1024};
+};
+
+/*
+ * Serves Annex-B encoded stream to any number of clients on local socket. Each client joining
+ * mid-GOP is primed with cached parameter sets, the last keyframe and the following packets
+ * (see GopCache), so it decodes right away without waiting for the next keyframe. The client
+ * which can't keep up with the stream is skipped to the next keyframe (the encoding is never
+ * blocked). The acceptor and sessions are served on a strand of given executor.
+ */
+class StreamServer {
+public:
+    StreamServer(boost::asio::any_io_executor executor, StreamServerConfig config);
+
+    ~StreamServer();
+
+    [[nodiscard]] bool
+    start();
+
+    void
+    stop();
+
+    /* Send packet to clients (copies payload, may be called from any thread) */
+    void
+    publish(const EncodedPacket& packet);
+
+    [[nodiscard]] std::size_t
+    clients() const;
+
+private:
+    class Session;
+
+    void
+    accept();
+
+    void
+    dispatch(const GopCache::Packet& packet, bool key);
+
+private:
+    StreamServerConfig _config;
+    boost::asio::local::stream_protocol::acceptor _acceptor;
+    GopCache _cache;
+    std::vector<std::shared_ptr<Session>> _sessions;
+    std::atomic<std::size_t> _clients{};
+};
+
+} // namespace jar
@@ -0,0 +1,104 @@
+#include "Tracer.hpp"
+
+#include "Logger.hpp"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+
+namespace jar {
+
+Tracer&
+Tracer::instance()
+{
+    static Tracer instance;
+    return instance;
+}
+
+void
+Tracer::enable(const std::size_t eventsPerThread)
+{
+    {
+        std::scoped_lock lock{_guard};
+        _capacity = std::max<std::size_t>(eventsPerThread, 1);
+    }
+    _enabled.store(true, std::memory_order_release);
+    LOGI("Tracing is enabled: events<{}> per thread", eventsPerThread);
+}
+
+void
+Tracer::record(const char* name, const Clock::time_point begin, const Clock::time_point end)
+{
+    ThreadBuffer* const buffer = threadBuffer();
+    const uint64_t index = buffer->count.load(std::memory_order_relaxed);
+    Event& event = buffer->events[index % buffer->capacity];
+    event.name.store(name, std::memory_order_relaxed);
+    event.begin.store(begin.time_since_epoch().count(), std::memory_order_relaxed);
+    event.end.store(end.time_since_epoch().count(), std::memory_order_relaxed);
+    buffer->count.store(index + 1, std::memory_order_release);
+}
+
+bool
+Tracer::write(const std::filesystem::path& path) const
+{
+    FILE* file = fopen(path.c_str(), "w");
+    if (not file) {
+        LOGE("Unable to open <{}> trace file: {}", path, strerror(errno));
+        return false;
+    }
+
+    const int pid = getpid();
+    std::size_t written{};
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", file);
+    {
+        std::scoped_lock lock{_guard};
+        for (const auto& buffer : _buffers) {
+            const uint64_t count = buffer->count.load(std::memory_order_acquire);
+            const uint64_t first = (count > buffer->capacity) ? count - buffer->capacity : 0;
+            for (uint64_t n = first; n < count; ++n) {
+                const Event& event = buffer->events[n % buffer->capacity];
+                const char* name = event.name.load(std::memory_order_relaxed);
+                const std::chrono::duration<double, std::micro> begin{
+                    Clock::duration{event.begin.load(std::memory_order_relaxed)}};
+                const std::chrono::duration<double, std::micro> end{
+                    Clock::duration{event.end.load(std::memory_order_relaxed)}};
+                if (not name or end < begin) {
+                    /* The event is being overwritten right now */
+                    continue;
+                }
+                fprintf(file,
+                        "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,"
+                        "\"ts\":%.3f,\"dur\":%.3f}",
+                        (written++ > 0) ? ",\n" : "\n",
+                        name,
+                        pid,
+                        buffer->tid,
+                        begin.count(),
+                        (end - begin).count());
+            }
+        }
+    }
+    fputs("\n]}\n", file);
+
+    const bool ok = (fclose(file) == 0);
+    LOGI("Write <{}> trace events to <{}> file", written, path);
+    return ok;
+}
+
+Tracer::ThreadBuffer*
+Tracer::threadBuffer()
+{
+    thread_local ThreadBuffer* buffer{};
+    if (not buffer) {
+        auto newBuffer = std::make_unique<ThreadBuffer>();
+        std::scoped_lock lock{_guard};
+        newBuffer->tid = gettid();
+        newBuffer->capacity = _capacity;
+        newBuffer->events = std::make_unique<Event[]>(_capacity);
+        buffer = _buffers.emplace_back(std::move(newBuffer)).get();
+    }
+    return buffer;
+}
+
+} // namespace jar
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace jar {
+
+/*
+ * Opt-in recorder of pipeline events exported as Chrome trace JSON (viewable by Perfetto).
+ * Each thread writes complete events into its own preallocated ring without locking, the
+ * oldest events are overwritten. When tracing is disabled the cost of trace scope is a single
+ * relaxed atomic load.
+ */
+class Tracer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static Tracer&
+    instance();
+
+    /* Enable tracing with given number of events kept per thread */
+    void
+    enable(std::size_t eventsPerThread);
+
+    [[nodiscard]] bool
+    enabled() const noexcept
+    {
+        return _enabled.load(std::memory_order_relaxed);
+    }
+
+    /* Record complete event (the name must have static storage duration) */
+    void
+    record(const char* name, Clock::time_point begin, Clock::time_point end);
+
+    /* Write recorded events as Chrome trace JSON */
+    [[nodiscard]] bool
+    write(const std::filesystem::path& path) const;
+
+private:
+    struct Event {
+        std::atomic<const char*> name{};
+        std::atomic<int64_t> begin{};
+        std::atomic<int64_t> end{};
+    };
+
+    struct ThreadBuffer {
+        int tid{};
+        std::unique_ptr<Event[]> events;
+        std::size_t capacity{};
+        std::atomic<uint64_t> count{};
+    };
+
+    Tracer() = default;
+
+    [[nodiscard]] ThreadBuffer*
+    threadBuffer();
+
+private:
+    std::atomic<bool> _enabled{false};
+    std::size_t _capacity{};
+    mutable std::mutex _guard;
+    std::vector<std::unique_ptr<ThreadBuffer>> _buffers;
+};
+
+/* Records the lifetime of scope as complete event */
+class TraceScope {
+public:
+    explicit TraceScope(const char* name) noexcept
+        : _name{Tracer::instance().enabled() ? name : nullptr}
+    {
+        if (_name) {
+            _begin = Tracer::Clock::now();
+        }
+    }
+
+    ~TraceScope()
+    {
+        if (_name) {
+            Tracer::instance().record(_name, _begin, Tracer::Clock::now());
+        }
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope&
+    operator=(const TraceScope&)
+        = delete;
+
+private:
+    const char* _name{};
+    Tracer::Clock::time_point _begin;
+};
+
+} // namespace jar
+
+// clang-format off
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+#define TRACE_SCOPE(name) \
+    const jar::TraceScope TRACE_CONCAT(traceScope, __LINE__){name}
+// clang-format on